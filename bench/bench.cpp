@@ -0,0 +1,442 @@
+#include <boost/program_options.hpp>
+#include <FlexLexer.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "driver.hpp"
+#include "lexer.hpp"
+#include "log.hpp"
+#include "nodeCounter.hpp"
+#include "parser.hpp"
+#include "programGenerator.hpp"
+
+namespace arg_parser = boost::program_options;
+
+struct BenchSettings_t
+{
+    std::vector<size_t> statements_counts;
+    std::vector<size_t> expression_depths;
+    std::vector<size_t> variables_counts;
+    std::vector<size_t> if_nestings;
+    std::vector<size_t> guarded_percents;
+    uint64_t seed;
+    size_t repeat_count;
+    unsigned opt_level;
+    std::string output_file_name;
+};
+
+struct PhaseResult_t
+{
+    const char *name;
+    std::vector<double> times_ms;
+};
+
+using Clock_t = std::chrono::steady_clock;
+using Ms_t = std::chrono::duration<double, std::milli>;
+
+// Every phase but lexing starts from a freshly parsed program, only the
+// phase itself is timed.
+class PhaseRunner_t
+{
+private:
+    const std::string &program;
+    const char *source_name;
+    unsigned opt_level;
+    int null_fd;
+
+public:
+    explicit PhaseRunner_t(const std::string &program_, const char *source_name_, const unsigned opt_level_, const int null_fd_)
+        :
+            program(program_),
+            source_name(source_name_),
+            opt_level(opt_level_),
+            null_fd(null_fd_)
+    {}
+
+    double lexFlex() const
+    {
+        std::istringstream source(program);
+        yyFlexLexer flexer(&source);
+
+        const auto start = Clock_t::now();
+        while (flexer.yylex() != 0)
+        {}
+        return Ms_t(Clock_t::now() - start).count();
+    }
+
+    double lexMapped() const
+    {
+        Lexer_t lexer(program);
+
+        const auto start = Clock_t::now();
+        while (lexer.lex() != yy::parser::token::YYEOF)
+        {}
+        return Ms_t(Clock_t::now() - start).count();
+    }
+
+    // Includes the mapped lexer and name resolution, which run interleaved
+    // with and right after the parser.
+    double parse() const
+    {
+        Driver_t driver;
+
+        const auto start = Clock_t::now();
+        if (!driver.proceedFrontEnd(source_name))
+        {
+            return -1.0;
+        }
+        return Ms_t(Clock_t::now() - start).count();
+    }
+
+    double flatten() const
+    {
+        Driver_t driver;
+        if (!driver.proceedFrontEnd(source_name))
+        {
+            return -1.0;
+        }
+
+        const auto start = Clock_t::now();
+        driver.lowerToFlat();
+        return Ms_t(Clock_t::now() - start).count();
+    }
+
+    // Lowering to the flat AST is left out, the flatten phase covers it.
+    double interpret() const
+    {
+        Driver_t driver;
+        driver.setOutputFd(null_fd);
+        if (!driver.proceedFrontEnd(source_name))
+        {
+            return -1.0;
+        }
+        driver.lowerToFlat();
+
+        const auto start = Clock_t::now();
+        driver.interpret();
+        return Ms_t(Clock_t::now() - start).count();
+    }
+
+    // Lowering to bytecode is left out like flattening for the interpreter.
+    double runVM() const
+    {
+        Driver_t driver;
+        driver.setOutputFd(null_fd);
+        if (!driver.proceedFrontEnd(source_name))
+        {
+            return -1.0;
+        }
+        driver.bytecode_builder.generateBytecode(driver.bytecode, *driver.root);
+
+        const auto start = Clock_t::now();
+        driver.vm.run(driver.bytecode);
+        return Ms_t(Clock_t::now() - start).count();
+    }
+
+    // Bare traversal with the explicit-stack walker every visitor uses and
+    // with plain recursion, on the same visitor.
+    double traverse() const
+    {
+        return countNodes(false);
+    }
+
+    double traverseRecursive() const
+    {
+        return countNodes(true);
+    }
+
+    double graphDump() const
+    {
+        Driver_t driver;
+        if (!driver.proceedFrontEnd(source_name))
+        {
+            return -1.0;
+        }
+        FILE *dot_file = fopen("/dev/null", "w");
+        if (dot_file == nullptr)
+        {
+            return -1.0;
+        }
+
+        const auto start = Clock_t::now();
+        driver.graph_dumper.writeDot(dot_file, *driver.root);
+        fflush(dot_file);
+        const double time_ms = Ms_t(Clock_t::now() - start).count();
+
+        fclose(dot_file);
+        return time_ms;
+    }
+
+    double generateLLVMIR() const
+    {
+        CodegenOptions_t options;
+        options.opt_level = opt_level;
+
+        Driver_t driver;
+        driver.setCodegenOptions(options);
+        if (!driver.proceedFrontEnd(source_name))
+        {
+            return -1.0;
+        }
+        driver.lowerToFlat();
+
+        const auto start = Clock_t::now();
+        if (!driver.generateLLVMIR("/dev/null"))
+        {
+            return -1.0;
+        }
+        return Ms_t(Clock_t::now() - start).count();
+    }
+
+private:
+    double countNodes(const bool is_recursive) const
+    {
+        Driver_t driver;
+        if (!driver.proceedFrontEnd(source_name))
+        {
+            return -1.0;
+        }
+        NodeCounter node_counter;
+
+        const auto start = Clock_t::now();
+        if (is_recursive)
+        {
+            node_counter.countRecursive(*driver.root);
+        }
+        else
+        {
+            node_counter.count(*driver.root);
+        }
+        return Ms_t(Clock_t::now() - start).count();
+    }
+};
+
+static arg_parser::options_description createParser()
+{
+    arg_parser::options_description desc("Measures every compiler phase on generated programs, "
+                                          "all combinations of the given sizes are run");
+    desc.add_options()
+        ("help,h", "print help message")
+        ("statements", arg_parser::value<std::vector<size_t>>()->multitoken()->default_value({100000}, "100000"), "top-level statements")
+        ("depth", arg_parser::value<std::vector<size_t>>()->multitoken()->default_value({3}, "3"), "operator levels in every expression")
+        ("variables", arg_parser::value<std::vector<size_t>>()->multitoken()->default_value({16}, "16"), "declared variables")
+        ("nesting", arg_parser::value<std::vector<size_t>>()->multitoken()->default_value({2}, "2"), "if/else nesting depth")
+        ("guarded", arg_parser::value<std::vector<size_t>>()->multitoken()->default_value({0}, "0"), "percent of if conditions guarded by a cheap && or || test")
+        ("seed", arg_parser::value<uint64_t>()->default_value(1), "generator seed")
+        ("repeat", arg_parser::value<size_t>()->default_value(5), "runs of every phase, the JSON has min and median")
+        ("opt-level,O", arg_parser::value<unsigned>()->default_value(0), "LLVM optimization level for the LLVMBuilder phase")
+        ("output", arg_parser::value<std::string>()->default_value("-"), "JSON results file, - is stdout");
+
+    return desc;
+}
+
+static bool parseCmd(const int argc, const char **argv, const arg_parser::options_description &desc, BenchSettings_t &settings)
+{
+    arg_parser::variables_map var_map;
+    try
+    {
+        arg_parser::store(arg_parser::parse_command_line(argc, argv, desc), var_map);
+        if (var_map.count("help"))
+        {
+            std::cout << desc << '\n';
+            return false;
+        }
+        arg_parser::notify(var_map);
+    }
+    catch (const arg_parser::error &error)
+    {
+        std::cerr << error.what() << '\n';
+        return false;
+    }
+
+    settings.statements_counts = var_map["statements"].as<std::vector<size_t>>();
+    settings.expression_depths = var_map["depth"].as<std::vector<size_t>>();
+    settings.variables_counts = var_map["variables"].as<std::vector<size_t>>();
+    settings.if_nestings = var_map["nesting"].as<std::vector<size_t>>();
+    settings.guarded_percents = var_map["guarded"].as<std::vector<size_t>>();
+    settings.seed = var_map["seed"].as<uint64_t>();
+    settings.repeat_count = std::max<size_t>(1, var_map["repeat"].as<size_t>());
+    settings.opt_level = var_map["opt-level"].as<unsigned>();
+    settings.output_file_name = var_map["output"].as<std::string>();
+
+    if (settings.opt_level > 3)
+    {
+        std::cerr << "Invalid optimization level: -O" << settings.opt_level << '\n';
+        return false;
+    }
+    return true;
+}
+
+static bool runPhases(const BenchSettings_t &settings, const std::string &program, std::vector<PhaseResult_t> &results)
+{
+    // The front end reads regular files through a mapping, like the compiler does.
+    char source_name[] = "/tmp/compiler_bench_XXXXXX.txt";
+    const int source_fd = mkstemps(source_name, 4);
+    if (source_fd < 0)
+    {
+        USER_ERR("Cannot create a temporary source file\n");
+        return false;
+    }
+    const bool is_written = write(source_fd, program.data(), program.size()) == static_cast<ssize_t>(program.size());
+    close(source_fd);
+
+    const int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (!is_written || null_fd < 0)
+    {
+        USER_ERR("Cannot prepare benchmark files\n");
+        remove(source_name);
+        return false;
+    }
+
+    const PhaseRunner_t runner(program, source_name, settings.opt_level, null_fd);
+    using Phase_t = double (PhaseRunner_t::*)() const;
+    const std::pair<const char*, Phase_t> phases[] = {
+        {"lex_flex",           &PhaseRunner_t::lexFlex},
+        {"lex_mapped",         &PhaseRunner_t::lexMapped},
+        {"parse",              &PhaseRunner_t::parse},
+        {"traverse",           &PhaseRunner_t::traverse},
+        {"traverse_recursive", &PhaseRunner_t::traverseRecursive},
+        {"flatten",            &PhaseRunner_t::flatten},
+        {"interpret",          &PhaseRunner_t::interpret},
+        {"vm",                 &PhaseRunner_t::runVM},
+        {"graph_dump",         &PhaseRunner_t::graphDump},
+        {"llvm_ir",            &PhaseRunner_t::generateLLVMIR}
+    };
+
+    bool is_success = true;
+    results.clear();
+    for (const auto &[name, phase] : phases)
+    {
+        PhaseResult_t result = {name, {}};
+        for (size_t i = 0; i < settings.repeat_count && is_success; ++i)
+        {
+            const double time_ms = (runner.*phase)();
+            if (time_ms < 0)
+            {
+                USER_ERR("Phase %s failed\n", name);
+                is_success = false;
+            }
+            result.times_ms.push_back(time_ms);
+        }
+        results.push_back(std::move(result));
+    }
+
+    close(null_fd);
+    remove(source_name);
+    return is_success;
+}
+
+static void writeRun(
+    std::ostream &json,
+    const GeneratorOptions_t &options,
+    const std::string &program,
+    std::vector<PhaseResult_t> &results
+    )
+{
+    json << "    {\n"
+         << "      \"statements\": " << options.statements_count << ",\n"
+         << "      \"expression_depth\": " << options.expression_depth << ",\n"
+         << "      \"variables\": " << options.variables_count << ",\n"
+         << "      \"if_nesting\": " << options.if_nesting << ",\n"
+         << "      \"guarded_percent\": " << options.guarded_percent << ",\n"
+         << "      \"seed\": " << options.seed << ",\n"
+         << "      \"source_bytes\": " << program.size() << ",\n"
+         << "      \"phases\": {\n";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        std::vector<double> &times = results[i].times_ms;
+        std::sort(times.begin(), times.end());
+        const double min_ms = times.front();
+        const double median_ms = times[times.size() / 2];
+        const double mb_per_s = min_ms > 0 ? static_cast<double>(program.size()) / 1e3 / min_ms : 0.0;
+        const double statements_per_s = min_ms > 0 ? static_cast<double>(options.statements_count) * 1e3 / min_ms : 0.0;
+
+        json << "        \"" << results[i].name << "\": {"
+             << "\"min_ms\": " << min_ms << ", "
+             << "\"median_ms\": " << median_ms << ", "
+             << "\"mb_per_s\": " << mb_per_s << ", "
+             << "\"statements_per_s\": " << statements_per_s << "}"
+             << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    json << "      }\n"
+         << "    }";
+}
+
+int main(int argc, const char **argv)
+{
+    const arg_parser::options_description desc = createParser();
+    BenchSettings_t settings;
+    if (!parseCmd(argc, argv, desc, settings))
+    {
+        return 1;
+    }
+
+    if (!initLogging("compiler_bench_log.txt"))
+    {
+        fprintf(stderr, "Failed to init log library!\n");
+    }
+
+    std::ostringstream json;
+    json.precision(6);
+    json << "{\n"
+         << "  \"repeat\": " << settings.repeat_count << ",\n"
+         << "  \"opt_level\": " << settings.opt_level << ",\n"
+         << "  \"runs\": [\n";
+
+    bool is_success = true;
+    bool is_first_run = true;
+    std::vector<PhaseResult_t> results;
+    for (const size_t statements_count : settings.statements_counts)
+    for (const size_t expression_depth : settings.expression_depths)
+    for (const size_t variables_count : settings.variables_counts)
+    for (const size_t if_nesting : settings.if_nestings)
+    for (const size_t guarded_percent : settings.guarded_percents)
+    {
+        const GeneratorOptions_t options = {
+            statements_count, expression_depth, variables_count, if_nesting, guarded_percent, settings.seed
+        };
+        const std::string program = ProgramGenerator_t(options).generate();
+
+        if (!runPhases(settings, program, results))
+        {
+            is_success = false;
+            continue;
+        }
+
+        json << (is_first_run ? "" : ",\n");
+        writeRun(json, options, program, results);
+        is_first_run = false;
+    }
+    json << "\n  ]\n}\n";
+
+    if (settings.output_file_name == "-")
+    {
+        std::cout << json.str();
+    }
+    else
+    {
+        std::ofstream output(settings.output_file_name);
+        output << json.str();
+        if (!output)
+        {
+            USER_ERR("Cannot write file: %s\n", settings.output_file_name.c_str());
+            is_success = false;
+        }
+    }
+
+    if (!deinitLogging())
+    {
+        fprintf(stderr, "Failed to deinit log library!\n");
+    }
+    return is_success ? 0 : -1;
+}
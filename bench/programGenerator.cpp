@@ -0,0 +1,141 @@
+#include "programGenerator.hpp"
+
+size_t ProgramGenerator_t::pick(const size_t bound)
+{
+    return static_cast<size_t>(random() % bound);
+}
+
+std::string ProgramGenerator_t::generate()
+{
+    program.clear();
+
+    for (size_t i = 0; i < options.variables_count; ++i)
+    {
+        program += "declare v" + std::to_string(i) + " = ";
+        emitNumber();
+        program += ";\n";
+    }
+    for (size_t i = 0; i < options.statements_count; ++i)
+    {
+        emitStatement(options.if_nesting);
+    }
+
+    return std::move(program);
+}
+
+void ProgramGenerator_t::emitStatement(const size_t nesting_left)
+{
+    const size_t kind = pick(10);
+
+    if (kind >= 8 && nesting_left > 0)
+    {
+        program += "if (";
+        emitCondition();
+        program += ") {\n";
+        emitStatement(nesting_left - 1);
+        program += "}";
+        if (pick(2) == 0)
+        {
+            program += " else {\n";
+            emitStatement(nesting_left - 1);
+            program += "}";
+        }
+        program += "\n";
+        return;
+    }
+
+    // Without variables there is nothing to assign to.
+    if (kind >= 6 || options.variables_count == 0)
+    {
+        program += "print(";
+        emitExpression(options.expression_depth);
+        program += ");\n";
+        return;
+    }
+
+    emitVariable();
+    program += " = ";
+    emitExpression(options.expression_depth);
+    program += ";\n";
+}
+
+void ProgramGenerator_t::emitCondition()
+{
+    if (options.variables_count == 0 || pick(100) >= options.guarded_percent)
+    {
+        emitExpression(options.expression_depth);
+        return;
+    }
+
+    // A variable compared with itself is cheap to test and decides the
+    // result on its own, like a guard that almost never lets the check through.
+    const std::string variable = "v" + std::to_string(pick(options.variables_count));
+    if (pick(2) == 0)
+    {
+        program += "(!(" + variable + " == " + variable + ")) && (";
+    }
+    else
+    {
+        program += "(" + variable + " == " + variable + ") || (";
+    }
+    emitExpression(options.expression_depth);
+    program += ")";
+}
+
+void ProgramGenerator_t::emitExpression(const size_t depth)
+{
+    if (depth == 0)
+    {
+        emitLeaf();
+        return;
+    }
+
+    static const char *const binary_operators[] = {"+", "-", "*", "<", "==", "&&", "||"};
+    constexpr size_t binary_count = sizeof(binary_operators) / sizeof(binary_operators[0]);
+
+    // The grammar has no associativity, every operand gets brackets.
+    const size_t kind = pick(binary_count + 2);
+    if (kind == binary_count)
+    {
+        program += "!(";
+        emitExpression(depth - 1);
+        program += ")";
+        return;
+    }
+    if (kind == binary_count + 1)
+    {
+        // Constant divisors only, a benchmark must not stop on division by zero.
+        program += "(";
+        emitExpression(depth - 1);
+        program += ") / " + std::to_string(1 + pick(9));
+        return;
+    }
+
+    program += "(";
+    emitExpression(depth - 1);
+    program += ") ";
+    program += binary_operators[kind];
+    program += " (";
+    emitExpression(depth - 1);
+    program += ")";
+}
+
+void ProgramGenerator_t::emitLeaf()
+{
+    if (options.variables_count == 0 || pick(3) == 0)
+    {
+        emitNumber();
+        return;
+    }
+    emitVariable();
+}
+
+void ProgramGenerator_t::emitNumber()
+{
+    program += std::to_string(static_cast<int64_t>(pick(201)) - 100);
+}
+
+void ProgramGenerator_t::emitVariable()
+{
+    program += "v" + std::to_string(pick(options.variables_count));
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+
+struct GeneratorOptions_t
+{
+    // Top-level statements after the variable declarations.
+    size_t statements_count = 10000;
+    // Operator levels in every generated expression, 0 gives single leaves.
+    size_t expression_depth = 3;
+    size_t variables_count = 16;
+    // How many ifs are nested inside each other at most.
+    size_t if_nesting = 2;
+    // Percent of if conditions written as a guard: a cheap test that nearly
+    // always decides && or || on its own, then the generated expression.
+    size_t guarded_percent = 0;
+    uint64_t seed = 1;
+};
+
+// Generates valid programs for benchmarks. The same options always give
+// the same program, on every platform: only the raw output of
+// std::mt19937_64 is used, distributions are implementation defined.
+class ProgramGenerator_t
+{
+private:
+    GeneratorOptions_t options;
+    std::mt19937_64 random;
+    std::string program;
+
+public:
+    explicit ProgramGenerator_t(const GeneratorOptions_t &options_)
+        :
+            options(options_),
+            random(options_.seed)
+    {}
+
+    std::string generate();
+
+private:
+    // Uniform enough in [0, bound) for benchmark input.
+    size_t pick(size_t bound);
+    void emitStatement(size_t nesting_left);
+    void emitCondition();
+    void emitExpression(size_t depth);
+    void emitLeaf();
+    void emitNumber();
+    void emitVariable();
+};
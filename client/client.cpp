@@ -0,0 +1,122 @@
+#include <libgen.h>
+#include <linux/limits.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "protocol.hpp"
+
+static constexpr const char *SOCKET_ENV_NAME = "MIPT_COMPILER_SOCKET";
+static constexpr const char *DEFAULT_SOCKET_PATH = "/tmp/mipt_compiler.sock";
+static constexpr const char *SERVER_TIMING_OPTION = "--server-timing";
+
+static int connectToServer(const char *socket_path)
+{
+    sockaddr_un address;
+    if (strlen(socket_path) >= sizeof(address.sun_path))
+    {
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+
+    const int socket_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socket_fd < 0)
+    {
+        return -1;
+    }
+    if (connect(socket_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        close(socket_fd);
+        return -1;
+    }
+    return socket_fd;
+}
+
+// Without a server the client does the work itself with the compiler
+// installed next to it, so scripts never depend on a server being up.
+static int runLocally(const std::vector<std::string> &args)
+{
+    char self_path[PATH_MAX] = {};
+    if (readlink("/proc/self/exe", self_path, sizeof(self_path) - 1) < 0)
+    {
+        perror("compiler_client: cannot locate compiler");
+        return 1;
+    }
+    const std::string compiler_path = std::string(dirname(self_path)) + "/compiler";
+
+    std::vector<char*> argv = {const_cast<char*>(compiler_path.c_str())};
+    for (const auto &arg : args)
+    {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    execv(compiler_path.c_str(), argv.data());
+    perror("compiler_client: cannot run compiler");
+    return 1;
+}
+
+int main(int argc, const char **argv)
+{
+    ServerRequest_t request;
+    bool print_server_timing = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], SERVER_TIMING_OPTION) == 0)
+        {
+            print_server_timing = true;
+            continue;
+        }
+        request.args.push_back(argv[i]);
+    }
+
+    const char *socket_path = getenv(SOCKET_ENV_NAME);
+    if (socket_path == nullptr)
+    {
+        socket_path = DEFAULT_SOCKET_PATH;
+    }
+
+    const int socket_fd = connectToServer(socket_path);
+    if (socket_fd < 0)
+    {
+        return runLocally(request.args);
+    }
+
+    char working_dir[PATH_MAX] = {};
+    if (getcwd(working_dir, sizeof(working_dir)) == nullptr)
+    {
+        perror("compiler_client: getcwd");
+        return 1;
+    }
+    request.working_dir = working_dir;
+    request.fds[0] = STDIN_FILENO;
+    request.fds[1] = STDOUT_FILENO;
+    request.fds[2] = STDERR_FILENO;
+
+    ServerResponse_t response;
+    if (!sendRequest(socket_fd, request) || !receiveResponse(socket_fd, response))
+    {
+        fprintf(stderr, "compiler_client: lost connection to %s\n", socket_path);
+        close(socket_fd);
+        return 1;
+    }
+    close(socket_fd);
+
+    if (response.exit_code == RUN_LOCALLY_EXIT_CODE)
+    {
+        return runLocally(request.args);
+    }
+    if (print_server_timing)
+    {
+        fprintf(stderr, "Server time: %.3f ms\n", response.elapsed_ms);
+    }
+    return response.exit_code;
+}
@@ -1,31 +1,86 @@
 #include <cstdio>
+#include <cstring>
 #include <FlexLexer.h>
+#include <iostream>
 #include <string>
+#include <unistd.h>
 
 #include "driver.hpp"
 #include "log.hpp"
+#include "mappedFile.hpp"
 #include "parser.hpp"
 
-yyFlexLexer *flexer = NULL;
+static int lexMapped
+(
+    yy::parser::semantic_type* yylval,
+    yy::parser::location_type* yylloc,
+    Lexer_t &lexer
+)
+{
+    const int token = lexer.lex();
+    yylloc->begin.line = lexer.lineno();
+
+    if (token == yy::parser::token::VAR_NAME)
+    {
+        yylval->build(lexer.YYText());
+    }
+    else if (token == yy::parser::token::NUMBER)
+    {
+        yylval->build(lexer.value());
+    }
+
+    return token;
+}
+
+static int lexFlex
+(
+    yy::parser::semantic_type* yylval,
+    yy::parser::location_type* yylloc,
+    yyFlexLexer &flexer,
+    std::unordered_set<std::string> &names
+)
+{
+    yylloc->begin.line = flexer.lineno();
+    const int token = flexer.yylex();
+
+    if (token == yy::parser::token::VAR_NAME)
+    {
+        // Flex reuses its buffer, the name has to outlive the token. Interning
+        // keeps it alive without tying it to the statement being parsed.
+        const auto name = names.emplace(flexer.YYText(), static_cast<size_t>(flexer.YYLeng())).first;
+        yylval->build(std::string_view(*name));
+    }
+    else if (token == yy::parser::token::NUMBER)
+    {
+        AstValue_t value = 0;
+        if (!Lexer_t::parseNumber(std::string_view(flexer.YYText(), static_cast<size_t>(flexer.YYLeng())), value))
+        {
+            USER_ERR("Number %s in line(%d) does not fit in 64 bits\n", flexer.YYText(), flexer.lineno());
+            return yy::parser::token::YYUNDEF;
+        }
+        yylval->build(value);
+    }
+
+    return token;
+}
 
 int yylex
 (
     yy::parser::semantic_type* yylval, 
-    yy::parser::location_type* yylloc
+    yy::parser::location_type* yylloc,
+    Driver_t &driver
 ) 
 {
-    if (flexer == NULL)
+    if (driver.lexer != nullptr)
     {
-        DEV_DBG_ERR("Invalid resources!\n");
+        return lexMapped(yylval, yylloc, *driver.lexer);
     }
 
-    yylloc->begin.line = flexer->lineno();
-    int token = flexer->yylex();
-    if(token == yy::parser::token::VAR_NAME || token == yy::parser::token::NUMBER) {
-        yylval->build(std::string(flexer->YYText()));
+    if (driver.flexer == nullptr)
+    {
+        DEV_DBG_ERR("Invalid resources!\n");
     }
-
-    return token;
+    return lexFlex(yylval, yylloc, *driver.flexer, driver.flex_names);
 }
 
 void yy::parser::error
@@ -34,7 +89,54 @@ void yy::parser::error
     const std::string& msg
 )
 {
-    USER_ABORT("Unexpected character in line(%d): %s\n", loc.begin.line, msg.c_str());
+    // parse() fails after this, which is reported by proceedFrontEnd().
+    USER_ERR("Unexpected character in line(%d): %s\n", loc.begin.line, msg.c_str());
+}
+
+bool Driver_t::proceedFrontEnd(const char *source_name)
+{
+    DEV_ASSERT(source_name == nullptr);
+
+    if (strcmp(source_name, "-") == 0)
+    {
+        return proceedFrontEnd(std::cin);
+    }
+
+    MappedFile_t source;
+    if (!source.open(source_name))
+    {
+        std::ifstream source_file(source_name);
+        if (!source_file)
+        {
+            USER_ERR("Cannot open file: %s\n", source_name);
+            return false;
+        }
+        return proceedFrontEnd(source_file);
+    }
+
+    if (time_report != nullptr)
+    {
+        // The lexer runs interleaved with the parser and is timed as part of
+        // lex_and_parse, a separate pass shows its share outside the total.
+        TimeReport_t::Scope_t lex_scope(time_report, "lex", false);
+        Lexer_t lex_only(source.contents());
+        int token = lex_only.lex();
+        while (token != yy::parser::token::YYEOF && token != yy::parser::token::YYUNDEF)
+        {
+            token = lex_only.lex();
+        }
+    }
+
+    // Nodes copy the names they need, the mapping can go away after parsing.
+    Lexer_t source_lexer(source.contents());
+    lexer = &source_lexer;
+    mapped_source = &source;
+
+    const bool is_parsed = parse();
+
+    lexer = nullptr;
+    mapped_source = nullptr;
+    return is_parsed;
 }
 
 bool Driver_t::proceedFrontEnd(std::istream& source_file)
@@ -46,18 +148,122 @@ bool Driver_t::proceedFrontEnd(std::istream& source_file)
         return false;
     }
 
-    yy::parser parser(*this);
-    parser.parse();
+    const bool is_parsed = parse();
 
     delete flexer;
+    flexer = nullptr;
+    return is_parsed;
+}
+
+bool Driver_t::parse()
+{
+    // Someone is waiting on a terminal, do not hold output back until the buffer fills.
+    flush_each_statement = stream_mode && isatty(output_fd);
+    statement_mark = arena.mark();
+
+    yy::parser parser(*this);
+    bool is_parsed = false;
+    {
+        // Streamed statements are resolved and interpreted while parsing.
+        TimeReport_t::Scope_t parse_scope(time_report, stream_mode ? "lex_parse_and_run" : "lex_and_parse");
+        is_parsed = parser.parse() == 0;
+    }
+
+    if (stream_mode)
+    {
+        interpreter.flushOutput();
+        return is_parsed;
+    }
+    if (!is_parsed)
+    {
+        return false;
+    }
+
+    bool is_resolved = false;
+    {
+        TimeReport_t::Scope_t resolve_scope(time_report, "resolve");
+        is_resolved = name_resolver.resolve(*root);
+    }
+    reportNodeCounts();
+    return is_resolved;
+}
+
+void Driver_t::reportNodeCounts()
+{
+    if (time_report == nullptr)
+    {
+        return;
+    }
+
+    NodeCounter node_counter;
+    node_counter.count(*root);
+    for (size_t type = 0; type < NodeCounter::NODE_TYPES_COUNT; ++type)
+    {
+        const auto node_type = static_cast<NodeCounter::NodeType_t>(type);
+        time_report->setNodeCount(NodeCounter::getName(node_type), node_counter.getCount(node_type));
+    }
+}
+
+bool Driver_t::streamStatement(const RuleNode_t *statement)
+{
+    DEV_ASSERT(statement == nullptr);
+
+    if (!name_resolver.resolveStatement(*statement, *root))
+    {
+        return false;
+    }
+    flat_builder.buildStatement(flat_statement, *root, *statement);
+    interpreter.executeStatement(flat_statement);
+    if (flush_each_statement)
+    {
+        interpreter.flushOutput();
+    }
+
+    // Nothing outside the statement points into the nodes created for it.
+    arena.rewind(statement_mark);
+    // Names are copied into nodes, executed source text is never looked at again.
+    if (mapped_source != nullptr)
+    {
+        mapped_source->releaseBefore(lexer->position());
+    }
     return true;
 }
 
+void Driver_t::optimizeAst(const unsigned opt_level, const bool print_report)
+{
+    DEV_ASSERT(root == nullptr);
+
+    TimeReport_t::Scope_t optimize_scope(time_report, "ast_optimize");
+
+    // Propagation folds every expression it visits, plain folding is
+    // only needed when it does not run.
+    if (opt_level < 2)
+    {
+        constant_folder.fold(*root);
+        if (print_report)
+        {
+            logPrint("Constant folding: %zu expressions folded\n", constant_folder.foldedCount());
+        }
+        return;
+    }
+
+    const_propagator.propagate(*root);
+    if (print_report)
+    {
+        logPrint("Constant propagation: %zu variable reads replaced\n", const_propagator.replacedReads());
+        logPrint("Constant propagation: %zu branches removed\n", const_propagator.removedBranches());
+        logPrint("Constant propagation: %zu statements removed\n", const_propagator.removedStatements());
+    }
+}
+
 void Driver_t::interpret()
 {
     DEV_ASSERT(root == nullptr);
 
-    root->accept(interpreter);
+    FlatAst_t &program = lowerToFlat();
+
+    TimeReport_t::Scope_t interpret_scope(time_report, "interpret");
+    interpreter.interpret(program);
 }
 
 void Driver_t::graphDump(const char *image_name)
@@ -65,13 +271,125 @@ void Driver_t::graphDump(const char *image_name)
     DEV_ASSERT(image_name == nullptr);
     DEV_ASSERT(root == nullptr);
 
+    TimeReport_t::Scope_t graph_scope(time_report, "graph_dump");
     graph_dumper.createGraph(image_name, *root);
 }
 
-void Driver_t::generateLLVMIR(const char *output_file)
+bool Driver_t::fetchCachedOutput(const char *source_name, const char *output_file)
+{
+    DEV_ASSERT(source_name == nullptr);
+    DEV_ASSERT(output_file == nullptr);
+
+    cache_key.clear();
+    if (compile_cache == nullptr)
+    {
+        return false;
+    }
+
+    // Only regular files can be hashed before they are parsed.
+    MappedFile_t source;
+    if (!source.open(source_name))
+    {
+        return false;
+    }
+
+    TimeReport_t::Scope_t cache_scope(time_report, "cache_fetch");
+    cache_key = compile_cache->makeKey(source.contents(), llvm_builder.describeOutput());
+    return compile_cache->fetch(cache_key, output_file);
+}
+
+bool Driver_t::generateLLVMIR(const char *output_file)
 {
     DEV_ASSERT(output_file == nullptr);
     DEV_ASSERT(root == nullptr);
 
-    llvm_builder.generateLLVMIR(output_file, *root);
+    const FlatAst_t &program = lowerToFlat();
+
+    std::string entry_name;
+    if (cache_key.empty() || !compile_cache->createEntry(entry_name))
+    {
+        return llvm_builder.generateLLVMIR(output_file, program);
+    }
+
+    // The output is built inside the cache and copied out before it is
+    // published, so a concurrent eviction can not take it away first.
+    if (!llvm_builder.generateLLVMIR(entry_name.c_str(), program))
+    {
+        compile_cache->discardEntry(entry_name);
+        return false;
+    }
+    if (!CompileCache_t::copyFile(entry_name.c_str(), output_file))
+    {
+        USER_ERR("Cannot write file: %s\n", output_file);
+        compile_cache->discardEntry(entry_name);
+        return false;
+    }
+    compile_cache->store(entry_name, cache_key);
+    return true;
+}
+
+bool Driver_t::runJIT()
+{
+    DEV_ASSERT(root == nullptr);
+
+    return llvm_builder.runJIT(lowerToFlat());
+}
+
+FlatAst_t &Driver_t::lowerToFlat()
+{
+    DEV_ASSERT(root == nullptr);
+
+    if (flat_ast.nodes.empty())
+    {
+        TimeReport_t::Scope_t flatten_scope(time_report, "flatten");
+        flat_builder.build(flat_ast, *root);
+    }
+    return flat_ast;
+}
+
+const Bytecode_t &Driver_t::lowerToBytecode()
+{
+    DEV_ASSERT(root == nullptr);
+
+    if (bytecode.code.empty())
+    {
+        TimeReport_t::Scope_t lower_scope(time_report, "bytecode_build");
+        bytecode_builder.generateBytecode(bytecode, *root);
+    }
+    return bytecode;
+}
+
+void Driver_t::runVM()
+{
+    const Bytecode_t &program = lowerToBytecode();
+
+    TimeReport_t::Scope_t run_scope(time_report, "vm_run");
+    vm.run(program);
+}
+
+bool Driver_t::emitBytecode(const char *output_file)
+{
+    DEV_ASSERT(output_file == nullptr);
+
+    const Bytecode_t &program = lowerToBytecode();
+
+    TimeReport_t::Scope_t save_scope(time_report, "bytecode_save");
+    return saveBytecode(program, output_file);
+}
+
+bool Driver_t::runBytecodeFile(const char *input_file)
+{
+    DEV_ASSERT(input_file == nullptr);
+
+    {
+        TimeReport_t::Scope_t load_scope(time_report, "bytecode_load");
+        if (!loadBytecode(bytecode, input_file))
+        {
+            return false;
+        }
+    }
+
+    TimeReport_t::Scope_t run_scope(time_report, "vm_run");
+    vm.run(bytecode);
+    return true;
 }
@@ -3,24 +3,81 @@
 #include <fstream>
 #include <map>
 #include <string>
+#include <unistd.h>
+#include <unordered_set>
 
+#include "arena.hpp"
 #include "ast.hpp"
+#include "bytecode.hpp"
+#include "bytecodeBuilder.hpp"
+#include "compileCache.hpp"
+#include "constantFolder.hpp"
+#include "constPropagator.hpp"
+#include "flatAstBuilder.hpp"
 #include "graphDump.hpp"
 #include "interpreter.hpp"
+#include "lexer.hpp"
 #include "llvmIR.hpp"
+#include "nameResolver.hpp"
+#include "nodeCounter.hpp"
+#include "timeReport.hpp"
+#include "vm.hpp"
+
+class MappedFile_t;
+class yyFlexLexer;
 
 class Driver_t
 {
 public:
+    AstArena_t arena;
+    // Scanner yylex() reads from while proceedFrontEnd() runs, only one is set.
+    Lexer_t *lexer;
+    MappedFile_t *mapped_source;
+    yyFlexLexer *flexer;
+    // Names scanned by flex, which reuses its buffer, interned for the views in tokens.
+    std::unordered_set<std::string> flex_names;
     ProgramNode_t *root;
+    NameResolver name_resolver;
+    ConstantFolder constant_folder;
+    ConstPropagator const_propagator;
+    FlatAstBuilder flat_builder;
+    // Compact form of root the interpreter and LLVMBuilder run on, the
+    // interpreter quickens its operators in place.
+    FlatAst_t flat_ast;
+    // The streamed statement being executed, reused for every statement.
+    FlatAst_t flat_statement;
     Interpreter interpreter;
     GraphDumper graph_dumper;
     LLVMBuilder llvm_builder;
+    BytecodeBuilder bytecode_builder;
+    Bytecode_t bytecode;
+    VirtualMachine vm;
+
+private:
+    bool stream_mode;
+    bool flush_each_statement;
+    int output_fd;
+    AstArena_t::Mark_t statement_mark;
+    CompileCache_t *compile_cache;
+    TimeReport_t *time_report;
+    // Key of the source fetchCachedOutput() missed, generateLLVMIR() stores under it.
+    std::string cache_key;
 
 public:
     explicit Driver_t()
         :
-            root(new ProgramNode_t())
+            lexer(nullptr),
+            mapped_source(nullptr),
+            flexer(nullptr),
+            root(arena.create<ProgramNode_t>(arena)),
+            constant_folder(arena),
+            const_propagator(arena),
+            stream_mode(false),
+            flush_each_statement(false),
+            output_fd(STDOUT_FILENO),
+            statement_mark(arena.mark()),
+            compile_cache(nullptr),
+            time_report(nullptr)
         {}
 
     Driver_t(const Driver_t&) = delete;
@@ -28,13 +85,67 @@ public:
     Driver_t(Driver_t&&) = delete;
     Driver_t &operator=(Driver_t&&) = delete;
 
+    void setCodegenOptions(const CodegenOptions_t &options)
+    {
+        llvm_builder.setOptions(options);
+    }
+
+    // In stream mode every top-level statement is interpreted as soon as it
+    // is parsed and released afterwards, root never gets any children.
+    void setStreamMode(const bool is_streaming)
+    {
+        stream_mode = is_streaming;
+    }
+
+    // Program output of every backend goes to fd instead of stdout.
+    void setOutputFd(const int fd)
+    {
+        output_fd = fd;
+        interpreter.setOutputFd(fd);
+        vm.setOutputFd(fd);
+        llvm_builder.setOutputFd(fd);
+    }
+
+    // Outputs of generateLLVMIR() are looked up in and added to cache.
+    void setCompileCache(CompileCache_t *cache)
+    {
+        compile_cache = cache;
+    }
+
+    // Every phase run from now on is timed into report, with AST node counts after parsing.
+    void setTimeReport(TimeReport_t *report)
+    {
+        time_report = report;
+        llvm_builder.setTimeReport(report);
+    }
+
+    bool isStreaming() const
+    {
+        return stream_mode;
+    }
+
+    // Maps the source into memory and scans it with Lexer_t, sources that
+    // can not be mapped and "-" (stdin) are read through the flex scanner.
+    bool proceedFrontEnd(const char *source_name);
     bool proceedFrontEnd(std::istream& source_file);
+    bool streamStatement(const RuleNode_t *statement);
+    // Writes the cached generateLLVMIR() output for source_name, which saves
+    // the whole pipeline when nothing else is needed. Must be called before
+    // the front end to let generateLLVMIR() fill the cache on a miss.
+    bool fetchCachedOutput(const char *source_name, const char *output_file);
+    void optimizeAst(unsigned opt_level, bool print_report);
+    // Builds flat_ast from root once, after the AST optimizations.
+    FlatAst_t &lowerToFlat();
     void interpret();
     void graphDump(const char *image_name);
-    void generateLLVMIR(const char *output_file);
+    bool generateLLVMIR(const char *output_file);
+    bool runJIT();
+    void runVM();
+    bool emitBytecode(const char *output_file);
+    bool runBytecodeFile(const char *input_file);
 
-    ~Driver_t()
-    {
-        delete root;
-    }
+private:
+    bool parse();
+    void reportNodeCounts();
+    const Bytecode_t &lowerToBytecode();
 };
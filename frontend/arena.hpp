@@ -0,0 +1,262 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Region allocator for AST nodes: nodes are bump-allocated from large blocks
+// and released all at once when the arena is cleared or destroyed.
+class AstArena_t
+{
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    struct Block_t
+    {
+        std::unique_ptr<std::byte[]> memory;
+        size_t size;
+    };
+
+    struct Finalizer_t
+    {
+        void (*destroy)(void *object);
+        void *object;
+    };
+
+    std::vector<Block_t> blocks;
+    std::vector<Finalizer_t> finalizers;
+    std::byte *current;
+    std::byte *end;
+    size_t used_bytes;
+
+public:
+    // Allocation state to return to with rewind().
+    struct Mark_t
+    {
+        size_t blocks_count;
+        size_t finalizers_count;
+        std::byte *current;
+        size_t used_bytes;
+    };
+
+    explicit AstArena_t()
+        :
+            current(nullptr),
+            end(nullptr),
+            used_bytes(0)
+    {}
+
+    AstArena_t(const AstArena_t&) = delete;
+    AstArena_t &operator=(const AstArena_t&) = delete;
+    AstArena_t(AstArena_t&&) = delete;
+    AstArena_t &operator=(AstArena_t&&) = delete;
+
+    template<typename Node_t, typename... Args>
+    Node_t *create(Args&&... args)
+    {
+        void *memory = allocate(sizeof(Node_t), alignof(Node_t));
+        Node_t *node = new (memory) Node_t(std::forward<Args>(args)...);
+
+        // Names and child lists live in the arena as well, only the program
+        // root keeps heap memory and needs its destructor to run.
+        if constexpr (!std::is_trivially_destructible_v<Node_t>)
+        {
+            finalizers.push_back({
+                [](void *object) { static_cast<Node_t*>(object)->~Node_t(); },
+                node
+            });
+        }
+
+        return node;
+    }
+
+    // The copy is NUL-terminated, so data() can be printed with %s.
+    std::string_view copyName(const std::string_view name)
+    {
+        char *copy = static_cast<char*>(allocate(name.size() + 1, alignof(char)));
+        memcpy(copy, name.data(), name.size());
+        copy[name.size()] = '\0';
+        return std::string_view(copy, name.size());
+    }
+
+    void *allocate(const size_t size, const size_t alignment)
+    {
+        std::byte *aligned = alignUp(current, alignment);
+        if (current == nullptr || aligned + size > end)
+        {
+            addBlock(size + alignment);
+            aligned = alignUp(current, alignment);
+        }
+
+        current = aligned + size;
+        used_bytes += size;
+        return aligned;
+    }
+
+    size_t usedBytes() const
+    {
+        return used_bytes;
+    }
+
+    size_t reservedBytes() const
+    {
+        size_t reserved = 0;
+        for (const auto &block : blocks)
+        {
+            reserved += block.size;
+        }
+        return reserved;
+    }
+
+    Mark_t mark() const
+    {
+        return {blocks.size(), finalizers.size(), current, used_bytes};
+    }
+
+    // Releases every node created after the mark. Blocks opened after it are
+    // freed, the one the mark points into is reused by the next allocation.
+    void rewind(const Mark_t &mark)
+    {
+        destroyFrom(mark.finalizers_count);
+        blocks.erase(blocks.begin() + mark.blocks_count, blocks.end());
+
+        current = mark.current;
+        end = blocks.empty() ? nullptr : blocks.back().memory.get() + blocks.back().size;
+        used_bytes = mark.used_bytes;
+    }
+
+    void clear()
+    {
+        destroyFrom(0);
+        blocks.clear();
+
+        current = nullptr;
+        end = nullptr;
+        used_bytes = 0;
+    }
+
+    ~AstArena_t()
+    {
+        clear();
+    }
+
+private:
+    void destroyFrom(const size_t first_finalizer)
+    {
+        while (finalizers.size() > first_finalizer)
+        {
+            const Finalizer_t finalizer = finalizers.back();
+            finalizers.pop_back();
+            finalizer.destroy(finalizer.object);
+        }
+    }
+
+    static std::byte *alignUp(std::byte *ptr, const size_t alignment)
+    {
+        const uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+        return reinterpret_cast<std::byte*>((address + alignment - 1) & ~(alignment - 1));
+    }
+
+    void addBlock(const size_t min_size)
+    {
+        const size_t size = min_size > BLOCK_SIZE ? min_size : BLOCK_SIZE;
+        blocks.push_back({std::unique_ptr<std::byte[]>(new std::byte[size]), size});
+
+        current = blocks.back().memory.get();
+        end = current + size;
+    }
+};
+
+// Growable array with its storage in an AstArena_t. Growing leaves the old
+// storage behind, it is released together with the nodes.
+template<typename Value_t>
+class ArenaVector_t
+{
+    static_assert(std::is_trivially_copyable_v<Value_t>);
+
+private:
+    AstArena_t *arena;
+    Value_t *values;
+    size_t count;
+    size_t capacity;
+
+public:
+    explicit ArenaVector_t(AstArena_t &arena_)
+        :
+            arena(&arena_),
+            values(nullptr),
+            count(0),
+            capacity(0)
+    {}
+
+    void reserve(const size_t new_capacity)
+    {
+        if (new_capacity <= capacity)
+        {
+            return;
+        }
+
+        Value_t *new_values = static_cast<Value_t*>(arena->allocate(new_capacity * sizeof(Value_t), alignof(Value_t)));
+        if (count != 0)
+        {
+            memcpy(new_values, values, count * sizeof(Value_t));
+        }
+        values = new_values;
+        capacity = new_capacity;
+    }
+
+    void push_back(const Value_t &value)
+    {
+        if (count == capacity)
+        {
+            reserve(capacity == 0 ? 4 : capacity * 2);
+        }
+        values[count++] = value;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    Value_t &operator[](const size_t index)
+    {
+        return values[index];
+    }
+
+    const Value_t &operator[](const size_t index) const
+    {
+        return values[index];
+    }
+
+    Value_t *begin()
+    {
+        return values;
+    }
+
+    Value_t *end()
+    {
+        return values + count;
+    }
+
+    const Value_t *begin() const
+    {
+        return values;
+    }
+
+    const Value_t *end() const
+    {
+        return values + count;
+    }
+};
@@ -3,90 +3,126 @@
 #include <cstdarg>
 #include <cstdint>
 #include <optional>
-#include <string>
+#include <string_view>
 #include <vector>
 
+#include "arena.hpp"
 #include "visitor.hpp"
 
-class Interpreter;
 class GraphDumper;
-class LLVMBuilder;
-#define DEFINE_FRIENDS friend Interpreter; friend GraphDumper; friend LLVMBuilder;
+class FlatAstBuilder;
+class NameResolver;
+class BytecodeBuilder;
+class ConstantFolder;
+class ConstPropagator;
+class NodeCounter;
+#define DEFINE_FRIENDS                                                          \
+    friend GraphDumper; friend FlatAstBuilder; friend NameResolver;             \
+    friend BytecodeBuilder; friend ConstantFolder; friend ConstPropagator;      \
+    friend NodeCounter;
 
 using AstValue_t = int64_t;
 
+// Dense index of a variable, assigned by NameResolver before any backend runs.
+using VariableSlot_t = size_t;
+constexpr VariableSlot_t UNRESOLVED_SLOT = SIZE_MAX;
+
+// Index of a declared array in ProgramNode_t::arrays.
+using ArrayId_t = size_t;
+constexpr ArrayId_t UNRESOLVED_ARRAY = SIZE_MAX;
+
+// Slots and registers are 32-bit in the backends, arrays are kept well below that.
+constexpr AstValue_t MAX_ARRAY_SIZE = 1 << 24;
+
+// Elements of an array take size consecutive slots starting from slot.
+struct AstArray_t
+{
+    VariableSlot_t slot;
+    size_t size;
+};
+
 class AstNode_t
 {
 public:
-    explicit AstNode_t() = default;
+    // Tells visitNode() which node type to cast to, nodes have no vtable.
+    const AstKind_t kind;
+
+    explicit AstNode_t(const AstKind_t kind_)
+        :
+            kind(kind_)
+    {}
 
     AstNode_t(const AstNode_t&) = delete;
     AstNode_t &operator=(const AstNode_t&) = delete;
     AstNode_t(AstNode_t&&) = delete;
     AstNode_t &operator=(AstNode_t&&) = delete;
 
-    virtual ~AstNode_t() = default;
-    virtual void accept(Visitor& visitor) const = 0;
+protected:
+    // Nodes are owned by AstArena_t and never deleted through a base pointer.
+    ~AstNode_t() = default;
 };
 
 class NonTerminalNode_t : public AstNode_t
 {
 public:
-    explicit NonTerminalNode_t() = default;
-    virtual ~NonTerminalNode_t() = default;
+    explicit NonTerminalNode_t(const AstKind_t kind_)
+        :
+            AstNode_t(kind_)
+    {}
+
+protected:
+    ~NonTerminalNode_t() = default;
 };
 
 class RuleNode_t : public AstNode_t
 {
 public:
-    explicit RuleNode_t() = default;
-    virtual ~RuleNode_t() = default;
+    explicit RuleNode_t(const AstKind_t kind_)
+        :
+            AstNode_t(kind_)
+    {}
+
+protected:
+    ~RuleNode_t() = default;
 };
 
 class ProgramNode_t : public AstNode_t
 {
 DEFINE_FRIENDS
 private:
-    std::vector<const RuleNode_t*> children_vec;
+    ArenaVector_t<const RuleNode_t*> children_vec;
+    // Array elements are counted as variables as well.
+    size_t variables_count = 0;
+    // Stays on the heap, streamed statements declare arrays and then have
+    // their nodes rewound.
+    std::vector<AstArray_t> arrays;
 
 public:
-    explicit ProgramNode_t() = default;
+    explicit ProgramNode_t(AstArena_t &arena)
+        :
+            AstNode_t(AstKind_t::PROGRAM),
+            children_vec(arena)
+    {}
 
     void addChild(const RuleNode_t *child)
     {
         children_vec.push_back(child);
     }
-
-    ~ProgramNode_t()
-    {
-        for (const auto child : children_vec)
-        {
-            delete child;
-        }
-    }
-
-    void accept(Visitor& visitor) const override
-    {
-        visitor.visit(*this);
-    }
 };
 
 class VariableNode_t : public NonTerminalNode_t
 {
 DEFINE_FRIENDS
 protected:
-    std::string name;
+    std::string_view name;
+    mutable VariableSlot_t slot = UNRESOLVED_SLOT;
 
 public:
-    explicit VariableNode_t(const std::string name_)
+    explicit VariableNode_t(const std::string_view name_)
         :
-            name(std::move(name_))
+            NonTerminalNode_t(AstKind_t::VARIABLE),
+            name(name_)
     {}
-
-    void accept(Visitor& visitor) const override
-    {
-        visitor.visit(*this);
-    }
 };
 
 class ValueNode_t : public NonTerminalNode_t
@@ -98,14 +134,9 @@ protected:
 public:
     explicit ValueNode_t(const AstValue_t value_)
         :
-            NonTerminalNode_t(),
+            NonTerminalNode_t(AstKind_t::VALUE),
             value(std::move(value_))
     {}
-
-    void accept(Visitor& visitor) const override
-    {
-        visitor.visit(*this);
-    }
 };
 
 class AndNode_t : public NonTerminalNode_t
@@ -121,20 +152,10 @@ public:
         const NonTerminalNode_t *right_
         )
         :
+            NonTerminalNode_t(AstKind_t::AND),
             left(left_),
             right(right_)
     {}
-
-    ~AndNode_t()
-    {
-        delete left;
-        delete right;
-    }
-
-    void accept(Visitor& visitor) const override
-    {
-        visitor.visit(*this);
-    }
 };
 
 class OrNode_t : public NonTerminalNode_t
@@ -150,20 +171,10 @@ public:
         const NonTerminalNode_t *right_
         )
         :
+            NonTerminalNode_t(AstKind_t::OR),
             left(left_),
             right(right_)
     {}
-
-    ~OrNode_t()
-    {
-        delete left;
-        delete right;
-    }
-
-    void accept(Visitor& visitor) const override
-    {
-        visitor.visit(*this);
-    }
 };
 
 enum class ComparatorOperators
@@ -190,21 +201,11 @@ public:
         const NonTerminalNode_t *right_
         )
         :
+            NonTerminalNode_t(AstKind_t::COMPARATOR),
             left(left_),
             right(right_),
             oper(oper_)
     {}
-
-    ~ComparatorNode_t()
-    {
-        delete left;
-        delete right;
-    }
-
-    void accept(Visitor& visitor) const override
-    {
-        visitor.visit(*this);
-    }
 };
 
 enum class ArithmeticOperators
@@ -230,21 +231,11 @@ public:
         const NonTerminalNode_t *right_
         )
         :
+            NonTerminalNode_t(AstKind_t::ARITHMETIC),
             left(left_),
             right(right_),
             oper(oper_)
     {}
-
-    ~ArithmeticNode_t()
-    {
-        delete left;
-        delete right;
-    }
-
-    void accept(Visitor& visitor) const override
-    {
-        visitor.visit(*this);
-    }
 };
 
 class NotNode_t : public NonTerminalNode_t
@@ -256,44 +247,30 @@ private:
 public:
     explicit NotNode_t(const NonTerminalNode_t *child_)
         :
+            NonTerminalNode_t(AstKind_t::NOT),
             child(child_)
     {}
-
-    ~NotNode_t()
-    {
-        delete child;
-    }
-
-    void accept(Visitor& visitor) const override
-    {
-        visitor.visit(*this);
-    }
 };
 
 class NopRuleNode_t : public RuleNode_t
 {
 DEFINE_FRIENDS
 private:
-    std::vector<const RuleNode_t*> children_vec;
+    ArenaVector_t<const RuleNode_t*> children_vec;
 
 public:
     template<typename... Args>
-    explicit NopRuleNode_t(Args... children)
+    explicit NopRuleNode_t(AstArena_t &arena, Args... children)
+        :
+            RuleNode_t(AstKind_t::NOP_RULE),
+            children_vec(arena)
     {
         (children_vec.push_back(children), ...);
     }
 
-    ~NopRuleNode_t()
-    {
-        for (const auto child : children_vec)
-        {
-            delete child;
-        }
-    }
-
-    void accept(Visitor& visitor) const override
+    void addChild(const RuleNode_t *child)
     {
-        visitor.visit(*this);
+        children_vec.push_back(child);
     }
 };
 
@@ -302,45 +279,34 @@ class AssignNode_t : public RuleNode_t
 DEFINE_FRIENDS
 private:
     const NonTerminalNode_t *value;
-    std::string name;
+    std::string_view name;
+    mutable VariableSlot_t slot = UNRESOLVED_SLOT;
 
 public:
     explicit AssignNode_t(
-            std::string name_,
+            const std::string_view name_,
             const NonTerminalNode_t *value_
             )
         :
+            RuleNode_t(AstKind_t::ASSIGN),
             value(value_),
             name(name_)
     {}
-
-    ~AssignNode_t()
-    {
-        delete value;
-    }
-
-    void accept(Visitor& visitor) const override
-    {
-        visitor.visit(*this);
-    }
 };
 
 class DeclareNode_t : public RuleNode_t
 {
 DEFINE_FRIENDS
 private:
-    std::string name;
+    std::string_view name;
+    mutable VariableSlot_t slot = UNRESOLVED_SLOT;
 
 public:
-    explicit DeclareNode_t(const std::string name_)
+    explicit DeclareNode_t(const std::string_view name_)
         :
-            name(std::move(name_))
+            RuleNode_t(AstKind_t::DECLARE),
+            name(name_)
     {}
-
-    void accept(Visitor& visitor) const override
-    {
-        visitor.visit(*this);
-    }
 };
 
 class PrintNode_t : public RuleNode_t
@@ -352,18 +318,9 @@ private:
 public:
     explicit PrintNode_t(const NonTerminalNode_t *child_)
         :
+            RuleNode_t(AstKind_t::PRINT),
             child(child_)
     {}
-
-    ~PrintNode_t()
-    {
-        delete child;
-    }
-
-    void accept(Visitor& visitor) const override
-    {
-        visitor.visit(*this);
-    }
 };
 
 class IfNode_t : public RuleNode_t
@@ -376,20 +333,10 @@ private:
 public:
     explicit IfNode_t(const NonTerminalNode_t *if_case_, const RuleNode_t *expr_)
         :
+            RuleNode_t(AstKind_t::IF),
             if_case(if_case_),
             expr(expr_)
     {}
-
-    ~IfNode_t()
-    {
-        delete if_case;
-        delete expr;
-    }
-
-    void accept(Visitor& visitor) const override
-    {
-        visitor.visit(*this);
-    }
 };
 
 class IfElseNode_t : public RuleNode_t
@@ -407,20 +354,176 @@ public:
             const RuleNode_t *false_expr_
             )
         :
+           RuleNode_t(AstKind_t::IF_ELSE),
            if_case(if_case_),
            true_expr(true_expr_),
            false_expr(false_expr_)
     {}
+};
 
-    ~IfElseNode_t()
-    {
-        delete if_case;
-        delete true_expr;
-        delete false_expr;
-    }
+class WhileNode_t : public RuleNode_t
+{
+DEFINE_FRIENDS
+private:
+    const NonTerminalNode_t *condition;
+    const RuleNode_t *body;
+
+public:
+    explicit WhileNode_t(const NonTerminalNode_t *condition_, const RuleNode_t *body_)
+        :
+            RuleNode_t(AstKind_t::WHILE),
+            condition(condition_),
+            body(body_)
+    {}
+};
+
+class ArrayDeclareNode_t : public RuleNode_t
+{
+DEFINE_FRIENDS
+private:
+    std::string_view name;
+    const AstValue_t size;
+    mutable ArrayId_t array = UNRESOLVED_ARRAY;
+
+public:
+    explicit ArrayDeclareNode_t(const std::string_view name_, const AstValue_t size_)
+        :
+            RuleNode_t(AstKind_t::ARRAY_DECLARE),
+            name(name_),
+            size(size_)
+    {}
+};
+
+// a[index]
+class ElementNode_t : public NonTerminalNode_t
+{
+DEFINE_FRIENDS
+private:
+    const NonTerminalNode_t *index;
+    std::string_view name;
+    mutable ArrayId_t array = UNRESOLVED_ARRAY;
 
-    void accept(Visitor& visitor) const override
+public:
+    explicit ElementNode_t(const std::string_view name_, const NonTerminalNode_t *index_)
+        :
+            NonTerminalNode_t(AstKind_t::ELEMENT),
+            index(index_),
+            name(name_)
+    {}
+};
+
+// a[index] = value;
+class ElementAssignNode_t : public RuleNode_t
+{
+DEFINE_FRIENDS
+private:
+    const NonTerminalNode_t *index;
+    const NonTerminalNode_t *value;
+    std::string_view name;
+    mutable ArrayId_t array = UNRESOLVED_ARRAY;
+
+public:
+    explicit ElementAssignNode_t(
+            const std::string_view name_,
+            const NonTerminalNode_t *index_,
+            const NonTerminalNode_t *value_
+            )
+        :
+            RuleNode_t(AstKind_t::ELEMENT_ASSIGN),
+            index(index_),
+            value(value_),
+            name(name_)
+    {}
+};
+
+// Same operators as in ArithmeticOperators and ComparatorOperators.
+enum class ArrayOperators
+{
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    LESS,
+    LESS_OR_EQ,
+    MORE,
+    MORE_OR_EQ,
+    EQ
+};
+
+// a[] = b[] oper c[]; applies oper to every pair of elements.
+class ArrayAssignNode_t : public RuleNode_t
+{
+DEFINE_FRIENDS
+private:
+    std::string_view name;
+    std::string_view left_name;
+    std::string_view right_name;
+    const ArrayOperators oper;
+    mutable ArrayId_t array = UNRESOLVED_ARRAY;
+    mutable ArrayId_t left = UNRESOLVED_ARRAY;
+    mutable ArrayId_t right = UNRESOLVED_ARRAY;
+
+public:
+    explicit ArrayAssignNode_t(
+            const std::string_view name_,
+            const ArrayOperators oper_,
+            const std::string_view left_name_,
+            const std::string_view right_name_
+            )
+        :
+            RuleNode_t(AstKind_t::ARRAY_ASSIGN),
+            name(name_),
+            left_name(left_name_),
+            right_name(right_name_),
+            oper(oper_)
+    {}
+};
+
+// Static double dispatch: the handler for the node type is picked by a
+// switch, so visitors are called directly and their handlers can be inlined.
+template<typename Visitor_t>
+inline bool visitNode(Visitor_t &visitor, const AstNode_t &node, const size_t step)
+{
+    switch (node.kind)
     {
-        visitor.visit(*this);
+    case AstKind_t::PROGRAM:
+        return visitor.visit(static_cast<const ProgramNode_t&>(node), step);
+    case AstKind_t::VARIABLE:
+        return visitor.visit(static_cast<const VariableNode_t&>(node), step);
+    case AstKind_t::VALUE:
+        return visitor.visit(static_cast<const ValueNode_t&>(node), step);
+    case AstKind_t::AND:
+        return visitor.visit(static_cast<const AndNode_t&>(node), step);
+    case AstKind_t::OR:
+        return visitor.visit(static_cast<const OrNode_t&>(node), step);
+    case AstKind_t::COMPARATOR:
+        return visitor.visit(static_cast<const ComparatorNode_t&>(node), step);
+    case AstKind_t::ARITHMETIC:
+        return visitor.visit(static_cast<const ArithmeticNode_t&>(node), step);
+    case AstKind_t::NOT:
+        return visitor.visit(static_cast<const NotNode_t&>(node), step);
+    case AstKind_t::NOP_RULE:
+        return visitor.visit(static_cast<const NopRuleNode_t&>(node), step);
+    case AstKind_t::ASSIGN:
+        return visitor.visit(static_cast<const AssignNode_t&>(node), step);
+    case AstKind_t::DECLARE:
+        return visitor.visit(static_cast<const DeclareNode_t&>(node), step);
+    case AstKind_t::PRINT:
+        return visitor.visit(static_cast<const PrintNode_t&>(node), step);
+    case AstKind_t::IF:
+        return visitor.visit(static_cast<const IfNode_t&>(node), step);
+    case AstKind_t::IF_ELSE:
+        return visitor.visit(static_cast<const IfElseNode_t&>(node), step);
+    case AstKind_t::WHILE:
+        return visitor.visit(static_cast<const WhileNode_t&>(node), step);
+    case AstKind_t::ARRAY_DECLARE:
+        return visitor.visit(static_cast<const ArrayDeclareNode_t&>(node), step);
+    case AstKind_t::ELEMENT:
+        return visitor.visit(static_cast<const ElementNode_t&>(node), step);
+    case AstKind_t::ELEMENT_ASSIGN:
+        return visitor.visit(static_cast<const ElementAssignNode_t&>(node), step);
+    case AstKind_t::ARRAY_ASSIGN:
+        return visitor.visit(static_cast<const ArrayAssignNode_t&>(node), step);
     }
-};
+    return false;
+}
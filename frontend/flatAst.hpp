@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ast.hpp"
+
+// Compact AST: nodes stored in pre-order in one array, so a parent is
+// followed by its first child and every subtree is a contiguous range.
+enum class FlatTag_t : uint8_t
+{
+    BLOCK,          // statements up to next
+    DECLARE,        // variables[operand] = 0
+    ASSIGN,         // variables[operand] = first child
+    PRINT,
+    IF,             // condition, body
+    IF_ELSE,        // condition, true body, false body
+    WHILE,          // condition, body
+    DECLARE_ARRAY,  // elements of arrays[operand] = 0
+    ASSIGN_ELEMENT, // arrays[operand][first child] = second child
+    ASSIGN_ARRAY,   // arrays[operand] = child, an ADD..EQ of two ARRAY leaves
+    VALUE,          // constants[operand]
+    VARIABLE,       // variables[operand]
+    ELEMENT,        // arrays[operand][child]
+    ARRAY,          // arrays[operand] as a whole, only under ASSIGN_ARRAY
+    NOT,
+    AND,
+    OR,
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    LESS,
+    LESS_OR_EQ,
+    MORE,
+    MORE_OR_EQ,
+    EQ,
+
+    // Quickened forms of ADD..EQ, in the same order. Interpreter rewrites
+    // operators on a variable and a literal or on two variables into them
+    // when it first runs them, FlatAstBuilder never emits these.
+    ADD_VAR_CONST,
+    SUB_VAR_CONST,
+    MUL_VAR_CONST,
+    DIV_VAR_CONST,
+    LESS_VAR_CONST,
+    LESS_OR_EQ_VAR_CONST,
+    MORE_VAR_CONST,
+    MORE_OR_EQ_VAR_CONST,
+    EQ_VAR_CONST,
+    ADD_VAR_VAR,
+    SUB_VAR_VAR,
+    MUL_VAR_VAR,
+    DIV_VAR_VAR,
+    LESS_VAR_VAR,
+    LESS_OR_EQ_VAR_VAR,
+    MORE_VAR_VAR,
+    MORE_OR_EQ_VAR_VAR,
+    EQ_VAR_VAR
+};
+
+struct FlatNode_t
+{
+    FlatTag_t tag;
+    // Variable slot, array id or index in FlatAst_t::constants, unused by the rest.
+    uint32_t operand;
+    // Index right past the subtree, where the next sibling starts.
+    uint32_t next;
+};
+
+static_assert(sizeof(FlatNode_t) == 12, "FlatNode_t should stay packed");
+
+// The operator a quickened tag was rewritten from, other tags are kept.
+inline FlatTag_t baseOperator(const FlatTag_t tag)
+{
+    constexpr int OPERATORS_COUNT = static_cast<int>(FlatTag_t::EQ) - static_cast<int>(FlatTag_t::ADD) + 1;
+
+    if (tag < FlatTag_t::ADD_VAR_CONST)
+    {
+        return tag;
+    }
+    const int offset = (static_cast<int>(tag) - static_cast<int>(FlatTag_t::ADD_VAR_CONST)) % OPERATORS_COUNT;
+    return static_cast<FlatTag_t>(static_cast<int>(FlatTag_t::ADD) + offset);
+}
+
+// Node 0 is the BLOCK of the top-level statements.
+struct FlatAst_t
+{
+    std::vector<FlatNode_t> nodes;
+    std::vector<AstValue_t> constants;
+    // Declared variable names, indexed by slot.
+    std::vector<std::string> names;
+    // Array elements are counted as variables as well.
+    size_t variables_count = 0;
+    std::vector<AstArray_t> arrays;
+
+    void clear()
+    {
+        nodes.clear();
+        constants.clear();
+        names.clear();
+        variables_count = 0;
+        arrays.clear();
+    }
+};
@@ -0,0 +1,237 @@
+#include <array>
+#include <cstring>
+
+#include "driver.hpp"
+#include "lexer.hpp"
+#include "log.hpp"
+#include "parser.hpp"
+
+using Token = yy::parser::token;
+
+enum CharClass : uint8_t
+{
+    CHAR_SPACE      = 1 << 0,
+    CHAR_DIGIT      = 1 << 1,
+    CHAR_NAME_START = 1 << 2,
+};
+
+static constexpr std::array<uint8_t, 256> createCharClasses()
+{
+    std::array<uint8_t, 256> classes = {};
+    classes[' '] = classes['\t'] = classes['\r'] = classes['\n'] = CHAR_SPACE;
+    for (int c = '0'; c <= '9'; ++c)
+    {
+        classes[c] = CHAR_DIGIT;
+    }
+    for (int c = 'a'; c <= 'z'; ++c)
+    {
+        classes[c] = CHAR_NAME_START;
+    }
+    for (int c = 'A'; c <= 'Z'; ++c)
+    {
+        classes[c] = CHAR_NAME_START;
+    }
+    classes['_'] = CHAR_NAME_START;
+    return classes;
+}
+
+static constexpr std::array<uint8_t, 256> char_classes = createCharClasses();
+
+static bool hasClass(const char c, const uint8_t char_class)
+{
+    return (char_classes[static_cast<unsigned char>(c)] & char_class) != 0;
+}
+
+static bool isDigit(const char c)
+{
+    return hasClass(c, CHAR_DIGIT);
+}
+
+static bool isNameStart(const char c)
+{
+    return hasClass(c, CHAR_NAME_START);
+}
+
+static bool isNameChar(const char c)
+{
+    return hasClass(c, CHAR_NAME_START | CHAR_DIGIT);
+}
+
+// Consumes digits starting at pos, accumulating them into value. The magnitude
+// of a negative number may be one larger, so that INT64_MIN is accepted.
+static bool scanDigits(const char *&pos, const char *const end, const bool negative, AstValue_t &value)
+{
+    const uint64_t limit = negative ? static_cast<uint64_t>(INT64_MAX) + 1 : static_cast<uint64_t>(INT64_MAX);
+    uint64_t magnitude = 0;
+    bool in_range = true;
+
+    for (; pos < end && isDigit(*pos); ++pos)
+    {
+        const uint64_t digit = static_cast<uint64_t>(*pos - '0');
+        if (magnitude > (limit - digit) / 10)
+        {
+            in_range = false;
+        }
+        magnitude = magnitude * 10 + digit;
+    }
+
+    value = negative ? static_cast<AstValue_t>(0 - magnitude) : static_cast<AstValue_t>(magnitude);
+    return in_range;
+}
+
+static int keywordOrName(const std::string_view name)
+{
+    switch (name.size())
+    {
+    case 2:
+        if (name == "if")
+        {
+            return Token::IF;
+        }
+        break;
+    case 4:
+        if (name == "else")
+        {
+            return Token::ELSE;
+        }
+        break;
+    case 5:
+        if (name == "print")
+        {
+            return Token::PRINT;
+        }
+        if (name == "while")
+        {
+            return Token::WHILE;
+        }
+        break;
+    case 7:
+        if (name == "declare")
+        {
+            return Token::DECLARE;
+        }
+        break;
+    default:
+        break;
+    }
+    return Token::VAR_NAME;
+}
+
+int Lexer_t::lex()
+{
+    while (current < end && hasClass(*current, CHAR_SPACE))
+    {
+        line += *current == '\n';
+        ++current;
+    }
+
+    const char *const start = current;
+    if (current == end)
+    {
+        token_text = std::string_view();
+        return Token::YYEOF;
+    }
+
+    const char c = *current++;
+    if (isNameStart(c))
+    {
+        while (current < end && isNameChar(*current))
+        {
+            ++current;
+        }
+        token_text = std::string_view(start, static_cast<size_t>(current - start));
+        return keywordOrName(token_text);
+    }
+
+    if (isDigit(c) || (c == '-' && current < end && isDigit(*current)))
+    {
+        current = c == '-' ? current : start;
+        const bool in_range = scanDigits(current, end, c == '-', token_value);
+        token_text = std::string_view(start, static_cast<size_t>(current - start));
+        if (!in_range)
+        {
+            USER_ERR("Number %.*s in line(%d) does not fit in 64 bits\n",
+                static_cast<int>(token_text.size()), token_text.data(), line);
+            return Token::YYUNDEF;
+        }
+        return Token::NUMBER;
+    }
+
+    const bool next_is_eq = current < end && *current == '=';
+    int token = Token::YYUNDEF;
+    switch (c)
+    {
+    case '=':
+        token = next_is_eq ? Token::EQUALS : Token::ASSIGN;
+        current += next_is_eq;
+        break;
+    case '<':
+        token = next_is_eq ? Token::LESS_OR_EQ : Token::LESS;
+        current += next_is_eq;
+        break;
+    case '>':
+        token = next_is_eq ? Token::MORE_OR_EQ : Token::MORE;
+        current += next_is_eq;
+        break;
+    case '&':
+    case '|':
+        if (current < end && *current == c)
+        {
+            token = c == '&' ? Token::AND : Token::OR;
+            ++current;
+        }
+        break;
+    case '+':
+        token = Token::ADD;
+        break;
+    case '-':
+        token = Token::SUB;
+        break;
+    case '*':
+        token = Token::MUL;
+        break;
+    case '/':
+        token = Token::DIV;
+        break;
+    case '!':
+        token = Token::NOT;
+        break;
+    case '(':
+        token = Token::LBRACKET;
+        break;
+    case ')':
+        token = Token::RBRACKET;
+        break;
+    case '[':
+        token = Token::LSQUARE;
+        break;
+    case ']':
+        token = Token::RSQUARE;
+        break;
+    case '{':
+        token = Token::LBRACE;
+        break;
+    case '}':
+        token = Token::RBRACE;
+        break;
+    case ';':
+        token = Token::SEMICOLON;
+        break;
+    default:
+        break;
+    }
+
+    token_text = std::string_view(start, static_cast<size_t>(current - start));
+    return token;
+}
+
+bool Lexer_t::parseNumber(const std::string_view digits, AstValue_t &value)
+{
+    const char *pos = digits.data();
+    const char *const end = digits.data() + digits.size();
+
+    const bool negative = pos < end && *pos == '-';
+    pos += negative;
+
+    return scanDigits(pos, end, negative, value) && pos == end;
+}
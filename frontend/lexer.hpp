@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string_view>
+
+#include "ast.hpp"
+
+// Hand-written scanner over a source held in memory (normally a MappedFile_t).
+// Accepts the same tokens as scanner.l, but VAR_NAME text is a view into
+// the source and NUMBER is converted to AstValue_t while it is scanned.
+class Lexer_t
+{
+private:
+    const char *current;
+    const char *end;
+    std::string_view token_text;
+    AstValue_t token_value;
+    int line;
+
+public:
+    explicit Lexer_t(std::string_view source)
+        :
+            current(source.data()),
+            end(source.data() + source.size()),
+            token_value(0),
+            line(1)
+    {}
+
+    // Returns the next yy::parser token, 0 at the end of the source.
+    int lex();
+
+    // Text of the last token, valid as long as the source is.
+    std::string_view YYText() const
+    {
+        return token_text;
+    }
+
+    // Value of the last NUMBER token.
+    AstValue_t value() const
+    {
+        return token_value;
+    }
+
+    int lineno() const
+    {
+        return line;
+    }
+
+    // Everything before this point has been scanned.
+    const char *position() const
+    {
+        return current;
+    }
+
+    // Converts a NUMBER token ([-]?[0-9]+) to AstValue_t, fails on overflow.
+    static bool parseNumber(std::string_view digits, AstValue_t &value);
+};
@@ -9,15 +9,17 @@
 %code provides {
     int yylex(
         yy::parser::semantic_type* yylval,
-        yy::parser::location_type* yylloc
+        yy::parser::location_type* yylloc,
+        Driver_t &driver
         );
 }
 
 %parse-param { Driver_t &driver }
+%lex-param { Driver_t &driver }
 
 %token DECLARE
-%token <std::string> VAR_NAME
-%token <std::string> NUMBER
+%token <std::string_view> VAR_NAME
+%token <AstValue_t> NUMBER
 
 %precedence NOT
 
@@ -39,15 +41,21 @@
 %token RBRACE
 %token LBRACKET
 %token RBRACKET
+%token LSQUARE
+%token RSQUARE
 %token SEMICOLON
 
 %token IF
 %token ELSE
 %token PRINT
+%token WHILE
 
 %type <const VariableNode_t*> var_node
 %type <const ValueNode_t*> number_node
+%type <const ElementNode_t*> element_node
+%type <ArrayOperators> array_oper
 %type <const RuleNode_t*> expr
+%type <NopRuleNode_t*> expr_list
 %type <ProgramNode_t*> all_expr
 %type <const NonTerminalNode_t*> ast_node_leaf;
 %type <const NonTerminalNode_t*> ast_logic_node
@@ -68,7 +76,17 @@ all_expr:
 |
     all_expr expr
     {
-        $1->addChild($2);
+        if (driver.isStreaming())
+        {
+            if (!driver.streamStatement($2))
+            {
+                YYABORT;
+            }
+        }
+        else
+        {
+            $1->addChild($2);
+        }
         $$ = $1;
     }
 ;
@@ -76,32 +94,122 @@ all_expr:
 expr:
     PRINT LBRACKET ast_logic_node RBRACKET SEMICOLON
     {
-        $$ = new PrintNode_t($3);
+        $$ = driver.arena.create<PrintNode_t>($3);
     }
 |
     IF LBRACKET ast_logic_node RBRACKET LBRACE expr RBRACE
     {
-        $$ = new IfNode_t($3, $6);
+        $$ = driver.arena.create<IfNode_t>($3, $6);
     }
 |
     IF LBRACKET ast_logic_node RBRACKET LBRACE expr RBRACE ELSE LBRACE expr RBRACE
     {
-        $$ = new IfElseNode_t($3, $6, $10);
+        $$ = driver.arena.create<IfElseNode_t>($3, $6, $10);
+    }
+|
+    WHILE LBRACKET ast_logic_node RBRACKET LBRACE expr_list RBRACE
+    {
+        $$ = driver.arena.create<WhileNode_t>($3, $6);
     }
 |
     DECLARE VAR_NAME SEMICOLON
     {
-        $$ = new DeclareNode_t($2);
+        $$ = driver.arena.create<DeclareNode_t>(driver.arena.copyName($2));
     }
 |
     DECLARE VAR_NAME ASSIGN ast_logic_node SEMICOLON
     {
-        $$ = new NopRuleNode_t(new DeclareNode_t($2), new AssignNode_t($2, $4));
+        const std::string_view name = driver.arena.copyName($2);
+        $$ = driver.arena.create<NopRuleNode_t>(
+            driver.arena,
+            driver.arena.create<DeclareNode_t>(name),
+            driver.arena.create<AssignNode_t>(name, $4)
+        );
     }
 |
     VAR_NAME ASSIGN ast_logic_node SEMICOLON
     {
-        $$ = new AssignNode_t($1, $3);
+        $$ = driver.arena.create<AssignNode_t>(driver.arena.copyName($1), $3);
+    }
+|
+    DECLARE VAR_NAME LSQUARE NUMBER RSQUARE SEMICOLON
+    {
+        $$ = driver.arena.create<ArrayDeclareNode_t>(driver.arena.copyName($2), $4);
+    }
+|
+    VAR_NAME LSQUARE ast_logic_node RSQUARE ASSIGN ast_logic_node SEMICOLON
+    {
+        $$ = driver.arena.create<ElementAssignNode_t>(driver.arena.copyName($1), $3, $6);
+    }
+|
+    VAR_NAME LSQUARE RSQUARE ASSIGN VAR_NAME LSQUARE RSQUARE array_oper VAR_NAME LSQUARE RSQUARE SEMICOLON
+    {
+        $$ = driver.arena.create<ArrayAssignNode_t>(
+            driver.arena.copyName($1),
+            $8,
+            driver.arena.copyName($5),
+            driver.arena.copyName($9)
+        );
+    }
+;
+
+array_oper:
+    ADD
+    {
+        $$ = ArrayOperators::ADD;
+    }
+|
+    SUB
+    {
+        $$ = ArrayOperators::SUB;
+    }
+|
+    MUL
+    {
+        $$ = ArrayOperators::MUL;
+    }
+|
+    DIV
+    {
+        $$ = ArrayOperators::DIV;
+    }
+|
+    LESS
+    {
+        $$ = ArrayOperators::LESS;
+    }
+|
+    LESS_OR_EQ
+    {
+        $$ = ArrayOperators::LESS_OR_EQ;
+    }
+|
+    MORE
+    {
+        $$ = ArrayOperators::MORE;
+    }
+|
+    MORE_OR_EQ
+    {
+        $$ = ArrayOperators::MORE_OR_EQ;
+    }
+|
+    EQUALS
+    {
+        $$ = ArrayOperators::EQ;
+    }
+;
+
+expr_list:
+    %empty
+    {
+        $$ = driver.arena.create<NopRuleNode_t>(driver.arena);
+    }
+|
+    expr_list expr
+    {
+        $1->addChild($2);
+        $$ = $1;
     }
 ;
 
@@ -120,12 +228,12 @@ ast_node_and_or:
 |
     ast_logic_node AND ast_logic_node
     {
-        $$ = new AndNode_t($1, $3);
+        $$ = driver.arena.create<AndNode_t>($1, $3);
     }
 |
     ast_logic_node OR ast_logic_node
     {
-        $$ = new OrNode_t($1, $3);
+        $$ = driver.arena.create<OrNode_t>($1, $3);
     }
 ;
 
@@ -137,27 +245,27 @@ ast_node_compare:
 |
     ast_node_add LESS ast_node_add
     {
-        $$ = new ComparatorNode_t(ComparatorOperators::LESS, $1, $3);
+        $$ = driver.arena.create<ComparatorNode_t>(ComparatorOperators::LESS, $1, $3);
     }
 |
     ast_node_add LESS_OR_EQ ast_node_add
     {
-        $$ = new ComparatorNode_t(ComparatorOperators::LESS_OR_EQ, $1, $3);
+        $$ = driver.arena.create<ComparatorNode_t>(ComparatorOperators::LESS_OR_EQ, $1, $3);
     }
 |
     ast_node_add MORE ast_node_add
     {
-        $$ = new ComparatorNode_t(ComparatorOperators::MORE, $1, $3);
+        $$ = driver.arena.create<ComparatorNode_t>(ComparatorOperators::MORE, $1, $3);
     }
 |
     ast_node_add MORE_OR_EQ ast_node_add
     {
-        $$ = new ComparatorNode_t(ComparatorOperators::MORE_OR_EQ, $1, $3);
+        $$ = driver.arena.create<ComparatorNode_t>(ComparatorOperators::MORE_OR_EQ, $1, $3);
     }
 |
     ast_node_add EQUALS ast_node_add
     {
-        $$ = new ComparatorNode_t(ComparatorOperators::EQ, $1, $3);
+        $$ = driver.arena.create<ComparatorNode_t>(ComparatorOperators::EQ, $1, $3);
     }
 ;
 
@@ -169,12 +277,12 @@ ast_node_add:
 |
     ast_node_mul ADD ast_node_mul
     {
-        $$ = new ArithmeticNode_t(ArithmeticOperators::ADD, $1, $3);
+        $$ = driver.arena.create<ArithmeticNode_t>(ArithmeticOperators::ADD, $1, $3);
     }
 |
     ast_node_mul SUB ast_node_mul
     {
-        $$ = new ArithmeticNode_t(ArithmeticOperators::SUB, $1, $3);
+        $$ = driver.arena.create<ArithmeticNode_t>(ArithmeticOperators::SUB, $1, $3);
     }
 ;
 
@@ -186,12 +294,12 @@ ast_node_mul:
 |
     ast_node_brackets MUL ast_node_brackets
     {
-        $$ = new ArithmeticNode_t(ArithmeticOperators::MUL, $1, $3);
+        $$ = driver.arena.create<ArithmeticNode_t>(ArithmeticOperators::MUL, $1, $3);
     }
 |
     ast_node_brackets DIV ast_node_brackets
     {
-        $$ = new ArithmeticNode_t(ArithmeticOperators::DIV, $1, $3);
+        $$ = driver.arena.create<ArithmeticNode_t>(ArithmeticOperators::DIV, $1, $3);
     }
 ;
 
@@ -215,7 +323,7 @@ ast_node_not:
 |
     NOT ast_node_brackets
     {
-        $$ = new NotNode_t($2);
+        $$ = driver.arena.create<NotNode_t>($2);
     }
 ;
 
@@ -229,19 +337,31 @@ ast_node_leaf:
     {
         $$ = $1;
     }
+|
+    element_node
+    {
+        $$ = $1;
+    }
 ;
 
 var_node:
     VAR_NAME
     {
-        $$ = new VariableNode_t($1);
+        $$ = driver.arena.create<VariableNode_t>(driver.arena.copyName($1));
+    }
+;
+
+element_node:
+    VAR_NAME LSQUARE ast_logic_node RSQUARE
+    {
+        $$ = driver.arena.create<ElementNode_t>(driver.arena.copyName($1), $3);
     }
 ;
 
 number_node:
     NUMBER
     {
-        $$ = new ValueNode_t(atoi($1.c_str()));
+        $$ = driver.arena.create<ValueNode_t>($1);
     }
 ;
 
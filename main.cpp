@@ -1,54 +1,219 @@
+#include <atomic>
 #include <boost/program_options.hpp>
 #include <cstdio>
+#include <fcntl.h>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <optional>
+#include <sstream>
 #include <string>
+#include <unistd.h>
+#include <vector>
 
+#include "compileCache.hpp"
 #include "driver.hpp"
 #include "log.hpp"
+#include "server.hpp"
+#include "threadPool.hpp"
 
 namespace arg_parser = boost::program_options;
 
 struct ProgramSettings_t
 {
     bool interpret_mode;
+    bool vm_mode;
+    bool jit_mode;
+    bool opt_report;
+    bool flex_lexer;
+    bool stream_mode;
+    CodegenOptions_t codegen_options;
     std::string input_file_name;
     std::optional<std::string> graph_dump_file_name;
     std::optional<std::string> output_file_name;
+    std::optional<std::string> bytecode_file_name;
+    std::optional<std::string> batch_file_name;
+    size_t jobs_count;
+    // In batch mode LLVM output is written next to every input.
+    bool batch_emit;
+    std::optional<std::string> serve_socket_name;
+    std::optional<std::string> cache_dir_name;
+    size_t cache_size_mb;
+    bool cache_stats;
+    // "-" prints the report through the log, anything else is a JSON file.
+    std::optional<std::string> time_report_file_name;
 };
 
+static bool isBytecodeFile(const std::string &file_name)
+{
+    static const std::string extension = ".mbc";
+    return file_name.size() >= extension.size() &&
+           file_name.compare(file_name.size() - extension.size(), extension.size(), extension) == 0;
+}
+
 static arg_parser::options_description createParser()
 {
     arg_parser::options_description desc("Allowed options:");
     desc.add_options()
         ("help", "print help message")
-        ("input", arg_parser::value<std::string>()->required(), "path to source file")
+        ("input", arg_parser::value<std::string>(), "path to source file, .mbc bytecode file or - for stdin")
+        ("batch", arg_parser::value<std::string>(), "file listing one input per line, each is processed on a thread pool and prints to <input>.out")
+        ("jobs,j", arg_parser::value<size_t>()->default_value(0), "worker threads for --batch and --serve, 0 means one per core")
+        ("cache-dir", arg_parser::value<std::string>(), "reuse LLVM output for sources compiled before with the same options, kept in this directory")
+        ("cache-size", arg_parser::value<size_t>()->default_value(1024), "cache size limit in MiB, least recently used outputs are evicted")
+        ("cache-stats", "print cache hits and misses")
+        ("time-report", arg_parser::value<std::string>()->implicit_value("-"), "report time and peak memory of every phase and AST node counts, to stderr or to the given JSON file")
+        ("serve", arg_parser::value<std::string>(), "keep running and handle compiler_client requests arriving on this Unix socket")
         ("interpret", "interpret given program after parsing")
+        ("stream", "interpret every statement as soon as it is parsed and free it afterwards")
+        ("vm", "run given program on the bytecode virtual machine")
+        ("jit", "compile given program with LLVM JIT and run it in-process")
         ("graph-dump", arg_parser::value<std::string>(), "create AST dump to the provided .png file")
-        ("output", arg_parser::value<std::string>(), "path to .ll output file");
+        ("output", arg_parser::value<std::string>(), "path to output file of the LLVM backend")
+        ("emit", arg_parser::value<std::string>()->default_value("ll"), "kind of --output file: obj, asm, bc or ll, with --batch written to <input>.<kind>")
+        ("opt-level,O", arg_parser::value<unsigned>()->default_value(0), "optimization level: -O0, -O1, -O2 or -O3")
+        ("time-passes", "print time spent in every LLVM optimization pass")
+        ("codegen-chunks", arg_parser::value<size_t>()->default_value(0), "split top-level statements into this many functions optimized and compiled on parallel threads, 0 keeps one main")
+        ("opt-report", "print what AST optimizations have removed")
+        ("flex-lexer", "read the source with the flex scanner instead of mapping it into memory")
+        ("emit-bytecode", arg_parser::value<std::string>(), "path to .mbc bytecode output file");
 
     return desc;
 }
 
-static ProgramSettings_t parseCmd(const int argc, const char **argv, const arg_parser::options_description desc)
+// Returns false when the program must stop, with the reason (or help) in messages.
+static bool parseCmd(
+    const int argc,
+    const char **argv,
+    const arg_parser::options_description &desc,
+    ProgramSettings_t &program_settings,
+    std::ostream &messages
+    )
 {
     arg_parser::variables_map var_map;
-    arg_parser::store(arg_parser::parse_command_line(argc, argv, desc), var_map);
+    try
+    {
+        arg_parser::store(arg_parser::parse_command_line(argc, argv, desc), var_map);
+
+        if (var_map.count("help"))
+        {
+            messages << desc << '\n';
+            return false;
+        }
 
-    if (var_map.count("help"))
+        arg_parser::notify(var_map);
+    }
+    catch (const arg_parser::error &error)
     {
-        std::cout << desc << '\n';
-        exit(1);
+        messages << error.what() << '\n';
+        return false;
     }
 
-    arg_parser::notify(var_map);
-
-    ProgramSettings_t program_settings;
     program_settings.interpret_mode = var_map.count("interpret") > 0;
-    program_settings.input_file_name = std::move(var_map["input"].as<std::string>());
+    program_settings.vm_mode = var_map.count("vm") > 0;
+    program_settings.jit_mode = var_map.count("jit") > 0;
+    program_settings.opt_report = var_map.count("opt-report") > 0;
+    program_settings.flex_lexer = var_map.count("flex-lexer") > 0;
+    program_settings.stream_mode = var_map.count("stream") > 0;
+    program_settings.codegen_options.opt_level = var_map["opt-level"].as<unsigned>();
+    program_settings.codegen_options.time_passes = var_map.count("time-passes") > 0;
+    program_settings.codegen_options.codegen_chunks = var_map["codegen-chunks"].as<size_t>();
+
+    static const std::map<std::string, EmitKind> emit_kinds = {
+        {"ll",  EmitKind::LL},
+        {"bc",  EmitKind::BC},
+        {"asm", EmitKind::ASM},
+        {"obj", EmitKind::OBJ}
+    };
+    const auto emit_kind = emit_kinds.find(var_map["emit"].as<std::string>());
+    if (emit_kind == emit_kinds.end())
+    {
+        messages << "Invalid --emit value: " << var_map["emit"].as<std::string>() << '\n';
+        return false;
+    }
+    program_settings.codegen_options.emit_kind = emit_kind->second;
+
+    if (program_settings.codegen_options.opt_level > 3)
+    {
+        messages << "Invalid optimization level: -O" << program_settings.codegen_options.opt_level << '\n';
+        return false;
+    }
+    // Pass timers are process wide, chunks are optimized on several threads.
+    if (program_settings.codegen_options.codegen_chunks > 1 && program_settings.codegen_options.time_passes)
+    {
+        messages << "--codegen-chunks can not be combined with --time-passes\n";
+        return false;
+    }
+    if (var_map.count("input") + var_map.count("batch") + var_map.count("serve") != 1)
+    {
+        messages << "Exactly one of --input, --batch and --serve is required\n";
+        return false;
+    }
+    if (var_map.count("input") > 0)
+    {
+        program_settings.input_file_name = std::move(var_map["input"].as<std::string>());
+    }
+    program_settings.batch_file_name = std::nullopt;
+    program_settings.serve_socket_name = std::nullopt;
+    if (var_map.count("serve") > 0)
+    {
+        program_settings.serve_socket_name = std::move(var_map["serve"].as<std::string>());
+    }
+    program_settings.jobs_count = var_map["jobs"].as<size_t>();
+    program_settings.cache_dir_name = std::nullopt;
+    if (var_map.count("cache-dir") > 0)
+    {
+        program_settings.cache_dir_name = std::move(var_map["cache-dir"].as<std::string>());
+    }
+    program_settings.cache_size_mb = var_map["cache-size"].as<size_t>();
+    program_settings.cache_stats = var_map.count("cache-stats") > 0;
+    program_settings.time_report_file_name = std::nullopt;
+    if (var_map.count("time-report") > 0)
+    {
+        program_settings.time_report_file_name = std::move(var_map["time-report"].as<std::string>());
+    }
+    program_settings.batch_emit = false;
+
+    if (var_map.count("batch") > 0)
+    {
+        program_settings.batch_file_name = std::move(var_map["batch"].as<std::string>());
+        program_settings.batch_emit = !var_map["emit"].defaulted();
+
+        // These name a single file or write to a process wide state.
+        const char *const single_input_options[] = {
+            "graph-dump", "output", "emit-bytecode", "time-passes", "time-report"
+        };
+        for (const char *option : single_input_options)
+        {
+            if (var_map.count(option) > 0)
+            {
+                messages << "--batch can not be combined with --" << option << '\n';
+                return false;
+            }
+        }
+    }
+
+    // Statements are gone once they are executed, nothing else can run on them.
+    const char *const whole_program_options[] = {
+        "vm", "jit", "graph-dump", "output", "emit-bytecode"
+    };
+    for (const char *option : whole_program_options)
+    {
+        if (program_settings.stream_mode && var_map.count(option) > 0)
+        {
+            messages << "--stream can not be combined with --" << option << '\n';
+            return false;
+        }
+    }
+    if (program_settings.stream_mode && program_settings.codegen_options.opt_level > 0)
+    {
+        messages << "--stream can not be combined with -O" << program_settings.codegen_options.opt_level << '\n';
+        return false;
+    }
     program_settings.graph_dump_file_name = std::nullopt;
     program_settings.output_file_name = std::nullopt;
+    program_settings.bytecode_file_name = std::nullopt;
 
     if (var_map.count("graph-dump") > 0)
     {
@@ -59,29 +224,64 @@ static ProgramSettings_t parseCmd(const int argc, const char **argv, const arg_p
     {
         program_settings.output_file_name = std::move(var_map["output"].as<std::string>());
     }
-    return program_settings;
+
+    if (var_map.count("emit-bytecode") > 0)
+    {
+        program_settings.bytecode_file_name = std::move(var_map["emit-bytecode"].as<std::string>());
+    }
+    return true;
 }
 
-int main(int argc, const char **argv)
+// Runs every stage requested in settings on one input, program output and
+// LLVM output go where driver and output_file_name say.
+static bool runPipeline(
+    Driver_t &driver,
+    const ProgramSettings_t &settings,
+    const std::string &input_file_name,
+    const std::optional<std::string> &output_file_name
+    )
 {
-    const arg_parser::options_description desc = createParser();
-    const ProgramSettings_t settings = parseCmd(argc, argv, desc);
-
-    Driver_t driver;
+    // Precompiled bytecode skips the whole frontend.
+    if (isBytecodeFile(input_file_name))
+    {
+        return driver.runBytecodeFile(input_file_name.c_str());
+    }
 
-    if (!initLogging("compiler_log.txt"))
+    // A cached output of the requested kind makes the front end unnecessary
+    // unless something else needs the AST as well.
+    bool is_output_written = false;
+    if (output_file_name.has_value() && input_file_name != "-" && !settings.stream_mode)
     {
-        fprintf(stderr, "Failed to init log library!\n");
+        is_output_written = driver.fetchCachedOutput(input_file_name.c_str(), output_file_name.value().c_str());
+        if (is_output_written && !settings.interpret_mode && !settings.vm_mode && !settings.jit_mode &&
+            !settings.graph_dump_file_name.has_value() && !settings.bytecode_file_name.has_value())
+        {
+            return true;
+        }
     }
 
-    std::ifstream user_input(settings.input_file_name);
-    if(!user_input) {
-        USER_ERR("Cannot open file: %s\n", settings.input_file_name.c_str());
-        return -1;
+    bool isSuccess = false;
+    if (settings.flex_lexer && input_file_name != "-")
+    {
+        std::ifstream user_input(input_file_name);
+        if(!user_input) {
+            USER_ERR("Cannot open file: %s\n", input_file_name.c_str());
+            return false;
+        }
+        isSuccess = driver.proceedFrontEnd(user_input);
     }
-    const bool isSuccess = driver.proceedFrontEnd(user_input);
-    if (!isSuccess) {
-        return -1;
+    else
+    {
+        isSuccess = driver.proceedFrontEnd(input_file_name.c_str());
+    }
+    if (!isSuccess || settings.stream_mode) {
+        return isSuccess;
+    }
+
+    // AST optimizations are shared by every backend.
+    if (settings.codegen_options.opt_level > 0)
+    {
+        driver.optimizeAst(settings.codegen_options.opt_level, settings.opt_report);
     }
 
     if (settings.graph_dump_file_name.has_value())
@@ -92,12 +292,294 @@ int main(int argc, const char **argv)
     {
         driver.interpret();
     }
-    if (settings.output_file_name.has_value()) {
-        driver.generateLLVMIR(settings.output_file_name.value().c_str());
+    if (settings.vm_mode)
+    {
+        driver.runVM();
+    }
+    if (settings.bytecode_file_name.has_value())
+    {
+        isSuccess &= driver.emitBytecode(settings.bytecode_file_name.value().c_str());
+    }
+    if (output_file_name.has_value() && !is_output_written) {
+        isSuccess &= driver.generateLLVMIR(output_file_name.value().c_str());
+    }
+    // JIT takes ownership of the LLVM module, so it goes after IR output.
+    if (settings.jit_mode)
+    {
+        isSuccess &= driver.runJIT();
+    }
+
+    return isSuccess;
+}
+
+// Every input gets a Driver_t of its own, and with it its own arena and
+// LLVMContext, so jobs share nothing but the log.
+static bool runBatchJob(const ProgramSettings_t &settings, CompileCache_t *cache, const std::string &input_file_name)
+{
+    static const std::map<EmitKind, const char*> emit_extensions = {
+        {EmitKind::LL,  ".ll"},
+        {EmitKind::BC,  ".bc"},
+        {EmitKind::ASM, ".s"},
+        {EmitKind::OBJ, ".o"}
+    };
+
+    const std::string program_output_name = input_file_name + ".out";
+    const int program_output = open(program_output_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (program_output < 0)
+    {
+        USER_ERR("Cannot open file: %s\n", program_output_name.c_str());
+        return false;
+    }
+
+    std::optional<std::string> output_file_name = std::nullopt;
+    if (settings.batch_emit)
+    {
+        output_file_name = input_file_name + emit_extensions.at(settings.codegen_options.emit_kind);
+    }
+
+    bool isSuccess = false;
+    {
+        // The driver flushes program output on destruction, before the file is closed.
+        Driver_t driver;
+        driver.setCodegenOptions(settings.codegen_options);
+        driver.setStreamMode(settings.stream_mode);
+        driver.setOutputFd(program_output);
+        driver.setCompileCache(cache);
+
+        isSuccess = runPipeline(driver, settings, input_file_name, output_file_name);
+    }
+
+    close(program_output);
+    return isSuccess;
+}
+
+static bool runBatch(const ProgramSettings_t &settings, CompileCache_t *cache)
+{
+    std::ifstream batch_file(settings.batch_file_name.value());
+    if (!batch_file)
+    {
+        USER_ERR("Cannot open file: %s\n", settings.batch_file_name.value().c_str());
+        return false;
+    }
+
+    std::vector<std::string> inputs;
+    for (std::string line; std::getline(batch_file, line);)
+    {
+        if (!line.empty())
+        {
+            inputs.push_back(std::move(line));
+        }
+    }
+
+    std::atomic<size_t> failed_count = 0;
+    {
+        ThreadPool_t pool(settings.jobs_count);
+        for (const auto &input : inputs)
+        {
+            pool.submit([&settings, cache, &input, &failed_count]()
+            {
+                if (!runBatchJob(settings, cache, input))
+                {
+                    USER_ERR("Failed to process %s\n", input.c_str());
+                    ++failed_count;
+                }
+            });
+        }
+    }
+
+    if (failed_count > 0)
+    {
+        USER_ERR("%zu of %zu inputs failed\n", failed_count.load(), inputs.size());
+    }
+    return failed_count == 0;
+}
+
+// Null without --cache-dir, a cache that can not be opened is reported and skipped.
+static std::unique_ptr<CompileCache_t> openCompileCache(const ProgramSettings_t &settings)
+{
+    if (!settings.cache_dir_name.has_value())
+    {
+        return nullptr;
+    }
+
+    auto cache = std::make_unique<CompileCache_t>(settings.cache_dir_name.value(), settings.cache_size_mb << 20);
+    if (!cache->open())
+    {
+        return nullptr;
+    }
+    return cache;
+}
+
+// Paths in a request are relative to the client's directory and "-" means
+// the client's own stream, the server has neither.
+static void resolveRequestPath(std::string &path, const ServerRequest_t &request, const int std_fd)
+{
+    if (path == "-")
+    {
+        path = "/proc/self/fd/" + std::to_string(request.fds[std_fd]);
+    }
+    else if (!path.empty() && path.front() != '/')
+    {
+        path = request.working_dir + "/" + path;
+    }
+}
+
+static void resolveRequestPath(std::optional<std::string> &path, const ServerRequest_t &request, const int std_fd)
+{
+    if (path.has_value())
+    {
+        resolveRequestPath(path.value(), request, std_fd);
+    }
+}
+
+// Runs one client command line the way a fresh process would, with program
+// output going to the client's stdout and diagnostics to its stderr.
+static int handleServerRequest(
+    const arg_parser::options_description &desc,
+    CompileCache_t *server_cache,
+    const ServerRequest_t &request
+    )
+{
+    std::vector<const char*> argv = {"compiler"};
+    for (const auto &arg : request.args)
+    {
+        argv.push_back(arg.c_str());
+    }
+
+    ProgramSettings_t settings;
+    std::ostringstream messages;
+    if (!parseCmd(static_cast<int>(argv.size()), argv.data(), desc, settings, messages))
+    {
+        // Nobody is left to tell if the client's stdout is gone.
+        const std::string text = messages.str();
+        [[maybe_unused]] const ssize_t written = write(request.fds[STDOUT_FILENO], text.data(), text.size());
+        return 1;
+    }
+
+    // A user program can abort, trap or never end, and it would take the
+    // server and every request in flight down with it.
+    if (settings.interpret_mode || settings.vm_mode || settings.jit_mode || settings.stream_mode ||
+        isBytecodeFile(settings.input_file_name))
+    {
+        return RUN_LOCALLY_EXIT_CODE;
+    }
+
+    FILE *client_err = fdopen(dup(request.fds[STDERR_FILENO]), "w");
+    if (client_err == nullptr)
+    {
+        return -1;
+    }
+    FILE *previous_sink = setThreadLogSink(client_err);
+
+    bool isSuccess = false;
+    // Batch inputs would need every listed path resolved and LLVM pass
+    // timers are process wide, both are left to a standalone compiler.
+    if (settings.serve_socket_name.has_value() || settings.batch_file_name.has_value() ||
+        settings.codegen_options.time_passes || settings.time_report_file_name.has_value())
+    {
+        USER_ERR("--serve, --batch, --time-passes and --time-report cannot be sent to a server\n");
+    }
+    else
+    {
+        resolveRequestPath(settings.input_file_name, request, STDIN_FILENO);
+        resolveRequestPath(settings.output_file_name, request, STDOUT_FILENO);
+        resolveRequestPath(settings.graph_dump_file_name, request, STDOUT_FILENO);
+        resolveRequestPath(settings.bytecode_file_name, request, STDOUT_FILENO);
+        resolveRequestPath(settings.cache_dir_name, request, STDOUT_FILENO);
+
+        // The server's cache unless the request names its own.
+        const std::unique_ptr<CompileCache_t> request_cache = openCompileCache(settings);
+        CompileCache_t *cache = request_cache != nullptr ? request_cache.get() : server_cache;
+
+        Driver_t driver;
+        driver.setCodegenOptions(settings.codegen_options);
+        driver.setStreamMode(settings.stream_mode);
+        driver.setOutputFd(request.fds[STDOUT_FILENO]);
+        driver.setCompileCache(cache);
+
+        isSuccess = runPipeline(driver, settings, settings.input_file_name, settings.output_file_name);
+        if (cache != nullptr && settings.cache_stats)
+        {
+            cache->printStats();
+        }
+    }
+
+    setThreadLogSink(previous_sink);
+    fclose(client_err);
+    return isSuccess ? 0 : -1;
+}
+
+static bool runServer(
+    const arg_parser::options_description &desc,
+    const ProgramSettings_t &settings,
+    CompileCache_t *cache
+    )
+{
+    CompileServer_t server([&desc, cache](const ServerRequest_t &request)
+    {
+        return handleServerRequest(desc, cache, request);
+    }, settings.jobs_count);
+
+    return server.serve(settings.serve_socket_name.value().c_str());
+}
+
+int main(int argc, const char **argv)
+{
+    const arg_parser::options_description desc = createParser();
+    ProgramSettings_t settings;
+    if (!parseCmd(argc, argv, desc, settings, std::cout))
+    {
+        return 1;
+    }
+
+    if (!initLogging("compiler_log.txt"))
+    {
+        fprintf(stderr, "Failed to init log library!\n");
+    }
+
+    const std::unique_ptr<CompileCache_t> cache = openCompileCache(settings);
+
+    bool isSuccess = false;
+    if (settings.serve_socket_name.has_value())
+    {
+        isSuccess = runServer(desc, settings, cache.get());
+    }
+    else if (settings.batch_file_name.has_value())
+    {
+        isSuccess = runBatch(settings, cache.get());
+    }
+    else
+    {
+        TimeReport_t time_report;
+        Driver_t driver;
+        driver.setCodegenOptions(settings.codegen_options);
+        driver.setStreamMode(settings.stream_mode);
+        driver.setCompileCache(cache.get());
+        if (settings.time_report_file_name.has_value())
+        {
+            driver.setTimeReport(&time_report);
+        }
+
+        isSuccess = runPipeline(driver, settings, settings.input_file_name, settings.output_file_name);
+
+        if (settings.time_report_file_name == "-")
+        {
+            time_report.print();
+        }
+        else if (settings.time_report_file_name.has_value())
+        {
+            isSuccess &= time_report.writeJson(settings.time_report_file_name.value().c_str());
+        }
+    }
+
+    if (cache != nullptr && settings.cache_stats)
+    {
+        cache->printStats();
     }
 
     if (!deinitLogging())
     {
         fprintf(stderr, "Failed to deinit log library!\n");
     }
-}
\ No newline at end of file
+    return isSuccess ? 0 : -1;
+}
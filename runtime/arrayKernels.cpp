@@ -0,0 +1,251 @@
+#include "arrayKernels.hpp"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define ARRAY_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+using ArrayKernel_t = void (*)(int64_t *dst, const int64_t *left, const int64_t *right, size_t size);
+
+// Arithmetic wraps around like in every backend.
+template<ArrayOperator_t Oper>
+static inline int64_t applyScalar(const int64_t left, const int64_t right)
+{
+    if constexpr (Oper == ArrayOperator_t::ADD)
+    {
+        return static_cast<int64_t>(static_cast<uint64_t>(left) + static_cast<uint64_t>(right));
+    }
+    else if constexpr (Oper == ArrayOperator_t::SUB)
+    {
+        return static_cast<int64_t>(static_cast<uint64_t>(left) - static_cast<uint64_t>(right));
+    }
+    else if constexpr (Oper == ArrayOperator_t::MUL)
+    {
+        return static_cast<int64_t>(static_cast<uint64_t>(left) * static_cast<uint64_t>(right));
+    }
+    else if constexpr (Oper == ArrayOperator_t::DIV)
+    {
+        return left / right;
+    }
+    else if constexpr (Oper == ArrayOperator_t::LESS)
+    {
+        return left < right;
+    }
+    else if constexpr (Oper == ArrayOperator_t::LESS_OR_EQ)
+    {
+        return left <= right;
+    }
+    else if constexpr (Oper == ArrayOperator_t::MORE)
+    {
+        return left > right;
+    }
+    else if constexpr (Oper == ArrayOperator_t::MORE_OR_EQ)
+    {
+        return left >= right;
+    }
+    else
+    {
+        static_assert(Oper == ArrayOperator_t::EQ, "Not an array operator");
+        return left == right;
+    }
+}
+
+template<ArrayOperator_t Oper>
+static void scalarKernel(int64_t *dst, const int64_t *left, const int64_t *right, const size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        dst[i] = applyScalar<Oper>(left[i], right[i]);
+    }
+}
+
+// Every kernel table has the same layout. There is no SIMD integer
+// division on x86, so DIV stays scalar everywhere.
+#define KERNEL_TABLE(KERNEL)                \
+    {                                       \
+        KERNEL<ArrayOperator_t::ADD>,       \
+        KERNEL<ArrayOperator_t::SUB>,       \
+        KERNEL<ArrayOperator_t::MUL>,       \
+        scalarKernel<ArrayOperator_t::DIV>, \
+        KERNEL<ArrayOperator_t::LESS>,      \
+        KERNEL<ArrayOperator_t::LESS_OR_EQ>,\
+        KERNEL<ArrayOperator_t::MORE>,      \
+        KERNEL<ArrayOperator_t::MORE_OR_EQ>,\
+        KERNEL<ArrayOperator_t::EQ>         \
+    }
+
+static const ArrayKernel_t scalar_kernels[] = KERNEL_TABLE(scalarKernel);
+
+#if defined(ARRAY_KERNELS_X86)
+
+// The file is built for the baseline target, wider kernels are compiled
+// for their own targets and only called when the CPU supports them.
+#define SSE_TARGET __attribute__((target("sse4.2")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+// There is no 64-bit multiply below AVX-512, the low half of the product is
+// put together from 32-bit ones: lo * lo + ((lo * hi + hi * lo) << 32).
+SSE_TARGET static inline __m128i mulSse(const __m128i left, const __m128i right)
+{
+    const __m128i cross = _mm_add_epi64(
+        _mm_mul_epu32(left, _mm_srli_epi64(right, 32)),
+        _mm_mul_epu32(_mm_srli_epi64(left, 32), right)
+    );
+    return _mm_add_epi64(_mm_mul_epu32(left, right), _mm_slli_epi64(cross, 32));
+}
+
+// Comparisons set lanes to all ones, they are masked down to 1.
+template<ArrayOperator_t Oper>
+SSE_TARGET static inline __m128i applySse(const __m128i left, const __m128i right)
+{
+    const __m128i one = _mm_set1_epi64x(1);
+
+    if constexpr (Oper == ArrayOperator_t::ADD)
+    {
+        return _mm_add_epi64(left, right);
+    }
+    else if constexpr (Oper == ArrayOperator_t::SUB)
+    {
+        return _mm_sub_epi64(left, right);
+    }
+    else if constexpr (Oper == ArrayOperator_t::MUL)
+    {
+        return mulSse(left, right);
+    }
+    else if constexpr (Oper == ArrayOperator_t::LESS)
+    {
+        return _mm_and_si128(_mm_cmpgt_epi64(right, left), one);
+    }
+    else if constexpr (Oper == ArrayOperator_t::LESS_OR_EQ)
+    {
+        return _mm_andnot_si128(_mm_cmpgt_epi64(left, right), one);
+    }
+    else if constexpr (Oper == ArrayOperator_t::MORE)
+    {
+        return _mm_and_si128(_mm_cmpgt_epi64(left, right), one);
+    }
+    else if constexpr (Oper == ArrayOperator_t::MORE_OR_EQ)
+    {
+        return _mm_andnot_si128(_mm_cmpgt_epi64(right, left), one);
+    }
+    else
+    {
+        static_assert(Oper == ArrayOperator_t::EQ, "No SSE kernel for the operator");
+        return _mm_and_si128(_mm_cmpeq_epi64(left, right), one);
+    }
+}
+
+template<ArrayOperator_t Oper>
+SSE_TARGET static void sseKernel(int64_t *dst, const int64_t *left, const int64_t *right, const size_t size)
+{
+    size_t i = 0;
+    for (; i + 2 <= size; i += 2)
+    {
+        const __m128i left_lanes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(left + i));
+        const __m128i right_lanes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(right + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), applySse<Oper>(left_lanes, right_lanes));
+    }
+    scalarKernel<Oper>(dst + i, left + i, right + i, size - i);
+}
+
+AVX2_TARGET static inline __m256i mulAvx2(const __m256i left, const __m256i right)
+{
+    const __m256i cross = _mm256_add_epi64(
+        _mm256_mul_epu32(left, _mm256_srli_epi64(right, 32)),
+        _mm256_mul_epu32(_mm256_srli_epi64(left, 32), right)
+    );
+    return _mm256_add_epi64(_mm256_mul_epu32(left, right), _mm256_slli_epi64(cross, 32));
+}
+
+template<ArrayOperator_t Oper>
+AVX2_TARGET static inline __m256i applyAvx2(const __m256i left, const __m256i right)
+{
+    const __m256i one = _mm256_set1_epi64x(1);
+
+    if constexpr (Oper == ArrayOperator_t::ADD)
+    {
+        return _mm256_add_epi64(left, right);
+    }
+    else if constexpr (Oper == ArrayOperator_t::SUB)
+    {
+        return _mm256_sub_epi64(left, right);
+    }
+    else if constexpr (Oper == ArrayOperator_t::MUL)
+    {
+        return mulAvx2(left, right);
+    }
+    else if constexpr (Oper == ArrayOperator_t::LESS)
+    {
+        return _mm256_and_si256(_mm256_cmpgt_epi64(right, left), one);
+    }
+    else if constexpr (Oper == ArrayOperator_t::LESS_OR_EQ)
+    {
+        return _mm256_andnot_si256(_mm256_cmpgt_epi64(left, right), one);
+    }
+    else if constexpr (Oper == ArrayOperator_t::MORE)
+    {
+        return _mm256_and_si256(_mm256_cmpgt_epi64(left, right), one);
+    }
+    else if constexpr (Oper == ArrayOperator_t::MORE_OR_EQ)
+    {
+        return _mm256_andnot_si256(_mm256_cmpgt_epi64(right, left), one);
+    }
+    else
+    {
+        static_assert(Oper == ArrayOperator_t::EQ, "No AVX2 kernel for the operator");
+        return _mm256_and_si256(_mm256_cmpeq_epi64(left, right), one);
+    }
+}
+
+template<ArrayOperator_t Oper>
+AVX2_TARGET static void avx2Kernel(int64_t *dst, const int64_t *left, const int64_t *right, const size_t size)
+{
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4)
+    {
+        const __m256i left_lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(left + i));
+        const __m256i right_lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(right + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), applyAvx2<Oper>(left_lanes, right_lanes));
+    }
+    scalarKernel<Oper>(dst + i, left + i, right + i, size - i);
+}
+
+static const ArrayKernel_t sse_kernels[] = KERNEL_TABLE(sseKernel);
+static const ArrayKernel_t avx2_kernels[] = KERNEL_TABLE(avx2Kernel);
+
+#endif
+
+static_assert(
+    sizeof(scalar_kernels) / sizeof(scalar_kernels[0]) == static_cast<size_t>(ArrayOperator_t::OPERATORS_COUNT),
+    "kernel tables are out of sync with ArrayOperator_t"
+);
+
+static const ArrayKernel_t *selectKernels()
+{
+#if defined(ARRAY_KERNELS_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return avx2_kernels;
+    }
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        return sse_kernels;
+    }
+#endif
+    return scalar_kernels;
+}
+
+void applyArrayOperator(
+    const ArrayOperator_t oper,
+    int64_t *dst,
+    const int64_t *left,
+    const int64_t *right,
+    const size_t size
+    )
+{
+    // The CPU is checked once, on the first call.
+    static const ArrayKernel_t *const kernels = selectKernels();
+
+    kernels[static_cast<size_t>(oper)](dst, left, right, size);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Element-wise operators on whole arrays, in the same order as the scalar
+// ADD..EQ of the interpreter and the VM.
+enum class ArrayOperator_t : uint8_t
+{
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    LESS,
+    LESS_OR_EQ,
+    MORE,
+    MORE_OR_EQ,
+    EQ,
+
+    OPERATORS_COUNT
+};
+
+// dst[i] = left[i] oper right[i] for i in [0, size), comparisons give 0 or 1.
+// dst may be the same array as left or right. Runs AVX2 or SSE4.2 kernels
+// when the CPU has them and plain loops otherwise, division is always scalar.
+void applyArrayOperator(ArrayOperator_t oper, int64_t *dst, const int64_t *left, const int64_t *right, size_t size);
@@ -0,0 +1,108 @@
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "output.hpp"
+
+OutputBuffer_t::OutputBuffer_t(const int fd_)
+    :
+        fd(fd_),
+        buffer(new char[BUFFER_SIZE]),
+        used(0)
+{}
+
+OutputBuffer_t::~OutputBuffer_t()
+{
+    flush();
+}
+
+bool OutputBuffer_t::flush()
+{
+    const char *data = buffer.get();
+    size_t left = used;
+    used = 0;
+
+    while (left > 0)
+    {
+        const ssize_t written = write(fd, data, left);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+
+        data += written;
+        left -= static_cast<size_t>(written);
+    }
+
+    return true;
+}
+
+size_t OutputBuffer_t::formatInt(char *dst, const int64_t value)
+{
+    static const char digit_pairs[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+    // Negate in unsigned arithmetic so that INT64_MIN does not overflow.
+    uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+
+    char digits[MAX_LINE_SIZE];
+    char *pos = digits + sizeof(digits);
+
+    *--pos = '\n';
+    while (magnitude >= 100)
+    {
+        const size_t pair = static_cast<size_t>(magnitude % 100) * 2;
+        magnitude /= 100;
+        *--pos = digit_pairs[pair + 1];
+        *--pos = digit_pairs[pair];
+    }
+    if (magnitude >= 10)
+    {
+        const size_t pair = static_cast<size_t>(magnitude) * 2;
+        *--pos = digit_pairs[pair + 1];
+        *--pos = digit_pairs[pair];
+    }
+    else
+    {
+        *--pos = static_cast<char>('0' + magnitude);
+    }
+    if (value < 0)
+    {
+        *--pos = '-';
+    }
+
+    const size_t length = static_cast<size_t>(digits + sizeof(digits) - pos);
+    memcpy(dst, pos, length);
+    return length;
+}
+
+static thread_local OutputBuffer_t runtime_output;
+
+OutputBuffer_t &runtimeOutput()
+{
+    return runtime_output;
+}
+
+extern "C" void mipt_print_i64(const int64_t value)
+{
+    runtime_output.printInt(value);
+}
+
+extern "C" void mipt_flush_output()
+{
+    runtime_output.flush();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Buffered integer output shared by the interpreter, the VM and generated code.
+// Values are formatted by hand into a large buffer which is written out with a
+// single write() when it fills up, on flush() and on destruction.
+class OutputBuffer_t
+{
+private:
+    static constexpr size_t BUFFER_SIZE = 64 * 1024;
+    // Longest line printInt() can produce: "-9223372036854775808\n".
+    static constexpr size_t MAX_LINE_SIZE = 21;
+
+    int fd;
+    std::unique_ptr<char[]> buffer;
+    size_t used;
+
+public:
+    explicit OutputBuffer_t(const int fd_ = 1);
+
+    OutputBuffer_t(const OutputBuffer_t&) = delete;
+    OutputBuffer_t &operator=(const OutputBuffer_t&) = delete;
+    OutputBuffer_t(OutputBuffer_t&&) = delete;
+    OutputBuffer_t &operator=(OutputBuffer_t&&) = delete;
+
+    ~OutputBuffer_t();
+
+    // Appends value in decimal followed by a newline.
+    void printInt(const int64_t value)
+    {
+        if (used + MAX_LINE_SIZE > BUFFER_SIZE)
+        {
+            flush();
+        }
+        used += formatInt(buffer.get() + used, value);
+    }
+
+    bool flush();
+
+    // Flushes what was printed so far and sends everything after it to fd_.
+    void setFd(const int fd_)
+    {
+        flush();
+        fd = fd_;
+    }
+
+    int getFd() const
+    {
+        return fd;
+    }
+
+    // Writes value and '\n' to dst, returns the number of characters written.
+    static size_t formatInt(char *dst, int64_t value);
+};
+
+// Buffer behind the entry points below. It is per thread, so programs JIT
+// compiled by different threads never share it. Writes to stdout by default.
+OutputBuffer_t &runtimeOutput();
+
+// Entry points called from the LLVM generated code, they operate on
+// runtimeOutput(). Generated main calls mipt_flush_output() on exit.
+extern "C" void mipt_print_i64(int64_t value);
+extern "C" void mipt_flush_output();
@@ -0,0 +1,153 @@
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "protocol.hpp"
+
+// Payloads are command lines, anything larger is not a request.
+static constexpr uint32_t MAX_PAYLOAD_SIZE = 1 << 20;
+
+static bool writeAll(const int fd, const void *data, size_t size)
+{
+    const char *pos = static_cast<const char*>(data);
+    while (size > 0)
+    {
+        const ssize_t written = write(fd, pos, size);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            return false;
+        }
+        pos += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+static bool readAll(const int fd, void *data, size_t size)
+{
+    char *pos = static_cast<char*>(data);
+    while (size > 0)
+    {
+        const ssize_t received = read(fd, pos, size);
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (received <= 0)
+        {
+            return false;
+        }
+        pos += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+bool sendRequest(const int socket_fd, const ServerRequest_t &request)
+{
+    std::string payload = request.working_dir;
+    payload.push_back('\0');
+    for (const auto &arg : request.args)
+    {
+        payload += arg;
+        payload.push_back('\0');
+    }
+    if (payload.size() > MAX_PAYLOAD_SIZE)
+    {
+        return false;
+    }
+
+    uint32_t payload_size = static_cast<uint32_t>(payload.size());
+    iovec size_vec = {&payload_size, sizeof(payload_size)};
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(request.fds))] = {};
+    msghdr message = {};
+    message.msg_iov = &size_vec;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    cmsghdr *fds_header = CMSG_FIRSTHDR(&message);
+    fds_header->cmsg_level = SOL_SOCKET;
+    fds_header->cmsg_type = SCM_RIGHTS;
+    fds_header->cmsg_len = CMSG_LEN(sizeof(request.fds));
+    memcpy(CMSG_DATA(fds_header), request.fds, sizeof(request.fds));
+
+    ssize_t sent = 0;
+    do
+    {
+        sent = sendmsg(socket_fd, &message, 0);
+    } while (sent < 0 && errno == EINTR);
+
+    if (sent != static_cast<ssize_t>(sizeof(payload_size)))
+    {
+        return false;
+    }
+    return writeAll(socket_fd, payload.data(), payload.size());
+}
+
+bool receiveRequest(const int socket_fd, ServerRequest_t &request)
+{
+    uint32_t payload_size = 0;
+    iovec size_vec = {&payload_size, sizeof(payload_size)};
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(request.fds))] = {};
+    msghdr message = {};
+    message.msg_iov = &size_vec;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    ssize_t received = 0;
+    do
+    {
+        received = recvmsg(socket_fd, &message, MSG_CMSG_CLOEXEC);
+    } while (received < 0 && errno == EINTR);
+
+    const cmsghdr *fds_header = CMSG_FIRSTHDR(&message);
+    if (fds_header == nullptr || fds_header->cmsg_level != SOL_SOCKET || fds_header->cmsg_type != SCM_RIGHTS ||
+        fds_header->cmsg_len != CMSG_LEN(sizeof(request.fds)))
+    {
+        return false;
+    }
+    // From here on the descriptors belong to the request, even if it turns out broken.
+    memcpy(request.fds, CMSG_DATA(fds_header), sizeof(request.fds));
+
+    if (received != static_cast<ssize_t>(sizeof(payload_size)) || payload_size == 0 || payload_size > MAX_PAYLOAD_SIZE)
+    {
+        return false;
+    }
+
+    std::string payload(payload_size, '\0');
+    if (!readAll(socket_fd, payload.data(), payload.size()) || payload.back() != '\0')
+    {
+        return false;
+    }
+
+    request.args.clear();
+    size_t begin = payload.find('\0') + 1;
+    request.working_dir = payload.substr(0, begin - 1);
+    while (begin < payload.size())
+    {
+        const size_t end = payload.find('\0', begin);
+        request.args.push_back(payload.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    return true;
+}
+
+bool sendResponse(const int socket_fd, const ServerResponse_t &response)
+{
+    return writeAll(socket_fd, &response, sizeof(response));
+}
+
+bool receiveResponse(const int socket_fd, ServerResponse_t &response)
+{
+    return readAll(socket_fd, &response, sizeof(response));
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Wire format between compiler_client and a compiler running with --serve.
+//
+// Request: one sendmsg() carrying the client's stdin, stdout and stderr as
+// SCM_RIGHTS together with the payload length, then the payload itself:
+// working directory followed by the command line arguments (without argv[0]),
+// every string terminated by '\0'.
+// Response: exit code and time the server spent on the request.
+
+constexpr size_t REQUEST_FDS_COUNT = 3;
+
+// Exit code of a request the server does not run: the user program would
+// run inside the server, so the client has to run the command itself.
+constexpr int32_t RUN_LOCALLY_EXIT_CODE = -2;
+
+struct ServerRequest_t
+{
+    std::string working_dir;
+    std::vector<std::string> args;
+    // Client's stdin, stdout and stderr, owned by whoever received them.
+    int fds[REQUEST_FDS_COUNT];
+};
+
+struct ServerResponse_t
+{
+    int32_t exit_code;
+    double elapsed_ms;
+};
+
+bool sendRequest(int socket_fd, const ServerRequest_t &request);
+bool receiveRequest(int socket_fd, ServerRequest_t &request);
+bool sendResponse(int socket_fd, const ServerResponse_t &response);
+bool receiveResponse(int socket_fd, ServerResponse_t &response);
@@ -0,0 +1,139 @@
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+
+#include "log.hpp"
+#include "server.hpp"
+#include "threadPool.hpp"
+
+static std::atomic<bool> is_stop_requested = false;
+
+static void requestStop(int)
+{
+    is_stop_requested = true;
+}
+
+static bool fillAddress(const char *socket_path, sockaddr_un &address)
+{
+    if (strlen(socket_path) >= sizeof(address.sun_path))
+    {
+        USER_ERR("Socket path is too long: %s\n", socket_path);
+        return false;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+    return true;
+}
+
+// A socket file nobody listens on is left over from a server that died,
+// it is safe to replace. A live one means another server owns the path.
+static bool isServerRunning(const sockaddr_un &address)
+{
+    const int probe_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe_fd < 0)
+    {
+        return false;
+    }
+
+    const bool is_running = connect(probe_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+    close(probe_fd);
+    return is_running;
+}
+
+bool CompileServer_t::serve(const char *socket_path)
+{
+    sockaddr_un address;
+    if (!fillAddress(socket_path, address))
+    {
+        return false;
+    }
+    if (isServerRunning(address))
+    {
+        USER_ERR("Another server is already listening on %s\n", socket_path);
+        return false;
+    }
+    unlink(socket_path);
+
+    const int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0 ||
+        bind(listen_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listen_fd, SOMAXCONN) != 0)
+    {
+        USER_ERR("Cannot listen on %s: %s\n", socket_path, strerror(errno));
+        if (listen_fd >= 0)
+        {
+            close(listen_fd);
+        }
+        return false;
+    }
+
+    // Clients that go away early must not kill the server with SIGPIPE.
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, requestStop);
+    signal(SIGTERM, requestStop);
+
+    {
+        ThreadPool_t pool(threads_count);
+        while (!is_stop_requested)
+        {
+            // Wake up regularly to notice a stop request.
+            pollfd listen_poll = {listen_fd, POLLIN, 0};
+            if (poll(&listen_poll, 1, 200) <= 0)
+            {
+                continue;
+            }
+
+            const int connection_fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (connection_fd < 0)
+            {
+                continue;
+            }
+            pool.submit([this, connection_fd]() { handleConnection(connection_fd); });
+        }
+    }
+
+    close(listen_fd);
+    unlink(socket_path);
+    return true;
+}
+
+void CompileServer_t::handleConnection(const int connection_fd)
+{
+    using Clock_t = std::chrono::steady_clock;
+
+    ServerRequest_t request;
+    for (int &fd : request.fds)
+    {
+        fd = -1;
+    }
+
+    const auto start = Clock_t::now();
+    // A connection without a request is most likely another server probing
+    // the socket, it only gets the failure response.
+    ServerResponse_t response = {-1, 0.0};
+    if (receiveRequest(connection_fd, request))
+    {
+        response.exit_code = handler(request);
+    }
+    response.elapsed_ms = std::chrono::duration<double, std::milli>(Clock_t::now() - start).count();
+
+    for (const int fd : request.fds)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+    sendResponse(connection_fd, response);
+    close(connection_fd);
+}
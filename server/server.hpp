@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+#include "protocol.hpp"
+
+// Accepts requests on a Unix domain socket and runs them on a thread pool
+// until SIGINT or SIGTERM. The handler returns the exit code for the client,
+// the request descriptors are closed after it returns.
+class CompileServer_t
+{
+public:
+    using Handler_t = std::function<int(const ServerRequest_t &request)>;
+
+private:
+    Handler_t handler;
+    size_t threads_count;
+
+public:
+    explicit CompileServer_t(Handler_t handler_, const size_t threads_count_)
+        :
+            handler(std::move(handler_)),
+            threads_count(threads_count_)
+    {}
+
+    bool serve(const char *socket_path);
+
+private:
+    void handleConnection(int connection_fd);
+};
@@ -0,0 +1,291 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/SHA256.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#include "compileCache.hpp"
+#include "log.hpp"
+
+namespace fs = std::filesystem;
+
+static constexpr const char *TEMP_PREFIX = "tmp.";
+// Temporary files this old belong to a process that died while writing.
+static constexpr auto STALE_TEMP_AGE = std::chrono::hours(1);
+
+// Any rebuild of the compiler changes its size or modification time, so
+// outputs of an older build are never served. Empty when it can not be told.
+static const std::string &compilerIdentity()
+{
+    static const std::string identity = []()
+    {
+        struct stat exe_stat;
+        if (stat("/proc/self/exe", &exe_stat) != 0)
+        {
+            return std::string();
+        }
+        return std::to_string(exe_stat.st_size) + ":" +
+               std::to_string(exe_stat.st_mtim.tv_sec) + "." + std::to_string(exe_stat.st_mtim.tv_nsec);
+    }();
+    return identity;
+}
+
+bool CompileCache_t::open()
+{
+    std::error_code error;
+    fs::create_directories(directory, error);
+    if (error)
+    {
+        USER_ERR("Cannot create cache directory %s: %s\n", directory.c_str(), error.message().c_str());
+        return false;
+    }
+    return true;
+}
+
+std::string CompileCache_t::makeKey(const std::string_view source, const std::string_view options) const
+{
+    const std::string &identity = compilerIdentity();
+    if (identity.empty())
+    {
+        return std::string();
+    }
+
+    // Parts are separated by a byte that can not occur in the first two.
+    llvm::SHA256 hasher;
+    hasher.update(identity);
+    hasher.update(llvm::StringRef("\0", 1));
+    hasher.update(llvm::StringRef(options.data(), options.size()));
+    hasher.update(llvm::StringRef("\0", 1));
+    hasher.update(llvm::StringRef(source.data(), source.size()));
+    return llvm::toHex(hasher.final(), true);
+}
+
+std::string CompileCache_t::entryPath(const std::string &key) const
+{
+    // Two-character fan-out keeps directories small for large caches.
+    return directory + "/" + key.substr(0, 2) + "/" + key;
+}
+
+bool CompileCache_t::fetch(const std::string &key, const char *output_file)
+{
+    const std::string path = entryPath(key);
+    if (key.empty() || !copyFile(path.c_str(), output_file))
+    {
+        ++stats.misses;
+        return false;
+    }
+
+    // Eviction goes by modification time, reading an entry makes it recent.
+    utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+    ++stats.hits;
+    return true;
+}
+
+bool CompileCache_t::createEntry(std::string &temp_name)
+{
+    temp_name = directory + "/" + TEMP_PREFIX + "XXXXXX";
+    const int temp_fd = mkstemp(temp_name.data());
+    if (temp_fd < 0)
+    {
+        return false;
+    }
+    // Other users of a shared cache have to be able to read the entry.
+    fchmod(temp_fd, 0644);
+    close(temp_fd);
+    return true;
+}
+
+void CompileCache_t::discardEntry(const std::string &temp_name)
+{
+    unlink(temp_name.c_str());
+}
+
+bool CompileCache_t::store(const std::string &temp_name, const std::string &key)
+{
+    const std::string path = entryPath(key);
+    mkdir(path.substr(0, path.rfind('/')).c_str(), 0755);
+
+    struct stat entry_stat;
+    if (key.empty() || stat(temp_name.c_str(), &entry_stat) != 0 || rename(temp_name.c_str(), path.c_str()) != 0)
+    {
+        discardEntry(temp_name);
+        return false;
+    }
+
+    ++stats.stores;
+    addStoredBytes(static_cast<uint64_t>(entry_stat.st_size));
+    return true;
+}
+
+void CompileCache_t::addStoredBytes(const uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(size_mutex);
+    if (!is_size_known)
+    {
+        evict();
+    }
+
+    known_bytes += bytes;
+    if (known_bytes > max_bytes)
+    {
+        evict();
+    }
+}
+
+// Rescans the whole directory and removes the least recently used entries
+// until a quarter of the limit is free, so the next few stores do not have
+// to scan again. Files removed by another process at the same time are fine.
+void CompileCache_t::evict()
+{
+    struct Entry_t
+    {
+        fs::path path;
+        uint64_t size;
+        fs::file_time_type used_time;
+    };
+
+    std::vector<Entry_t> entries;
+    uint64_t total_bytes = 0;
+    const auto now = fs::file_time_type::clock::now();
+
+    std::error_code error;
+    for (auto it = fs::recursive_directory_iterator(directory, error); !error && it != fs::recursive_directory_iterator(); it.increment(error))
+    {
+        std::error_code entry_error;
+        if (!it->is_regular_file(entry_error))
+        {
+            continue;
+        }
+
+        const uint64_t size = it->file_size(entry_error);
+        const fs::file_time_type used_time = it->last_write_time(entry_error);
+        if (entry_error)
+        {
+            continue;
+        }
+
+        if (it->path().filename().string().rfind(TEMP_PREFIX, 0) == 0)
+        {
+            if (now - used_time > STALE_TEMP_AGE)
+            {
+                fs::remove(it->path(), entry_error);
+            }
+            continue;
+        }
+
+        entries.push_back({it->path(), size, used_time});
+        total_bytes += size;
+    }
+
+    if (total_bytes > max_bytes)
+    {
+        std::sort(entries.begin(), entries.end(), [](const Entry_t &lhs, const Entry_t &rhs)
+        {
+            return lhs.used_time < rhs.used_time;
+        });
+
+        const uint64_t target_bytes = max_bytes - max_bytes / 4;
+        for (const Entry_t &entry : entries)
+        {
+            if (total_bytes <= target_bytes)
+            {
+                break;
+            }
+
+            // A file that can not be removed still takes its space, a file
+            // another process has already removed does not.
+            std::error_code remove_error;
+            if (fs::remove(entry.path, remove_error))
+            {
+                ++stats.evictions;
+            }
+            if (!remove_error)
+            {
+                total_bytes -= entry.size;
+            }
+        }
+    }
+
+    known_bytes = total_bytes;
+    is_size_known = true;
+}
+
+void CompileCache_t::printStats() const
+{
+    logPrint("Cache: %zu hits, %zu misses, %zu stored, %zu evicted\n",
+             stats.hits.load(), stats.misses.load(), stats.stores.load(), stats.evictions.load());
+}
+
+bool CompileCache_t::copyFile(const char *from_file, const char *to_file)
+{
+    const int from_fd = ::open(from_file, O_RDONLY | O_CLOEXEC);
+    if (from_fd < 0)
+    {
+        return false;
+    }
+
+    const bool is_stdout = strcmp(to_file, "-") == 0;
+    const int to_fd = is_stdout ? STDOUT_FILENO : ::open(to_file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (to_fd < 0)
+    {
+        close(from_fd);
+        return false;
+    }
+
+    // Plain read/write, sendfile() refuses outputs opened for appending.
+    constexpr size_t BUFFER_SIZE = 1 << 16;
+    const std::unique_ptr<char[]> buffer(new char[BUFFER_SIZE]);
+
+    bool is_success = true;
+    for (;;)
+    {
+        const ssize_t received = read(from_fd, buffer.get(), BUFFER_SIZE);
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (received <= 0)
+        {
+            is_success = received == 0;
+            break;
+        }
+
+        const char *pos = buffer.get();
+        size_t left = static_cast<size_t>(received);
+        while (left > 0)
+        {
+            const ssize_t written = write(to_fd, pos, left);
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (written <= 0)
+            {
+                is_success = false;
+                break;
+            }
+            pos += written;
+            left -= static_cast<size_t>(written);
+        }
+        if (!is_success)
+        {
+            break;
+        }
+    }
+
+    close(from_fd);
+    if (!is_stdout)
+    {
+        close(to_fd);
+    }
+    return is_success;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+// On-disk cache of compiler outputs, shared by every compiler process that
+// points at the same directory. Entries are named by a hash of the source,
+// the compiler binary and the options, so an entry never has to be
+// invalidated, only evicted: least recently used first once the directory
+// grows past its size limit. Entries appear with rename(), readers never see
+// a partially written file.
+class CompileCache_t
+{
+public:
+    struct Stats_t
+    {
+        std::atomic<size_t> hits;
+        std::atomic<size_t> misses;
+        std::atomic<size_t> stores;
+        std::atomic<size_t> evictions;
+    };
+
+private:
+    std::string directory;
+    uint64_t max_bytes;
+    Stats_t stats;
+
+    std::mutex size_mutex;
+    // Bytes this process believes the cache holds, only rescanned when it
+    // passes max_bytes, other processes may have evicted in the meantime.
+    uint64_t known_bytes;
+    bool is_size_known;
+
+public:
+    explicit CompileCache_t(std::string directory_, const uint64_t max_bytes_)
+        :
+            directory(std::move(directory_)),
+            max_bytes(max_bytes_),
+            stats{},
+            known_bytes(0),
+            is_size_known(false)
+    {}
+
+    CompileCache_t(const CompileCache_t&) = delete;
+    CompileCache_t &operator=(const CompileCache_t&) = delete;
+
+    // Creates the cache directory if needed.
+    bool open();
+    std::string makeKey(std::string_view source, std::string_view options) const;
+
+    // Copies the entry for key to output_file ("-" is stdout), false on a miss.
+    bool fetch(const std::string &key, const char *output_file);
+    // Reserves a file to build a new entry in, it becomes visible with store().
+    bool createEntry(std::string &temp_name);
+    void discardEntry(const std::string &temp_name);
+    bool store(const std::string &temp_name, const std::string &key);
+
+    const Stats_t &getStats() const
+    {
+        return stats;
+    }
+    void printStats() const;
+
+    // Copies a whole file, used for entries and for files about to become one.
+    static bool copyFile(const char *from_file, const char *to_file);
+
+private:
+    std::string entryPath(const std::string &key) const;
+    void addStoredBytes(uint64_t bytes);
+    void evict();
+};
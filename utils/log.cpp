@@ -4,6 +4,14 @@
 #include "log.hpp"
 
 static FILE *logfile_ptr = nullptr;
+static thread_local FILE *thread_sink_ptr = nullptr;
+
+FILE *setThreadLogSink(FILE *file)
+{
+    FILE *previous = thread_sink_ptr;
+    thread_sink_ptr = file;
+    return previous;
+}
 
 bool initLogging(const char *const logfile_name)
 {
@@ -31,6 +39,12 @@ void logPrint(const char *const fmt, ...)
     }
 
     va_start(args, fmt);
+    if (thread_sink_ptr != nullptr)
+    {
+        vfprintf(thread_sink_ptr, fmt, args);
+        va_end(args);
+        return;
+    }
 #if defined (DEBUG)
     vfprintf(logfile_ptr, fmt, args);
 #else
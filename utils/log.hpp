@@ -1,8 +1,13 @@
 #pragma once
 
+#include <cstdio>
+
 extern bool initLogging(const char *const logfile_name);
 extern void logPrint(const char *const fmt, ...);
 extern bool deinitLogging();
+// Sends messages logged by the calling thread to file instead of the
+// default destination, nullptr restores it. Returns the previous sink.
+extern FILE *setThreadLogSink(FILE *file);
 
 #define USER_ERR(fmt, ...) \
     logPrint("Error: " fmt, ##__VA_ARGS__);
@@ -0,0 +1,74 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mappedFile.hpp"
+
+bool MappedFile_t::open(const char *file_name)
+{
+    close();
+
+    const int fd = ::open(file_name, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // mmap refuses empty mappings, an empty file is just an empty view.
+    if (file_stat.st_size == 0)
+    {
+        ::close(fd);
+        return true;
+    }
+
+    void *mapping = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // The lexer reads the file once from start to end.
+    madvise(mapping, static_cast<size_t>(file_stat.st_size), MADV_SEQUENTIAL);
+
+    data = static_cast<const char*>(mapping);
+    size = static_cast<size_t>(file_stat.st_size);
+    released = 0;
+    return true;
+}
+
+void MappedFile_t::releaseBefore(const char *position)
+{
+    // Releasing in large steps keeps the number of madvise calls low.
+    static constexpr size_t RELEASE_STEP = 1 << 20;
+
+    if (data == nullptr || position < data + released + RELEASE_STEP)
+    {
+        return;
+    }
+
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t offset = static_cast<size_t>(position - data) / page_size * page_size;
+    madvise(const_cast<char*>(data) + released, offset - released, MADV_DONTNEED);
+    released = offset;
+}
+
+void MappedFile_t::close()
+{
+    if (data != nullptr)
+    {
+        munmap(const_cast<char*>(data), size);
+    }
+
+    data = nullptr;
+    size = 0;
+    released = 0;
+}
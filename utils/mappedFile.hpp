@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// Read-only memory mapping of a whole file, unmapped on destruction.
+class MappedFile_t
+{
+private:
+    const char *data;
+    size_t size;
+    size_t released;
+
+public:
+    explicit MappedFile_t()
+        :
+            data(nullptr),
+            size(0),
+            released(0)
+    {}
+
+    MappedFile_t(const MappedFile_t&) = delete;
+    MappedFile_t &operator=(const MappedFile_t&) = delete;
+    MappedFile_t(MappedFile_t&&) = delete;
+    MappedFile_t &operator=(MappedFile_t&&) = delete;
+
+    ~MappedFile_t()
+    {
+        close();
+    }
+
+    // Fails for anything mmap can not handle (pipes, terminals), callers
+    // are expected to fall back to reading the file as a stream.
+    bool open(const char *file_name);
+    void close();
+    // Hints that everything before position is not going to be read again,
+    // so its pages do not have to stay resident.
+    void releaseBefore(const char *position);
+
+    std::string_view contents() const
+    {
+        return std::string_view(data, size);
+    }
+};
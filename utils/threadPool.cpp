@@ -0,0 +1,129 @@
+#include <algorithm>
+
+#include "threadPool.hpp"
+
+ThreadPool_t::ThreadPool_t(size_t threads_count)
+    :
+        pending_tasks(0),
+        next_queue(0),
+        is_stopping(false)
+{
+    if (threads_count == 0)
+    {
+        threads_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < threads_count; ++i)
+    {
+        queues.push_back(std::make_unique<WorkQueue_t>());
+    }
+    for (size_t i = 0; i < threads_count; ++i)
+    {
+        workers.emplace_back(&ThreadPool_t::workerLoop, this, i);
+    }
+}
+
+ThreadPool_t::~ThreadPool_t()
+{
+    wait();
+
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        is_stopping = true;
+    }
+    has_work.notify_all();
+
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool_t::submit(Task_t task)
+{
+    {
+        // Pushing under state_mutex keeps a worker from missing the task
+        // between looking at the queues and going to sleep.
+        std::lock_guard<std::mutex> lock(state_mutex);
+        ++pending_tasks;
+
+        WorkQueue_t &queue = *queues[next_queue];
+        next_queue = (next_queue + 1) % queues.size();
+
+        std::lock_guard<std::mutex> queue_lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    has_work.notify_one();
+}
+
+void ThreadPool_t::wait()
+{
+    std::unique_lock<std::mutex> lock(state_mutex);
+    is_idle.wait(lock, [this]() { return pending_tasks == 0; });
+}
+
+bool ThreadPool_t::popTask(const size_t worker_id, Task_t &task)
+{
+    {
+        WorkQueue_t &own = *queues[worker_id];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < queues.size(); ++i)
+    {
+        WorkQueue_t &victim = *queues[(worker_id + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool_t::workerLoop(const size_t worker_id)
+{
+    Task_t task;
+    for (;;)
+    {
+        if (popTask(worker_id, task))
+        {
+            task();
+            task = nullptr;
+
+            std::lock_guard<std::mutex> lock(state_mutex);
+            if (--pending_tasks == 0)
+            {
+                is_idle.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(state_mutex);
+        if (is_stopping)
+        {
+            return;
+        }
+        // Tasks may have been pushed since popTask() looked, only sleep
+        // if every queue is still empty.
+        size_t queued_tasks = 0;
+        for (const auto &queue : queues)
+        {
+            std::lock_guard<std::mutex> queue_lock(queue->mutex);
+            queued_tasks += queue->tasks.size();
+        }
+        if (queued_tasks == 0)
+        {
+            has_work.wait(lock);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers, each with its own task deque. A worker takes tasks
+// from the back of its own deque and, once it runs dry, steals from the front
+// of the others, so long and short tasks even out without a shared queue.
+class ThreadPool_t
+{
+public:
+    using Task_t = std::function<void()>;
+
+private:
+    struct WorkQueue_t
+    {
+        std::mutex mutex;
+        std::deque<Task_t> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue_t>> queues;
+    std::vector<std::thread> workers;
+
+    // Guards sleeping and waking up, tasks themselves are guarded per queue.
+    std::mutex state_mutex;
+    std::condition_variable has_work;
+    std::condition_variable is_idle;
+    size_t pending_tasks;
+    size_t next_queue;
+    bool is_stopping;
+
+public:
+    // threads_count == 0 means one worker per hardware thread.
+    explicit ThreadPool_t(size_t threads_count = 0);
+
+    ThreadPool_t(const ThreadPool_t&) = delete;
+    ThreadPool_t &operator=(const ThreadPool_t&) = delete;
+    ThreadPool_t(ThreadPool_t&&) = delete;
+    ThreadPool_t &operator=(ThreadPool_t&&) = delete;
+
+    // Waits for every submitted task before joining the workers.
+    ~ThreadPool_t();
+
+    void submit(Task_t task);
+    // Blocks until every task submitted so far has finished.
+    void wait();
+
+    size_t threadsCount() const
+    {
+        return workers.size();
+    }
+
+private:
+    void workerLoop(size_t worker_id);
+    bool popTask(size_t worker_id, Task_t &task);
+};
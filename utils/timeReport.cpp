@@ -0,0 +1,99 @@
+#include <sys/resource.h>
+
+#include <cstdio>
+
+#include "log.hpp"
+#include "timeReport.hpp"
+
+static long peakRssKb()
+{
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+    // Linux reports kilobytes.
+    return usage.ru_maxrss;
+}
+
+void TimeReport_t::addPhase(const char *name, const double elapsed_ms, const bool is_in_total)
+{
+    phases.push_back({name, elapsed_ms, peakRssKb(), is_in_total});
+}
+
+void TimeReport_t::setNodeCount(const char *node_type, const size_t count)
+{
+    for (auto &[type, type_count] : node_counts)
+    {
+        if (type == node_type)
+        {
+            type_count = count;
+            return;
+        }
+    }
+    node_counts.emplace_back(node_type, count);
+}
+
+void TimeReport_t::print() const
+{
+    double total_ms = 0.0;
+    logPrint("Time report:\n");
+    logPrint("  %-16s %12s %14s\n", "phase", "time, ms", "peak RSS, KiB");
+    for (const Phase_t &phase : phases)
+    {
+        logPrint("  %-16s %12.3f %14ld%s\n", phase.name.c_str(), phase.elapsed_ms, phase.peak_rss_kb,
+                 phase.is_in_total ? "" : "  (not in total)");
+        if (phase.is_in_total)
+        {
+            total_ms += phase.elapsed_ms;
+        }
+    }
+    logPrint("  %-16s %12.3f %14ld\n", "total", total_ms, peakRssKb());
+
+    if (node_counts.empty())
+    {
+        return;
+    }
+
+    size_t total_nodes = 0;
+    logPrint("AST nodes:\n");
+    for (const auto &[type, count] : node_counts)
+    {
+        logPrint("  %-16s %12zu\n", type.c_str(), count);
+        total_nodes += count;
+    }
+    logPrint("  %-16s %12zu\n", "total", total_nodes);
+}
+
+bool TimeReport_t::writeJson(const char *file_name) const
+{
+    FILE *json = fopen(file_name, "w");
+    if (json == nullptr)
+    {
+        USER_ERR("Cannot open file: %s\n", file_name);
+        return false;
+    }
+
+    // Phase and node type names are identifiers, nothing needs escaping.
+    fprintf(json, "{\n  \"phases\": [\n");
+    for (size_t i = 0; i < phases.size(); ++i)
+    {
+        fprintf(json, "    {\"name\": \"%s\", \"elapsed_ms\": %.3f, \"peak_rss_kb\": %ld, \"in_total\": %s}%s\n",
+                phases[i].name.c_str(), phases[i].elapsed_ms, phases[i].peak_rss_kb,
+                phases[i].is_in_total ? "true" : "false", i + 1 < phases.size() ? "," : "");
+    }
+    fprintf(json, "  ],\n  \"ast_nodes\": {");
+    for (size_t i = 0; i < node_counts.size(); ++i)
+    {
+        fprintf(json, "%s\n    \"%s\": %zu", i > 0 ? "," : "", node_counts[i].first.c_str(), node_counts[i].second);
+    }
+    fprintf(json, "%s},\n  \"peak_rss_kb\": %ld\n}\n", node_counts.empty() ? "" : "\n  ", peakRssKb());
+
+    const bool is_written = !ferror(json);
+    if (fclose(json) != 0 || !is_written)
+    {
+        USER_ERR("Failed to write %s\n", file_name);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Wall time and peak RSS of every compiler phase plus AST statistics,
+// collected with --time-report. Peak RSS is process wide, it is the
+// high-water mark when the phase ended.
+class TimeReport_t
+{
+public:
+    struct Phase_t
+    {
+        std::string name;
+        double elapsed_ms;
+        long peak_rss_kb;
+        // Extra measurements of work another phase already covers are
+        // shown but left out of the total.
+        bool is_in_total;
+    };
+
+    // Adds the time from its construction to its destruction as a phase,
+    // does nothing without a report, so callers do not have to check.
+    class Scope_t
+    {
+    private:
+        TimeReport_t *report;
+        const char *name;
+        bool is_in_total;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        explicit Scope_t(TimeReport_t *report_, const char *name_, const bool is_in_total_ = true)
+            :
+                report(report_),
+                name(name_),
+                is_in_total(is_in_total_),
+                start(std::chrono::steady_clock::now())
+        {}
+
+        Scope_t(const Scope_t&) = delete;
+        Scope_t &operator=(const Scope_t&) = delete;
+
+        ~Scope_t()
+        {
+            if (report != nullptr)
+            {
+                const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+                report->addPhase(name, elapsed.count(), is_in_total);
+            }
+        }
+    };
+
+private:
+    std::vector<Phase_t> phases;
+    std::vector<std::pair<std::string, size_t>> node_counts;
+
+public:
+    explicit TimeReport_t() = default;
+
+    void addPhase(const char *name, double elapsed_ms, bool is_in_total = true);
+    void setNodeCount(const char *node_type, size_t count);
+
+    // Human readable report through logPrint().
+    void print() const;
+    bool writeJson(const char *file_name) const;
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+
+#include "ast.hpp"
+#include "log.hpp"
+#include "visitor.hpp"
+
+// Depth-first traversal with an explicit stack on the heap. The parser
+// builds arbitrarily deep trees (a chain of && is left-deep), walking them
+// by recursion would overflow the call stack.
+class AstWalker_t
+{
+private:
+    struct Frame_t
+    {
+        const AstNode_t *node;
+        size_t step;
+    };
+
+    std::vector<Frame_t> frames;
+    // Children scheduled by the step being run, moved to frames after it.
+    std::vector<const AstNode_t*> scheduled;
+
+public:
+    explicit AstWalker_t() = default;
+
+    // Called from visit(): the node is visited after the current step of its
+    // parent. Nodes scheduled in one step are visited in the same order.
+    void schedule(const AstNode_t *node)
+    {
+        DEV_ASSERT(node == nullptr);
+
+        scheduled.push_back(node);
+    }
+
+    // A visitor may start a nested walk from inside visit(), it ends before
+    // anything scheduled by the outer one is visited.
+    template<typename Visitor_t>
+    void walk(Visitor_t &visitor, const AstNode_t &root)
+    {
+        const size_t base = frames.size();
+        frames.push_back({&root, 0});
+
+        while (frames.size() > base)
+        {
+            const size_t frame_index = frames.size() - 1;
+            const Frame_t frame = frames[frame_index];
+            frames[frame_index].step = frame.step + 1;
+
+            const size_t first_scheduled = scheduled.size();
+            const bool is_pending = visitNode(visitor, *frame.node, frame.step);
+            if (!is_pending)
+            {
+                frames.pop_back();
+            }
+
+            // Pushed in reverse, so the first scheduled child is on top.
+            for (size_t i = scheduled.size(); i > first_scheduled; --i)
+            {
+                frames.push_back({scheduled[i - 1], 0});
+            }
+            scheduled.resize(first_scheduled);
+        }
+    }
+
+    // The same traversal by recursion, for comparing the two in compiler_bench.
+    // Deep trees overflow the call stack here, nothing else may use it.
+    template<typename Visitor_t>
+    void walkRecursive(Visitor_t &visitor, const AstNode_t &node)
+    {
+        for (size_t step = 0; ; ++step)
+        {
+            const size_t first_scheduled = scheduled.size();
+            const bool is_pending = visitNode(visitor, node, step);
+
+            const size_t scheduled_end = scheduled.size();
+            for (size_t i = first_scheduled; i < scheduled_end; ++i)
+            {
+                walkRecursive(visitor, *scheduled[i]);
+            }
+            scheduled.resize(first_scheduled);
+
+            if (!is_pending)
+            {
+                return;
+            }
+        }
+    }
+};
@@ -0,0 +1,553 @@
+#include "bytecodeBuilder.hpp"
+#include "log.hpp"
+
+uint32_t BytecodeBuilder::allocateTemp()
+{
+    const uint32_t temp = next_temp++;
+    if (next_temp > bytecode->registers_count)
+    {
+        bytecode->registers_count = next_temp;
+    }
+    return temp;
+}
+
+size_t BytecodeBuilder::emit(const Opcode opcode, const uint32_t dst, const uint32_t left, const uint32_t right)
+{
+    bytecode->code.push_back({opcode, dst, left, right});
+    return bytecode->code.size() - 1;
+}
+
+void BytecodeBuilder::emitConst(const uint32_t dst, const AstValue_t value)
+{
+    const uint64_t bits = static_cast<uint64_t>(value);
+    emit(Opcode::LOAD_CONST, dst, static_cast<uint32_t>(bits), static_cast<uint32_t>(bits >> 32));
+}
+
+// A condition computed by the last comparison is tested by the comparison
+// itself, which jumps when it does not hold. Returns the jump to patch.
+size_t BytecodeBuilder::emitJumpIfFalse(const uint32_t condition_register)
+{
+    if (!bytecode->code.empty() && condition_register >= bytecode->variables_count)
+    {
+        Instruction_t &last = bytecode->code.back();
+        const uint32_t compare = static_cast<uint32_t>(last.opcode) - static_cast<uint32_t>(Opcode::LESS);
+        // JUMP_IF_NOT_LESS..JUMP_IF_NOT_EQ follow LESS..EQ in the same order.
+        if (last.dst == condition_register && compare <= static_cast<uint32_t>(Opcode::EQ) - static_cast<uint32_t>(Opcode::LESS))
+        {
+            last.opcode = static_cast<Opcode>(static_cast<uint32_t>(Opcode::JUMP_IF_NOT_LESS) + compare);
+            last.dst = 0;
+            return bytecode->code.size() - 1;
+        }
+    }
+
+    return emit(Opcode::JUMP_IF_FALSE, 0, condition_register);
+}
+
+uint32_t BytecodeBuilder::constantRegister(const AstValue_t value)
+{
+    const auto [it, is_new] = constant_indices.try_emplace(value, static_cast<uint32_t>(bytecode->constants.size()));
+    if (is_new)
+    {
+        bytecode->constants.push_back(value);
+    }
+    return CONSTANT_FLAG | it->second;
+}
+
+// Gives the constants the registers above all temporaries and rewrites
+// every register operand that refers to one.
+void BytecodeBuilder::relocateConstants()
+{
+    const uint32_t constants_first = bytecode->registers_count;
+    bytecode->registers_count += static_cast<uint32_t>(bytecode->constants.size());
+    DEV_ASSERT(bytecode->registers_count >= CONSTANT_FLAG);
+
+    const auto relocate = [constants_first](uint32_t &reg)
+    {
+        if ((reg & CONSTANT_FLAG) != 0)
+        {
+            reg = constants_first + (reg & ~CONSTANT_FLAG);
+        }
+    };
+
+    for (Instruction_t &instruction : bytecode->code)
+    {
+        switch (instruction.opcode)
+        {
+        case Opcode::MOVE:
+        case Opcode::NOT:
+        case Opcode::PRINT:
+        case Opcode::JUMP_IF_FALSE:
+            relocate(instruction.left);
+            break;
+        case Opcode::ADD:
+        case Opcode::SUB:
+        case Opcode::MUL:
+        case Opcode::DIV:
+        case Opcode::LESS:
+        case Opcode::LESS_OR_EQ:
+        case Opcode::MORE:
+        case Opcode::MORE_OR_EQ:
+        case Opcode::EQ:
+        case Opcode::JUMP_IF_NOT_LESS:
+        case Opcode::JUMP_IF_NOT_LESS_OR_EQ:
+        case Opcode::JUMP_IF_NOT_MORE:
+        case Opcode::JUMP_IF_NOT_MORE_OR_EQ:
+        case Opcode::JUMP_IF_NOT_EQ:
+        case Opcode::STORE_ELEMENT:
+            relocate(instruction.left);
+            relocate(instruction.right);
+            break;
+        case Opcode::LOAD_ELEMENT:
+            relocate(instruction.right);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+uint32_t BytecodeBuilder::popRegister()
+{
+    DEV_ASSERT(registers.empty());
+
+    const uint32_t reg = registers.back();
+    registers.pop_back();
+    return reg;
+}
+
+size_t BytecodeBuilder::popPending()
+{
+    DEV_ASSERT(pending.empty());
+
+    const size_t value = pending.back();
+    pending.pop_back();
+    return value;
+}
+
+bool BytecodeBuilder::emitBinary(
+    const Opcode opcode,
+    const NonTerminalNode_t *left,
+    const NonTerminalNode_t *right,
+    const size_t step
+    )
+{
+    DEV_ASSERT(left == nullptr);
+    DEV_ASSERT(right == nullptr);
+
+    if (step == 0)
+    {
+        pending.push_back(next_temp);
+        walker.schedule(left);
+        walker.schedule(right);
+        return true;
+    }
+
+    const uint32_t right_register = popRegister();
+    const uint32_t left_register = popRegister();
+
+    // Operands are read before the result is written, so the result may
+    // reuse the first temporary of the operands.
+    next_temp = static_cast<uint32_t>(popPending());
+    const uint32_t result_register = allocateTemp();
+    emit(opcode, result_register, left_register, right_register);
+    registers.push_back(result_register);
+    return false;
+}
+
+bool BytecodeBuilder::visit(const ProgramNode_t &node, const size_t step)
+{
+    if (step == 0)
+    {
+        for (const auto child : node.children_vec)
+        {
+            walker.schedule(child);
+        }
+        return true;
+    }
+
+    emit(Opcode::HALT, 0);
+    return false;
+}
+
+bool BytecodeBuilder::visit(const VariableNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.slot >= bytecode->variables_count);
+
+    registers.push_back(static_cast<uint32_t>(node.slot));
+    return false;
+}
+
+bool BytecodeBuilder::visit(const ValueNode_t &node, const size_t step)
+{
+    registers.push_back(constantRegister(node.value));
+    return false;
+}
+
+// The right operand is skipped when the left one decides the result:
+//     NOT result, left
+//     JUMP_IF_FALSE end, left (&&) or result (||)
+//     <right>
+//     NOT result, right
+// end:
+//     NOT result, result
+// Both ways end with the same instruction, so an assignment can retarget
+// it like any other. result is allocated above the temporaries of the
+// left operand, which is still read by the jump.
+bool BytecodeBuilder::emitShortCircuit(
+    const bool is_and,
+    const NonTerminalNode_t *left,
+    const NonTerminalNode_t *right,
+    const size_t step
+    )
+{
+    DEV_ASSERT(left == nullptr);
+    DEV_ASSERT(right == nullptr);
+
+    switch (step)
+    {
+    case 0:
+        walker.schedule(left);
+        return true;
+    case 1:
+        {
+            const uint32_t left_register = popRegister();
+            const uint32_t result_register = allocateTemp();
+            emit(Opcode::NOT, result_register, left_register);
+
+            pending.push_back(result_register);
+            pending.push_back(emit(Opcode::JUMP_IF_FALSE, 0, is_and ? left_register : result_register));
+            walker.schedule(right);
+            return true;
+        }
+    default:
+        {
+            const size_t jump_to_end = popPending();
+            const uint32_t result_register = static_cast<uint32_t>(popPending());
+
+            emit(Opcode::NOT, result_register, popRegister());
+            bytecode->code[jump_to_end].dst = static_cast<uint32_t>(bytecode->code.size());
+            emit(Opcode::NOT, result_register, result_register);
+
+            next_temp = result_register + 1;
+            registers.push_back(result_register);
+            return false;
+        }
+    }
+}
+
+bool BytecodeBuilder::visit(const AndNode_t &node, const size_t step)
+{
+    return emitShortCircuit(true, node.left, node.right, step);
+}
+
+bool BytecodeBuilder::visit(const OrNode_t &node, const size_t step)
+{
+    return emitShortCircuit(false, node.left, node.right, step);
+}
+
+bool BytecodeBuilder::visit(const ComparatorNode_t &node, const size_t step)
+{
+    switch (node.oper)
+    {
+    case ComparatorOperators::LESS:
+        return emitBinary(Opcode::LESS, node.left, node.right, step);
+    case ComparatorOperators::LESS_OR_EQ:
+        return emitBinary(Opcode::LESS_OR_EQ, node.left, node.right, step);
+    case ComparatorOperators::MORE:
+        return emitBinary(Opcode::MORE, node.left, node.right, step);
+    case ComparatorOperators::MORE_OR_EQ:
+        return emitBinary(Opcode::MORE_OR_EQ, node.left, node.right, step);
+    case ComparatorOperators::EQ:
+        return emitBinary(Opcode::EQ, node.left, node.right, step);
+    default:
+        DEV_ASSERT(true);
+        return false;
+    }
+}
+
+bool BytecodeBuilder::visit(const ArithmeticNode_t &node, const size_t step)
+{
+    switch (node.oper)
+    {
+    case ArithmeticOperators::ADD:
+        return emitBinary(Opcode::ADD, node.left, node.right, step);
+    case ArithmeticOperators::SUB:
+        return emitBinary(Opcode::SUB, node.left, node.right, step);
+    case ArithmeticOperators::MUL:
+        return emitBinary(Opcode::MUL, node.left, node.right, step);
+    case ArithmeticOperators::DIV:
+        return emitBinary(Opcode::DIV, node.left, node.right, step);
+    default:
+        DEV_ASSERT(true);
+        return false;
+    }
+}
+
+bool BytecodeBuilder::visit(const NotNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.child == nullptr);
+
+    if (step == 0)
+    {
+        pending.push_back(next_temp);
+        walker.schedule(node.child);
+        return true;
+    }
+
+    const uint32_t child_register = popRegister();
+
+    next_temp = static_cast<uint32_t>(popPending());
+    const uint32_t result_register = allocateTemp();
+    emit(Opcode::NOT, result_register, child_register);
+    registers.push_back(result_register);
+    return false;
+}
+
+bool BytecodeBuilder::visit(const NopRuleNode_t &node, const size_t step)
+{
+    for (const auto child : node.children_vec)
+    {
+        walker.schedule(child);
+    }
+    return false;
+}
+
+bool BytecodeBuilder::visit(const AssignNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.value == nullptr);
+    DEV_ASSERT(node.slot >= bytecode->variables_count);
+
+    if (step == 0)
+    {
+        pending.push_back(next_temp);
+        walker.schedule(node.value);
+        return true;
+    }
+
+    const uint32_t slot = static_cast<uint32_t>(node.slot);
+    const uint32_t value_register = popRegister();
+
+    // A value computed into a temporary comes from the last emitted
+    // instruction, so retarget it instead of copying the temporary.
+    if (value_register >= bytecode->variables_count && (value_register & CONSTANT_FLAG) == 0)
+    {
+        bytecode->code.back().dst = slot;
+    }
+    else
+    {
+        emit(Opcode::MOVE, slot, value_register);
+    }
+
+    next_temp = static_cast<uint32_t>(popPending());
+    return false;
+}
+
+bool BytecodeBuilder::visit(const DeclareNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.slot >= bytecode->variables_count);
+
+    emitConst(static_cast<uint32_t>(node.slot), 0);
+    return false;
+}
+
+bool BytecodeBuilder::visit(const PrintNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.child == nullptr);
+
+    if (step == 0)
+    {
+        pending.push_back(next_temp);
+        walker.schedule(node.child);
+        return true;
+    }
+
+    emit(Opcode::PRINT, 0, popRegister());
+
+    next_temp = static_cast<uint32_t>(popPending());
+    return false;
+}
+
+bool BytecodeBuilder::visit(const IfNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.if_case == nullptr);
+    DEV_ASSERT(node.expr == nullptr);
+
+    switch (step)
+    {
+    case 0:
+        pending.push_back(next_temp);
+        walker.schedule(node.if_case);
+        return true;
+    case 1:
+        {
+            const uint32_t condition_register = popRegister();
+            next_temp = static_cast<uint32_t>(popPending());
+
+            pending.push_back(emitJumpIfFalse(condition_register));
+            walker.schedule(node.expr);
+            return true;
+        }
+    default:
+        {
+            const size_t jump_to_end = popPending();
+            bytecode->code[jump_to_end].dst = static_cast<uint32_t>(bytecode->code.size());
+            return false;
+        }
+    }
+}
+
+bool BytecodeBuilder::visit(const IfElseNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.if_case == nullptr);
+    DEV_ASSERT(node.true_expr == nullptr);
+    DEV_ASSERT(node.false_expr == nullptr);
+
+    switch (step)
+    {
+    case 0:
+        pending.push_back(next_temp);
+        walker.schedule(node.if_case);
+        return true;
+    case 1:
+        {
+            const uint32_t condition_register = popRegister();
+            next_temp = static_cast<uint32_t>(popPending());
+
+            pending.push_back(emitJumpIfFalse(condition_register));
+            walker.schedule(node.true_expr);
+            return true;
+        }
+    case 2:
+        {
+            const size_t jump_to_else = popPending();
+            pending.push_back(emit(Opcode::JUMP, 0));
+
+            bytecode->code[jump_to_else].dst = static_cast<uint32_t>(bytecode->code.size());
+            walker.schedule(node.false_expr);
+            return true;
+        }
+    default:
+        {
+            const size_t jump_to_end = popPending();
+            bytecode->code[jump_to_end].dst = static_cast<uint32_t>(bytecode->code.size());
+            return false;
+        }
+    }
+}
+
+bool BytecodeBuilder::visit(const WhileNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.condition == nullptr);
+    DEV_ASSERT(node.body == nullptr);
+
+    switch (step)
+    {
+    case 0:
+        // Where the condition starts, the end of the body jumps back here.
+        pending.push_back(bytecode->code.size());
+        pending.push_back(next_temp);
+        walker.schedule(node.condition);
+        return true;
+    case 1:
+        {
+            const uint32_t condition_register = popRegister();
+            next_temp = static_cast<uint32_t>(popPending());
+
+            pending.push_back(emitJumpIfFalse(condition_register));
+            walker.schedule(node.body);
+            return true;
+        }
+    default:
+        {
+            const size_t jump_to_end = popPending();
+            const size_t condition_start = popPending();
+
+            emit(Opcode::JUMP, static_cast<uint32_t>(condition_start));
+            bytecode->code[jump_to_end].dst = static_cast<uint32_t>(bytecode->code.size());
+            return false;
+        }
+    }
+}
+
+bool BytecodeBuilder::visit(const ArrayDeclareNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.array >= bytecode->arrays.size());
+
+    emit(Opcode::CLEAR_ARRAY, static_cast<uint32_t>(node.array));
+    return false;
+}
+
+bool BytecodeBuilder::visit(const ElementNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.index == nullptr);
+    DEV_ASSERT(node.array >= bytecode->arrays.size());
+
+    if (step == 0)
+    {
+        pending.push_back(next_temp);
+        walker.schedule(node.index);
+        return true;
+    }
+
+    const uint32_t index_register = popRegister();
+
+    next_temp = static_cast<uint32_t>(popPending());
+    const uint32_t result_register = allocateTemp();
+    emit(Opcode::LOAD_ELEMENT, result_register, static_cast<uint32_t>(node.array), index_register);
+    registers.push_back(result_register);
+    return false;
+}
+
+bool BytecodeBuilder::visit(const ElementAssignNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.index == nullptr);
+    DEV_ASSERT(node.value == nullptr);
+    DEV_ASSERT(node.array >= bytecode->arrays.size());
+
+    if (step == 0)
+    {
+        pending.push_back(next_temp);
+        walker.schedule(node.index);
+        walker.schedule(node.value);
+        return true;
+    }
+
+    const uint32_t value_register = popRegister();
+    const uint32_t index_register = popRegister();
+    emit(Opcode::STORE_ELEMENT, static_cast<uint32_t>(node.array), value_register, index_register);
+
+    next_temp = static_cast<uint32_t>(popPending());
+    return false;
+}
+
+bool BytecodeBuilder::visit(const ArrayAssignNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.array >= bytecode->arrays.size());
+
+    // ArrayOperators follow ARRAY_ADD..ARRAY_EQ in the same order.
+    const Opcode opcode = static_cast<Opcode>(static_cast<uint32_t>(Opcode::ARRAY_ADD) + static_cast<uint32_t>(node.oper));
+    emit(opcode, static_cast<uint32_t>(node.array), static_cast<uint32_t>(node.left), static_cast<uint32_t>(node.right));
+    return false;
+}
+
+void BytecodeBuilder::generateBytecode(Bytecode_t &output, const ProgramNode_t &root)
+{
+    bytecode = &output;
+    bytecode->code.clear();
+    bytecode->arrays.clear();
+    bytecode->constants.clear();
+    constant_indices.clear();
+    for (const auto &array : root.arrays)
+    {
+        bytecode->arrays.push_back({static_cast<uint32_t>(array.slot), static_cast<uint32_t>(array.size)});
+    }
+    bytecode->variables_count = static_cast<uint32_t>(root.variables_count);
+    bytecode->registers_count = bytecode->variables_count;
+    next_temp = bytecode->variables_count;
+
+    walker.walk(*this, root);
+    relocateConstants();
+
+    DEV_ASSERT(!verifyBytecode(*bytecode));
+    bytecode = nullptr;
+}
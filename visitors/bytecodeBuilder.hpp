@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.hpp"
+#include "astWalker.hpp"
+#include "bytecode.hpp"
+#include "visitor.hpp"
+
+// Lowers a resolved AST to register bytecode. Variables live in the
+// registers matching their slots, temporaries are allocated above them
+// in stack order and released at the end of every statement. Constants
+// get registers of their own above all temporaries, so they are loaded
+// once instead of on every use.
+class BytecodeBuilder : public Visitor
+{
+private:
+    Bytecode_t *bytecode;
+    uint32_t next_temp;
+    // Registers holding the values of the lowered subexpressions.
+    std::vector<uint32_t> registers;
+    // Temporaries marks and jumps to patch, kept by nodes between their steps.
+    std::vector<size_t> pending;
+    // Index of every constant in Bytecode_t::constants. Until the walk ends
+    // and the number of temporaries is known, the register of a constant
+    // is CONSTANT_FLAG | its index.
+    std::unordered_map<AstValue_t, uint32_t> constant_indices;
+    static constexpr uint32_t CONSTANT_FLAG = 0x8000'0000;
+    AstWalker_t walker;
+
+public:
+    explicit BytecodeBuilder()
+        :
+            bytecode(nullptr),
+            next_temp(0)
+    {}
+
+    bool visit(const ProgramNode_t &node, size_t step);
+    bool visit(const VariableNode_t &node, size_t step);
+    bool visit(const ValueNode_t &node, size_t step);
+    bool visit(const AndNode_t &node, size_t step);
+    bool visit(const OrNode_t &node, size_t step);
+    bool visit(const ComparatorNode_t &node, size_t step);
+    bool visit(const ArithmeticNode_t &node, size_t step);
+    bool visit(const NotNode_t &node, size_t step);
+    bool visit(const NopRuleNode_t &node, size_t step);
+    bool visit(const AssignNode_t &node, size_t step);
+    bool visit(const DeclareNode_t &node, size_t step);
+    bool visit(const PrintNode_t &node, size_t step);
+    bool visit(const IfNode_t &node, size_t step);
+    bool visit(const IfElseNode_t &node, size_t step);
+    bool visit(const WhileNode_t &node, size_t step);
+    bool visit(const ArrayDeclareNode_t &node, size_t step);
+    bool visit(const ElementNode_t &node, size_t step);
+    bool visit(const ElementAssignNode_t &node, size_t step);
+    bool visit(const ArrayAssignNode_t &node, size_t step);
+
+    void generateBytecode(Bytecode_t &output, const ProgramNode_t &root);
+
+private:
+    uint32_t allocateTemp();
+    size_t emit(Opcode opcode, uint32_t dst, uint32_t left = 0, uint32_t right = 0);
+    void emitConst(uint32_t dst, AstValue_t value);
+    size_t emitJumpIfFalse(uint32_t condition_register);
+    uint32_t constantRegister(AstValue_t value);
+    void relocateConstants();
+    bool emitBinary(Opcode opcode, const NonTerminalNode_t *left, const NonTerminalNode_t *right, size_t step);
+    bool emitShortCircuit(bool is_and, const NonTerminalNode_t *left, const NonTerminalNode_t *right, size_t step);
+    uint32_t popRegister();
+    size_t popPending();
+};
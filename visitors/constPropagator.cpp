@@ -0,0 +1,441 @@
+#include "constPropagator.hpp"
+#include "log.hpp"
+
+const RuleNode_t *ConstPropagator::popRule()
+{
+    DEV_ASSERT(rules.empty());
+
+    const RuleNode_t *rule = rules.back();
+    rules.pop_back();
+    return rule;
+}
+
+// Walks an arm which can never run, only to account for what is removed.
+// Unreachable rules never skip anything themselves, so this nests at most once.
+void ConstPropagator::skipDeadRule(const RuleNode_t *rule)
+{
+    DEV_ASSERT(rule == nullptr);
+
+    const bool was_reachable = is_reachable;
+    is_reachable = false;
+    walker.walk(*this, *rule);
+    is_reachable = was_reachable;
+}
+
+// A variable stays constant after a join only if both paths agree on it.
+void ConstPropagator::mergeValues(const KnownValues_t &other)
+{
+    DEV_ASSERT(values.size() != other.size());
+
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        if (values[i] != other[i])
+        {
+            values[i] = std::nullopt;
+        }
+    }
+}
+
+bool ConstPropagator::visit(const ProgramNode_t &node, const size_t step)
+{
+    // The statement list is replaced in place by propagate().
+    DEV_ASSERT(true);
+    return false;
+}
+
+bool ConstPropagator::visit(const VariableNode_t &node, const size_t step)
+{
+    DEV_ASSERT(true);
+    return false;
+}
+
+bool ConstPropagator::visit(const ValueNode_t &node, const size_t step)
+{
+    DEV_ASSERT(true);
+    return false;
+}
+
+bool ConstPropagator::visit(const AndNode_t &node, const size_t step)
+{
+    DEV_ASSERT(true);
+    return false;
+}
+
+bool ConstPropagator::visit(const OrNode_t &node, const size_t step)
+{
+    DEV_ASSERT(true);
+    return false;
+}
+
+bool ConstPropagator::visit(const ComparatorNode_t &node, const size_t step)
+{
+    DEV_ASSERT(true);
+    return false;
+}
+
+bool ConstPropagator::visit(const ArithmeticNode_t &node, const size_t step)
+{
+    DEV_ASSERT(true);
+    return false;
+}
+
+bool ConstPropagator::visit(const NotNode_t &node, const size_t step)
+{
+    DEV_ASSERT(true);
+    return false;
+}
+
+bool ConstPropagator::visit(const NopRuleNode_t &node, const size_t step)
+{
+    if (step == 0)
+    {
+        for (const auto child : node.children_vec)
+        {
+            walker.schedule(child);
+        }
+        // Unreachable children leave no rules to collect.
+        return is_reachable;
+    }
+
+    // Every child has left its propagated rule, in the same order.
+    const size_t first_child = rules.size() - node.children_vec.size();
+    NopRuleNode_t *propagated = nullptr;
+    bool is_changed = false;
+
+    for (size_t i = 0; i < node.children_vec.size(); ++i)
+    {
+        const RuleNode_t *child = rules[first_child + i];
+        if (!is_changed && child != node.children_vec[i])
+        {
+            is_changed = true;
+            propagated = arena.create<NopRuleNode_t>(arena);
+            propagated->children_vec.reserve(node.children_vec.size());
+            for (size_t j = 0; j < i; ++j)
+            {
+                propagated->addChild(node.children_vec[j]);
+            }
+        }
+        if (is_changed && child != nullptr)
+        {
+            propagated->addChild(child);
+        }
+    }
+    rules.resize(first_child);
+
+    if (!is_changed)
+    {
+        rules.push_back(&node);
+        return false;
+    }
+    rules.push_back(propagated->children_vec.empty() ? nullptr : propagated);
+    return false;
+}
+
+bool ConstPropagator::visit(const AssignNode_t &node, const size_t step)
+{
+    if (!is_reachable)
+    {
+        ++removed_statements;
+        return false;
+    }
+
+    const NonTerminalNode_t *value = folder.foldExpression(node.value);
+    values[node.slot] = folder.foldedValue();
+
+    if (value == node.value)
+    {
+        rules.push_back(&node);
+        return false;
+    }
+
+    AssignNode_t *propagated = arena.create<AssignNode_t>(node.name, value);
+    propagated->slot = node.slot;
+    rules.push_back(propagated);
+    return false;
+}
+
+bool ConstPropagator::visit(const DeclareNode_t &node, const size_t step)
+{
+    if (!is_reachable)
+    {
+        ++removed_statements;
+        return false;
+    }
+
+    values[node.slot] = 0;
+    rules.push_back(&node);
+    return false;
+}
+
+bool ConstPropagator::visit(const PrintNode_t &node, const size_t step)
+{
+    if (!is_reachable)
+    {
+        ++removed_statements;
+        return false;
+    }
+
+    const NonTerminalNode_t *child = folder.foldExpression(node.child);
+    rules.push_back(child == node.child ? static_cast<const RuleNode_t*>(&node) : arena.create<PrintNode_t>(child));
+    return false;
+}
+
+bool ConstPropagator::visit(const IfNode_t &node, const size_t step)
+{
+    if (!is_reachable)
+    {
+        ++removed_statements;
+        walker.schedule(node.expr);
+        return false;
+    }
+
+    if (step == 0)
+    {
+        const NonTerminalNode_t *if_case = folder.foldExpression(node.if_case);
+        const std::optional<AstValue_t> if_value = folder.foldedValue();
+
+        if (if_value.has_value())
+        {
+            ++removed_branches;
+            if (*if_value)
+            {
+                // The arm leaves its rule in place of the if.
+                walker.schedule(node.expr);
+            }
+            else
+            {
+                ++removed_statements;
+                skipDeadRule(node.expr);
+                rules.push_back(nullptr);
+            }
+            return false;
+        }
+
+        conditions.push_back(if_case);
+        saved_values.push_back(values);
+        walker.schedule(node.expr);
+        return true;
+    }
+
+    const RuleNode_t *expr = popRule();
+    mergeValues(saved_values.back());
+    saved_values.pop_back();
+
+    const NonTerminalNode_t *if_case = conditions.back();
+    conditions.pop_back();
+
+    if (expr == nullptr)
+    {
+        expr = arena.create<NopRuleNode_t>(arena);
+    }
+
+    if (if_case == node.if_case && expr == node.expr)
+    {
+        rules.push_back(&node);
+        return false;
+    }
+    rules.push_back(arena.create<IfNode_t>(if_case, expr));
+    return false;
+}
+
+bool ConstPropagator::visit(const IfElseNode_t &node, const size_t step)
+{
+    if (!is_reachable)
+    {
+        ++removed_statements;
+        walker.schedule(node.true_expr);
+        walker.schedule(node.false_expr);
+        return false;
+    }
+
+    if (step == 0)
+    {
+        const NonTerminalNode_t *if_case = folder.foldExpression(node.if_case);
+        const std::optional<AstValue_t> if_value = folder.foldedValue();
+
+        if (if_value.has_value())
+        {
+            ++removed_branches;
+            if (*if_value)
+            {
+                skipDeadRule(node.false_expr);
+                walker.schedule(node.true_expr);
+            }
+            else
+            {
+                skipDeadRule(node.true_expr);
+                walker.schedule(node.false_expr);
+            }
+            return false;
+        }
+
+        conditions.push_back(if_case);
+        saved_values.push_back(values);
+        walker.schedule(node.true_expr);
+        return true;
+    }
+
+    if (step == 1)
+    {
+        // The false arm starts from the values before the if, the ones
+        // after the true arm are kept for the join.
+        std::swap(values, saved_values.back());
+        walker.schedule(node.false_expr);
+        return true;
+    }
+
+    const RuleNode_t *false_expr = popRule();
+    const RuleNode_t *true_expr = popRule();
+    mergeValues(saved_values.back());
+    saved_values.pop_back();
+
+    const NonTerminalNode_t *if_case = conditions.back();
+    conditions.pop_back();
+
+    if (true_expr == nullptr)
+    {
+        true_expr = arena.create<NopRuleNode_t>(arena);
+    }
+    if (false_expr == nullptr)
+    {
+        false_expr = arena.create<NopRuleNode_t>(arena);
+    }
+
+    if (if_case == node.if_case && true_expr == node.true_expr && false_expr == node.false_expr)
+    {
+        rules.push_back(&node);
+        return false;
+    }
+    rules.push_back(arena.create<IfElseNode_t>(if_case, true_expr, false_expr));
+    return false;
+}
+
+// Values known before the loop may be changed by any iteration, so none of
+// them are trusted in the condition, in the body or after the loop.
+bool ConstPropagator::visit(const WhileNode_t &node, const size_t step)
+{
+    if (!is_reachable)
+    {
+        ++removed_statements;
+        walker.schedule(node.body);
+        return false;
+    }
+
+    if (step == 0)
+    {
+        values.assign(values.size(), std::nullopt);
+
+        const NonTerminalNode_t *condition = folder.foldExpression(node.condition);
+        const std::optional<AstValue_t> condition_value = folder.foldedValue();
+
+        if (condition_value.has_value() && !*condition_value)
+        {
+            ++removed_branches;
+            ++removed_statements;
+            skipDeadRule(node.body);
+            rules.push_back(nullptr);
+            return false;
+        }
+
+        conditions.push_back(condition);
+        walker.schedule(node.body);
+        return true;
+    }
+
+    const RuleNode_t *body = popRule();
+    values.assign(values.size(), std::nullopt);
+
+    const NonTerminalNode_t *condition = conditions.back();
+    conditions.pop_back();
+
+    if (body == nullptr)
+    {
+        body = arena.create<NopRuleNode_t>(arena);
+    }
+
+    if (condition == node.condition && body == node.body)
+    {
+        rules.push_back(&node);
+        return false;
+    }
+    rules.push_back(arena.create<WhileNode_t>(condition, body));
+    return false;
+}
+
+// Array elements are never tracked, only the expressions in these are folded.
+bool ConstPropagator::visit(const ArrayDeclareNode_t &node, const size_t step)
+{
+    if (!is_reachable)
+    {
+        ++removed_statements;
+        return false;
+    }
+
+    rules.push_back(&node);
+    return false;
+}
+
+bool ConstPropagator::visit(const ElementNode_t &node, const size_t step)
+{
+    DEV_ASSERT(true);
+    return false;
+}
+
+bool ConstPropagator::visit(const ElementAssignNode_t &node, const size_t step)
+{
+    if (!is_reachable)
+    {
+        ++removed_statements;
+        return false;
+    }
+
+    const NonTerminalNode_t *index = folder.foldExpression(node.index);
+    const NonTerminalNode_t *value = folder.foldExpression(node.value);
+
+    if (index == node.index && value == node.value)
+    {
+        rules.push_back(&node);
+        return false;
+    }
+
+    ElementAssignNode_t *propagated = arena.create<ElementAssignNode_t>(node.name, index, value);
+    propagated->array = node.array;
+    rules.push_back(propagated);
+    return false;
+}
+
+bool ConstPropagator::visit(const ArrayAssignNode_t &node, const size_t step)
+{
+    if (!is_reachable)
+    {
+        ++removed_statements;
+        return false;
+    }
+
+    rules.push_back(&node);
+    return false;
+}
+
+void ConstPropagator::propagate(ProgramNode_t &root)
+{
+    // The interpreter and the VM start with every variable zeroed.
+    values.assign(root.variables_count, 0);
+    folder.setKnownValues(&values);
+
+    ArenaVector_t<const RuleNode_t*> propagated(arena);
+    propagated.reserve(root.children_vec.size());
+
+    for (const auto child : root.children_vec)
+    {
+        walker.walk(*this, *child);
+
+        const RuleNode_t *rule = popRule();
+        if (rule != nullptr)
+        {
+            propagated.push_back(rule);
+        }
+    }
+
+    root.children_vec = propagated;
+    folder.setKnownValues(nullptr);
+}
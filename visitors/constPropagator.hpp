@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+
+#include "arena.hpp"
+#include "ast.hpp"
+#include "astWalker.hpp"
+#include "constantFolder.hpp"
+#include "visitor.hpp"
+
+// Constant propagation over the statement list. Tracks which variables hold
+// a known constant at each point, replaces their reads by literals, folds
+// the result and deletes if/else arms and loops that can never run.
+// Expressions are handled by the embedded ConstantFolder, so only rule
+// nodes are visited here.
+class ConstPropagator : public Visitor
+{
+private:
+    AstArena_t &arena;
+    ConstantFolder folder;
+    KnownValues_t values;
+    AstWalker_t walker;
+
+    // Propagated children, popped by their parent. Rules which can never
+    // run leave nothing here.
+    std::vector<const RuleNode_t*> rules;
+    // State an if, if/else or while keeps between its steps.
+    std::vector<const NonTerminalNode_t*> conditions;
+    std::vector<KnownValues_t> saved_values;
+    bool is_reachable;
+
+    size_t removed_branches;
+    size_t removed_statements;
+
+public:
+    explicit ConstPropagator(AstArena_t &arena_)
+        :
+            arena(arena_),
+            folder(arena_),
+            is_reachable(true),
+            removed_branches(0),
+            removed_statements(0)
+    {}
+
+    bool visit(const ProgramNode_t &node, size_t step);
+    bool visit(const VariableNode_t &node, size_t step);
+    bool visit(const ValueNode_t &node, size_t step);
+    bool visit(const AndNode_t &node, size_t step);
+    bool visit(const OrNode_t &node, size_t step);
+    bool visit(const ComparatorNode_t &node, size_t step);
+    bool visit(const ArithmeticNode_t &node, size_t step);
+    bool visit(const NotNode_t &node, size_t step);
+    bool visit(const NopRuleNode_t &node, size_t step);
+    bool visit(const AssignNode_t &node, size_t step);
+    bool visit(const DeclareNode_t &node, size_t step);
+    bool visit(const PrintNode_t &node, size_t step);
+    bool visit(const IfNode_t &node, size_t step);
+    bool visit(const IfElseNode_t &node, size_t step);
+    bool visit(const WhileNode_t &node, size_t step);
+    bool visit(const ArrayDeclareNode_t &node, size_t step);
+    bool visit(const ElementNode_t &node, size_t step);
+    bool visit(const ElementAssignNode_t &node, size_t step);
+    bool visit(const ArrayAssignNode_t &node, size_t step);
+
+    void propagate(ProgramNode_t &root);
+
+    size_t removedBranches() const
+    {
+        return removed_branches;
+    }
+
+    size_t removedStatements() const
+    {
+        return removed_statements;
+    }
+
+    size_t replacedReads() const
+    {
+        return folder.substitutedCount();
+    }
+
+private:
+    const RuleNode_t *popRule();
+    void skipDeadRule(const RuleNode_t *rule);
+    void mergeValues(const KnownValues_t &other);
+};
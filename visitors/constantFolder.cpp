@@ -0,0 +1,600 @@
+#include <cstdint>
+#include <limits>
+
+#include "constantFolder.hpp"
+#include "log.hpp"
+
+// Integer arithmetic of every backend wraps around, do the same here.
+static AstValue_t wrappingAdd(const AstValue_t left, const AstValue_t right)
+{
+    return static_cast<AstValue_t>(static_cast<uint64_t>(left) + static_cast<uint64_t>(right));
+}
+
+static AstValue_t wrappingSub(const AstValue_t left, const AstValue_t right)
+{
+    return static_cast<AstValue_t>(static_cast<uint64_t>(left) - static_cast<uint64_t>(right));
+}
+
+static AstValue_t wrappingMul(const AstValue_t left, const AstValue_t right)
+{
+    return static_cast<AstValue_t>(static_cast<uint64_t>(left) * static_cast<uint64_t>(right));
+}
+
+static bool isTrappingDivision(const AstValue_t left, const AstValue_t right)
+{
+    return right == 0 || (left == std::numeric_limits<AstValue_t>::min() && right == -1);
+}
+
+ConstantFolder::Folded_t ConstantFolder::popExpression()
+{
+    DEV_ASSERT(expressions.empty());
+
+    const Folded_t folded = expressions.back();
+    expressions.pop_back();
+    return folded;
+}
+
+const RuleNode_t *ConstantFolder::popRule()
+{
+    DEV_ASSERT(rules.empty());
+
+    const RuleNode_t *rule = rules.back();
+    rules.pop_back();
+    return rule;
+}
+
+void ConstantFolder::setConstant(const AstValue_t value)
+{
+    expressions.push_back({arena.create<ValueNode_t>(value), value, false});
+    ++folded_count;
+}
+
+void ConstantFolder::setExpression(const NonTerminalNode_t *expression, const bool may_trap)
+{
+    expressions.push_back({expression, std::nullopt, may_trap});
+}
+
+bool ConstantFolder::visit(const ProgramNode_t &node, const size_t step)
+{
+    // The statement list is replaced in place by fold().
+    DEV_ASSERT(true);
+    return false;
+}
+
+bool ConstantFolder::visit(const VariableNode_t &node, const size_t step)
+{
+    if (known_values != nullptr && node.slot < known_values->size() && (*known_values)[node.slot].has_value())
+    {
+        const AstValue_t value = *(*known_values)[node.slot];
+
+        expressions.push_back({arena.create<ValueNode_t>(value), value, false});
+        ++substituted_count;
+        return false;
+    }
+
+    setExpression(&node, false);
+    return false;
+}
+
+bool ConstantFolder::visit(const ValueNode_t &node, const size_t step)
+{
+    expressions.push_back({&node, node.value, false});
+    return false;
+}
+
+bool ConstantFolder::visit(const AndNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.left == nullptr);
+    DEV_ASSERT(node.right == nullptr);
+
+    if (step == 0)
+    {
+        walker.schedule(node.left);
+        walker.schedule(node.right);
+        return true;
+    }
+
+    const Folded_t right = popExpression();
+    const Folded_t left = popExpression();
+
+    if (left.value.has_value() && right.value.has_value())
+    {
+        setConstant(*left.value && *right.value);
+    }
+    else if ((left.value == 0 && !right.may_trap) || (right.value == 0 && !left.may_trap))
+    {
+        setConstant(0);
+    }
+    else if (left.node == node.left && right.node == node.right)
+    {
+        setExpression(&node, left.may_trap || right.may_trap);
+    }
+    else
+    {
+        setExpression(arena.create<AndNode_t>(left.node, right.node), left.may_trap || right.may_trap);
+    }
+    return false;
+}
+
+bool ConstantFolder::visit(const OrNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.left == nullptr);
+    DEV_ASSERT(node.right == nullptr);
+
+    if (step == 0)
+    {
+        walker.schedule(node.left);
+        walker.schedule(node.right);
+        return true;
+    }
+
+    const Folded_t right = popExpression();
+    const Folded_t left = popExpression();
+
+    const bool is_left_true = left.value.has_value() && *left.value != 0;
+    const bool is_right_true = right.value.has_value() && *right.value != 0;
+
+    if (left.value.has_value() && right.value.has_value())
+    {
+        setConstant(*left.value || *right.value);
+    }
+    else if ((is_left_true && !right.may_trap) || (is_right_true && !left.may_trap))
+    {
+        setConstant(1);
+    }
+    else if (left.node == node.left && right.node == node.right)
+    {
+        setExpression(&node, left.may_trap || right.may_trap);
+    }
+    else
+    {
+        setExpression(arena.create<OrNode_t>(left.node, right.node), left.may_trap || right.may_trap);
+    }
+    return false;
+}
+
+bool ConstantFolder::visit(const ComparatorNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.left == nullptr);
+    DEV_ASSERT(node.right == nullptr);
+
+    if (step == 0)
+    {
+        walker.schedule(node.left);
+        walker.schedule(node.right);
+        return true;
+    }
+
+    const Folded_t right = popExpression();
+    const Folded_t left = popExpression();
+
+    if (left.value.has_value() && right.value.has_value())
+    {
+        const AstValue_t value1 = *left.value;
+        const AstValue_t value2 = *right.value;
+
+        switch (node.oper)
+        {
+        case ComparatorOperators::LESS:
+            setConstant(value1 < value2);
+            break;
+        case ComparatorOperators::LESS_OR_EQ:
+            setConstant(value1 <= value2);
+            break;
+        case ComparatorOperators::MORE:
+            setConstant(value1 > value2);
+            break;
+        case ComparatorOperators::MORE_OR_EQ:
+            setConstant(value1 >= value2);
+            break;
+        case ComparatorOperators::EQ:
+            setConstant(value1 == value2);
+            break;
+        default:
+            DEV_ASSERT(true);
+            break;
+        }
+    }
+    else if (left.node == node.left && right.node == node.right)
+    {
+        setExpression(&node, left.may_trap || right.may_trap);
+    }
+    else
+    {
+        setExpression(
+            arena.create<ComparatorNode_t>(node.oper, left.node, right.node),
+            left.may_trap || right.may_trap
+        );
+    }
+    return false;
+}
+
+bool ConstantFolder::visit(const ArithmeticNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.left == nullptr);
+    DEV_ASSERT(node.right == nullptr);
+
+    if (step == 0)
+    {
+        walker.schedule(node.left);
+        walker.schedule(node.right);
+        return true;
+    }
+
+    const Folded_t right = popExpression();
+    const Folded_t left = popExpression();
+
+    bool may_trap = left.may_trap || right.may_trap;
+
+    if (left.value.has_value() && right.value.has_value())
+    {
+        const AstValue_t value1 = *left.value;
+        const AstValue_t value2 = *right.value;
+
+        switch (node.oper)
+        {
+        case ArithmeticOperators::ADD:
+            setConstant(wrappingAdd(value1, value2));
+            return false;
+        case ArithmeticOperators::SUB:
+            setConstant(wrappingSub(value1, value2));
+            return false;
+        case ArithmeticOperators::MUL:
+            setConstant(wrappingMul(value1, value2));
+            return false;
+        case ArithmeticOperators::DIV:
+            // Leave the division in place, the program has to fail at run time.
+            if (!isTrappingDivision(value1, value2))
+            {
+                setConstant(value1 / value2);
+                return false;
+            }
+            may_trap = true;
+            break;
+        default:
+            DEV_ASSERT(true);
+            break;
+        }
+    }
+    else
+    {
+        switch (node.oper)
+        {
+        case ArithmeticOperators::ADD:
+            if (left.value == 0)
+            {
+                setExpression(right.node, right.may_trap);
+                return false;
+            }
+            if (right.value == 0)
+            {
+                setExpression(left.node, left.may_trap);
+                return false;
+            }
+            break;
+        case ArithmeticOperators::SUB:
+            if (right.value == 0)
+            {
+                setExpression(left.node, left.may_trap);
+                return false;
+            }
+            break;
+        case ArithmeticOperators::MUL:
+            if ((left.value == 0 && !right.may_trap) || (right.value == 0 && !left.may_trap))
+            {
+                setConstant(0);
+                return false;
+            }
+            if (left.value == 1)
+            {
+                setExpression(right.node, right.may_trap);
+                return false;
+            }
+            if (right.value == 1)
+            {
+                setExpression(left.node, left.may_trap);
+                return false;
+            }
+            break;
+        case ArithmeticOperators::DIV:
+            if (right.value == 1)
+            {
+                setExpression(left.node, left.may_trap);
+                return false;
+            }
+            // Any divisor other than a known safe constant may trap.
+            may_trap = may_trap || !right.value.has_value() || *right.value == 0 || *right.value == -1;
+            break;
+        default:
+            DEV_ASSERT(true);
+            break;
+        }
+    }
+
+    if (left.node == node.left && right.node == node.right)
+    {
+        setExpression(&node, may_trap);
+    }
+    else
+    {
+        setExpression(arena.create<ArithmeticNode_t>(node.oper, left.node, right.node), may_trap);
+    }
+    return false;
+}
+
+bool ConstantFolder::visit(const NotNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.child == nullptr);
+
+    if (step == 0)
+    {
+        walker.schedule(node.child);
+        return true;
+    }
+
+    const Folded_t child = popExpression();
+
+    if (child.value.has_value())
+    {
+        setConstant(!*child.value);
+    }
+    else if (child.node == node.child)
+    {
+        setExpression(&node, child.may_trap);
+    }
+    else
+    {
+        setExpression(arena.create<NotNode_t>(child.node), child.may_trap);
+    }
+    return false;
+}
+
+bool ConstantFolder::visit(const NopRuleNode_t &node, const size_t step)
+{
+    if (step == 0)
+    {
+        for (const auto child : node.children_vec)
+        {
+            walker.schedule(child);
+        }
+        return true;
+    }
+
+    // Every child has left its folded rule, in the same order.
+    const size_t first_child = rules.size() - node.children_vec.size();
+    NopRuleNode_t *folded = nullptr;
+
+    for (size_t i = 0; i < node.children_vec.size(); ++i)
+    {
+        const RuleNode_t *child = rules[first_child + i];
+        if (folded == nullptr && child != node.children_vec[i])
+        {
+            folded = arena.create<NopRuleNode_t>(arena);
+            folded->children_vec.reserve(node.children_vec.size());
+            for (size_t j = 0; j < i; ++j)
+            {
+                folded->addChild(node.children_vec[j]);
+            }
+        }
+        if (folded != nullptr)
+        {
+            folded->addChild(child);
+        }
+    }
+    rules.resize(first_child);
+
+    rules.push_back(folded == nullptr ? static_cast<const RuleNode_t*>(&node) : folded);
+    return false;
+}
+
+bool ConstantFolder::visit(const AssignNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.value == nullptr);
+
+    if (step == 0)
+    {
+        walker.schedule(node.value);
+        return true;
+    }
+
+    const NonTerminalNode_t *value = popExpression().node;
+
+    if (value == node.value)
+    {
+        rules.push_back(&node);
+        return false;
+    }
+
+    AssignNode_t *folded = arena.create<AssignNode_t>(node.name, value);
+    folded->slot = node.slot;
+    rules.push_back(folded);
+    return false;
+}
+
+bool ConstantFolder::visit(const DeclareNode_t &node, const size_t step)
+{
+    rules.push_back(&node);
+    return false;
+}
+
+bool ConstantFolder::visit(const PrintNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.child == nullptr);
+
+    if (step == 0)
+    {
+        walker.schedule(node.child);
+        return true;
+    }
+
+    const NonTerminalNode_t *child = popExpression().node;
+
+    rules.push_back(child == node.child ? static_cast<const RuleNode_t*>(&node) : arena.create<PrintNode_t>(child));
+    return false;
+}
+
+bool ConstantFolder::visit(const IfNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.if_case == nullptr);
+    DEV_ASSERT(node.expr == nullptr);
+
+    if (step == 0)
+    {
+        walker.schedule(node.if_case);
+        walker.schedule(node.expr);
+        return true;
+    }
+
+    const RuleNode_t *expr = popRule();
+    const NonTerminalNode_t *if_case = popExpression().node;
+
+    if (if_case == node.if_case && expr == node.expr)
+    {
+        rules.push_back(&node);
+        return false;
+    }
+    rules.push_back(arena.create<IfNode_t>(if_case, expr));
+    return false;
+}
+
+bool ConstantFolder::visit(const IfElseNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.if_case == nullptr);
+    DEV_ASSERT(node.true_expr == nullptr);
+    DEV_ASSERT(node.false_expr == nullptr);
+
+    if (step == 0)
+    {
+        walker.schedule(node.if_case);
+        walker.schedule(node.true_expr);
+        walker.schedule(node.false_expr);
+        return true;
+    }
+
+    const RuleNode_t *false_expr = popRule();
+    const RuleNode_t *true_expr = popRule();
+    const NonTerminalNode_t *if_case = popExpression().node;
+
+    if (if_case == node.if_case && true_expr == node.true_expr && false_expr == node.false_expr)
+    {
+        rules.push_back(&node);
+        return false;
+    }
+    rules.push_back(arena.create<IfElseNode_t>(if_case, true_expr, false_expr));
+    return false;
+}
+
+bool ConstantFolder::visit(const WhileNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.condition == nullptr);
+    DEV_ASSERT(node.body == nullptr);
+
+    if (step == 0)
+    {
+        walker.schedule(node.condition);
+        walker.schedule(node.body);
+        return true;
+    }
+
+    const RuleNode_t *body = popRule();
+    const NonTerminalNode_t *condition = popExpression().node;
+
+    if (condition == node.condition && body == node.body)
+    {
+        rules.push_back(&node);
+        return false;
+    }
+    rules.push_back(arena.create<WhileNode_t>(condition, body));
+    return false;
+}
+
+bool ConstantFolder::visit(const ArrayDeclareNode_t &node, const size_t step)
+{
+    rules.push_back(&node);
+    return false;
+}
+
+bool ConstantFolder::visit(const ElementNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.index == nullptr);
+
+    if (step == 0)
+    {
+        walker.schedule(node.index);
+        return true;
+    }
+
+    // Bounds are only checked at run time, so any element read may trap.
+    const NonTerminalNode_t *index = popExpression().node;
+
+    if (index == node.index)
+    {
+        setExpression(&node, true);
+        return false;
+    }
+
+    ElementNode_t *folded = arena.create<ElementNode_t>(node.name, index);
+    folded->array = node.array;
+    setExpression(folded, true);
+    return false;
+}
+
+bool ConstantFolder::visit(const ElementAssignNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.index == nullptr);
+    DEV_ASSERT(node.value == nullptr);
+
+    if (step == 0)
+    {
+        walker.schedule(node.index);
+        walker.schedule(node.value);
+        return true;
+    }
+
+    const NonTerminalNode_t *value = popExpression().node;
+    const NonTerminalNode_t *index = popExpression().node;
+
+    if (index == node.index && value == node.value)
+    {
+        rules.push_back(&node);
+        return false;
+    }
+
+    ElementAssignNode_t *folded = arena.create<ElementAssignNode_t>(node.name, index, value);
+    folded->array = node.array;
+    rules.push_back(folded);
+    return false;
+}
+
+bool ConstantFolder::visit(const ArrayAssignNode_t &node, const size_t step)
+{
+    rules.push_back(&node);
+    return false;
+}
+
+const NonTerminalNode_t *ConstantFolder::foldExpression(const NonTerminalNode_t *expression)
+{
+    DEV_ASSERT(expression == nullptr);
+
+    walker.walk(*this, *expression);
+
+    const Folded_t folded = popExpression();
+    folded_value = folded.value;
+    return folded.node;
+}
+
+const RuleNode_t *ConstantFolder::foldRule(const RuleNode_t *rule)
+{
+    DEV_ASSERT(rule == nullptr);
+
+    walker.walk(*this, *rule);
+    return popRule();
+}
+
+void ConstantFolder::fold(ProgramNode_t &root)
+{
+    for (auto &child : root.children_vec)
+    {
+        child = foldRule(child);
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include "arena.hpp"
+#include "ast.hpp"
+#include "astWalker.hpp"
+#include "visitor.hpp"
+
+// Per-slot values known to be constant at the current program point.
+using KnownValues_t = std::vector<std::optional<AstValue_t>>;
+
+// AST-to-AST pass folding constant subexpressions and algebraic identities.
+// Nodes are never modified: a parent is rebuilt in the arena only when one
+// of its children was replaced. Expressions which may trap at run time
+// (division by zero, INT64_MIN / -1 or an index out of bounds) are never
+// dropped or folded.
+class ConstantFolder : public Visitor
+{
+private:
+    struct Folded_t
+    {
+        const NonTerminalNode_t *node;
+        std::optional<AstValue_t> value;
+        bool may_trap;
+    };
+
+    AstArena_t &arena;
+    AstWalker_t walker;
+
+    // Results of the folded children, popped by their parent.
+    std::vector<Folded_t> expressions;
+    std::vector<const RuleNode_t*> rules;
+    std::optional<AstValue_t> folded_value;
+
+    const KnownValues_t *known_values;
+    size_t folded_count;
+    size_t substituted_count;
+
+public:
+    explicit ConstantFolder(AstArena_t &arena_)
+        :
+            arena(arena_),
+            known_values(nullptr),
+            folded_count(0),
+            substituted_count(0)
+    {}
+
+    bool visit(const ProgramNode_t &node, size_t step);
+    bool visit(const VariableNode_t &node, size_t step);
+    bool visit(const ValueNode_t &node, size_t step);
+    bool visit(const AndNode_t &node, size_t step);
+    bool visit(const OrNode_t &node, size_t step);
+    bool visit(const ComparatorNode_t &node, size_t step);
+    bool visit(const ArithmeticNode_t &node, size_t step);
+    bool visit(const NotNode_t &node, size_t step);
+    bool visit(const NopRuleNode_t &node, size_t step);
+    bool visit(const AssignNode_t &node, size_t step);
+    bool visit(const DeclareNode_t &node, size_t step);
+    bool visit(const PrintNode_t &node, size_t step);
+    bool visit(const IfNode_t &node, size_t step);
+    bool visit(const IfElseNode_t &node, size_t step);
+    bool visit(const WhileNode_t &node, size_t step);
+    bool visit(const ArrayDeclareNode_t &node, size_t step);
+    bool visit(const ElementNode_t &node, size_t step);
+    bool visit(const ElementAssignNode_t &node, size_t step);
+    bool visit(const ArrayAssignNode_t &node, size_t step);
+
+    void fold(ProgramNode_t &root);
+    const NonTerminalNode_t *foldExpression(const NonTerminalNode_t *expression);
+    const RuleNode_t *foldRule(const RuleNode_t *rule);
+
+    // Reads of variables with a known constant value are replaced by it.
+    void setKnownValues(const KnownValues_t *known_values_)
+    {
+        known_values = known_values_;
+    }
+
+    // Value of the last folded expression if it became a constant.
+    std::optional<AstValue_t> foldedValue() const
+    {
+        return folded_value;
+    }
+
+    size_t foldedCount() const
+    {
+        return folded_count;
+    }
+
+    size_t substitutedCount() const
+    {
+        return substituted_count;
+    }
+
+private:
+    Folded_t popExpression();
+    const RuleNode_t *popRule();
+    void setConstant(AstValue_t value);
+    void setExpression(const NonTerminalNode_t *expression, bool may_trap);
+};
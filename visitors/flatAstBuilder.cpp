@@ -0,0 +1,318 @@
+#include <limits>
+
+#include "flatAstBuilder.hpp"
+#include "log.hpp"
+
+uint32_t FlatAstBuilder::append(const FlatTag_t tag, const uint32_t operand)
+{
+    // next of the last node has to fit as well.
+    if (flat->nodes.size() >= std::numeric_limits<uint32_t>::max())
+    {
+        USER_ABORT("Program is too large, it has more than %u nodes\n", std::numeric_limits<uint32_t>::max() - 1);
+    }
+
+    const uint32_t index = static_cast<uint32_t>(flat->nodes.size());
+    flat->nodes.push_back({tag, operand, 0});
+    return index;
+}
+
+void FlatAstBuilder::addLeaf(const FlatTag_t tag, const uint32_t operand)
+{
+    const uint32_t index = append(tag, operand);
+    flat->nodes[index].next = index + 1;
+}
+
+bool FlatAstBuilder::addInner(const FlatTag_t tag, const size_t step, const std::initializer_list<const AstNode_t*> children)
+{
+    if (step == 0)
+    {
+        open_nodes.push_back(append(tag, 0));
+        for (const auto child : children)
+        {
+            walker.schedule(child);
+        }
+        return true;
+    }
+
+    closeNode();
+    return false;
+}
+
+void FlatAstBuilder::closeNode()
+{
+    DEV_ASSERT(open_nodes.empty());
+
+    flat->nodes[open_nodes.back()].next = static_cast<uint32_t>(flat->nodes.size());
+    open_nodes.pop_back();
+}
+
+bool FlatAstBuilder::visit(const ProgramNode_t &node, const size_t step)
+{
+    if (step == 0)
+    {
+        open_nodes.push_back(append(FlatTag_t::BLOCK, 0));
+        for (const auto child : node.children_vec)
+        {
+            walker.schedule(child);
+        }
+        return true;
+    }
+
+    closeNode();
+    return false;
+}
+
+bool FlatAstBuilder::visit(const VariableNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.slot >= flat->variables_count);
+
+    addLeaf(FlatTag_t::VARIABLE, static_cast<uint32_t>(node.slot));
+    return false;
+}
+
+bool FlatAstBuilder::visit(const ValueNode_t &node, const size_t step)
+{
+    addLeaf(FlatTag_t::VALUE, static_cast<uint32_t>(flat->constants.size()));
+    flat->constants.push_back(node.value);
+    return false;
+}
+
+bool FlatAstBuilder::visit(const AndNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.left == nullptr);
+    DEV_ASSERT(node.right == nullptr);
+
+    return addInner(FlatTag_t::AND, step, {node.left, node.right});
+}
+
+bool FlatAstBuilder::visit(const OrNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.left == nullptr);
+    DEV_ASSERT(node.right == nullptr);
+
+    return addInner(FlatTag_t::OR, step, {node.left, node.right});
+}
+
+bool FlatAstBuilder::visit(const ComparatorNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.left == nullptr);
+    DEV_ASSERT(node.right == nullptr);
+
+    switch (node.oper)
+    {
+    case ComparatorOperators::LESS:
+        return addInner(FlatTag_t::LESS, step, {node.left, node.right});
+    case ComparatorOperators::LESS_OR_EQ:
+        return addInner(FlatTag_t::LESS_OR_EQ, step, {node.left, node.right});
+    case ComparatorOperators::MORE:
+        return addInner(FlatTag_t::MORE, step, {node.left, node.right});
+    case ComparatorOperators::MORE_OR_EQ:
+        return addInner(FlatTag_t::MORE_OR_EQ, step, {node.left, node.right});
+    case ComparatorOperators::EQ:
+        return addInner(FlatTag_t::EQ, step, {node.left, node.right});
+    default:
+        DEV_ASSERT(true);
+        return false;
+    }
+}
+
+bool FlatAstBuilder::visit(const ArithmeticNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.left == nullptr);
+    DEV_ASSERT(node.right == nullptr);
+
+    switch (node.oper)
+    {
+    case ArithmeticOperators::ADD:
+        return addInner(FlatTag_t::ADD, step, {node.left, node.right});
+    case ArithmeticOperators::SUB:
+        return addInner(FlatTag_t::SUB, step, {node.left, node.right});
+    case ArithmeticOperators::MUL:
+        return addInner(FlatTag_t::MUL, step, {node.left, node.right});
+    case ArithmeticOperators::DIV:
+        return addInner(FlatTag_t::DIV, step, {node.left, node.right});
+    default:
+        DEV_ASSERT(true);
+        return false;
+    }
+}
+
+bool FlatAstBuilder::visit(const NotNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.child == nullptr);
+
+    return addInner(FlatTag_t::NOT, step, {node.child});
+}
+
+bool FlatAstBuilder::visit(const NopRuleNode_t &node, const size_t step)
+{
+    if (step == 0)
+    {
+        open_nodes.push_back(append(FlatTag_t::BLOCK, 0));
+        for (const auto child : node.children_vec)
+        {
+            walker.schedule(child);
+        }
+        return true;
+    }
+
+    closeNode();
+    return false;
+}
+
+bool FlatAstBuilder::visit(const AssignNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.value == nullptr);
+    DEV_ASSERT(node.slot >= flat->variables_count);
+
+    if (step == 0)
+    {
+        open_nodes.push_back(append(FlatTag_t::ASSIGN, static_cast<uint32_t>(node.slot)));
+        walker.schedule(node.value);
+        return true;
+    }
+
+    closeNode();
+    return false;
+}
+
+bool FlatAstBuilder::visit(const DeclareNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.slot >= flat->variables_count);
+
+    if (flat->names.size() <= node.slot)
+    {
+        flat->names.resize(node.slot + 1);
+    }
+    flat->names[node.slot] = node.name;
+
+    addLeaf(FlatTag_t::DECLARE, static_cast<uint32_t>(node.slot));
+    return false;
+}
+
+bool FlatAstBuilder::visit(const PrintNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.child == nullptr);
+
+    return addInner(FlatTag_t::PRINT, step, {node.child});
+}
+
+bool FlatAstBuilder::visit(const IfNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.if_case == nullptr);
+    DEV_ASSERT(node.expr == nullptr);
+
+    return addInner(FlatTag_t::IF, step, {node.if_case, node.expr});
+}
+
+bool FlatAstBuilder::visit(const IfElseNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.if_case == nullptr);
+    DEV_ASSERT(node.true_expr == nullptr);
+    DEV_ASSERT(node.false_expr == nullptr);
+
+    return addInner(FlatTag_t::IF_ELSE, step, {node.if_case, node.true_expr, node.false_expr});
+}
+
+bool FlatAstBuilder::visit(const WhileNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.condition == nullptr);
+    DEV_ASSERT(node.body == nullptr);
+
+    return addInner(FlatTag_t::WHILE, step, {node.condition, node.body});
+}
+
+bool FlatAstBuilder::visit(const ArrayDeclareNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.array >= flat->arrays.size());
+
+    const VariableSlot_t slot = flat->arrays[node.array].slot;
+    if (flat->names.size() <= slot)
+    {
+        flat->names.resize(slot + 1);
+    }
+    flat->names[slot] = node.name;
+
+    addLeaf(FlatTag_t::DECLARE_ARRAY, static_cast<uint32_t>(node.array));
+    return false;
+}
+
+bool FlatAstBuilder::visit(const ElementNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.index == nullptr);
+    DEV_ASSERT(node.array >= flat->arrays.size());
+
+    if (step == 0)
+    {
+        open_nodes.push_back(append(FlatTag_t::ELEMENT, static_cast<uint32_t>(node.array)));
+        walker.schedule(node.index);
+        return true;
+    }
+
+    closeNode();
+    return false;
+}
+
+bool FlatAstBuilder::visit(const ElementAssignNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.index == nullptr);
+    DEV_ASSERT(node.value == nullptr);
+    DEV_ASSERT(node.array >= flat->arrays.size());
+
+    if (step == 0)
+    {
+        open_nodes.push_back(append(FlatTag_t::ASSIGN_ELEMENT, static_cast<uint32_t>(node.array)));
+        walker.schedule(node.index);
+        walker.schedule(node.value);
+        return true;
+    }
+
+    closeNode();
+    return false;
+}
+
+bool FlatAstBuilder::visit(const ArrayAssignNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.array >= flat->arrays.size());
+    DEV_ASSERT(node.left >= flat->arrays.size());
+    DEV_ASSERT(node.right >= flat->arrays.size());
+
+    // ArrayOperators follow ADD..EQ in the same order.
+    const FlatTag_t oper = static_cast<FlatTag_t>(static_cast<int>(FlatTag_t::ADD) + static_cast<int>(node.oper));
+
+    open_nodes.push_back(append(FlatTag_t::ASSIGN_ARRAY, static_cast<uint32_t>(node.array)));
+    open_nodes.push_back(append(oper, 0));
+    addLeaf(FlatTag_t::ARRAY, static_cast<uint32_t>(node.left));
+    addLeaf(FlatTag_t::ARRAY, static_cast<uint32_t>(node.right));
+    closeNode();
+    closeNode();
+    return false;
+}
+
+void FlatAstBuilder::build(FlatAst_t &output, const ProgramNode_t &root)
+{
+    flat = &output;
+    flat->clear();
+    flat->variables_count = root.variables_count;
+    flat->arrays = root.arrays;
+
+    walker.walk(*this, root);
+
+    DEV_ASSERT(!open_nodes.empty());
+    flat = nullptr;
+}
+
+void FlatAstBuilder::buildStatement(FlatAst_t &output, const ProgramNode_t &program, const RuleNode_t &statement)
+{
+    flat = &output;
+    flat->clear();
+    flat->variables_count = program.variables_count;
+    flat->arrays = program.arrays;
+
+    open_nodes.push_back(append(FlatTag_t::BLOCK, 0));
+    walker.walk(*this, statement);
+    closeNode();
+
+    DEV_ASSERT(!open_nodes.empty());
+    flat = nullptr;
+}
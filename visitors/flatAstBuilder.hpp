@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+#include "ast.hpp"
+#include "astWalker.hpp"
+#include "flatAst.hpp"
+#include "visitor.hpp"
+
+// Lowers a resolved AST to FlatAst_t. Nodes are appended in pre-order and
+// get their next index once their whole subtree is written.
+class FlatAstBuilder : public Visitor
+{
+private:
+    FlatAst_t *flat;
+    // Nodes whose subtree is still being written.
+    std::vector<uint32_t> open_nodes;
+    AstWalker_t walker;
+
+public:
+    explicit FlatAstBuilder()
+        :
+            flat(nullptr)
+    {}
+
+    bool visit(const ProgramNode_t &node, size_t step);
+    bool visit(const VariableNode_t &node, size_t step);
+    bool visit(const ValueNode_t &node, size_t step);
+    bool visit(const AndNode_t &node, size_t step);
+    bool visit(const OrNode_t &node, size_t step);
+    bool visit(const ComparatorNode_t &node, size_t step);
+    bool visit(const ArithmeticNode_t &node, size_t step);
+    bool visit(const NotNode_t &node, size_t step);
+    bool visit(const NopRuleNode_t &node, size_t step);
+    bool visit(const AssignNode_t &node, size_t step);
+    bool visit(const DeclareNode_t &node, size_t step);
+    bool visit(const PrintNode_t &node, size_t step);
+    bool visit(const IfNode_t &node, size_t step);
+    bool visit(const IfElseNode_t &node, size_t step);
+    bool visit(const WhileNode_t &node, size_t step);
+    bool visit(const ArrayDeclareNode_t &node, size_t step);
+    bool visit(const ElementNode_t &node, size_t step);
+    bool visit(const ElementAssignNode_t &node, size_t step);
+    bool visit(const ArrayAssignNode_t &node, size_t step);
+
+    void build(FlatAst_t &output, const ProgramNode_t &root);
+    // Lowers one statement of a program that is still being parsed, the
+    // statement becomes the only child of node 0.
+    void buildStatement(FlatAst_t &output, const ProgramNode_t &program, const RuleNode_t &statement);
+
+private:
+    uint32_t append(FlatTag_t tag, uint32_t operand);
+    void addLeaf(FlatTag_t tag, uint32_t operand);
+    bool addInner(FlatTag_t tag, size_t step, std::initializer_list<const AstNode_t*> children);
+    void closeNode();
+};
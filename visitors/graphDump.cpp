@@ -1,38 +1,47 @@
+#include <cstdlib>
+
 #include"graphDump.hpp"
 #include "log.hpp"
 
-void GraphDumper::visit(const ProgramNode_t &node)
+bool GraphDumper::visit(const ProgramNode_t &node, const size_t step)
 {
-    fprintf(
-        dot_file, 
-        "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
-        &node
-    );
-    fprintf(dot_file, "PROGRAM_ENTRY");
-    fprintf(dot_file, "}\"];\n");
-
-    for (const auto child : node.children_vec)
+    if (step == 0)
     {
-        child->accept(*this);
+        fprintf(
+            dot_file, 
+            "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
+            &node
+        );
+        fprintf(dot_file, "PROGRAM_ENTRY");
+        fprintf(dot_file, "}\"];\n");
+
+        for (const auto child : node.children_vec)
+        {
+            walker.schedule(child);
+        }
+        return true;
     }
+
     for (const auto child : node.children_vec)
     {
         fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, child);
     }
+    return false;
 }
 
-void GraphDumper::visit(const VariableNode_t &node)
+bool GraphDumper::visit(const VariableNode_t &node, const size_t step)
 {
     fprintf(
         dot_file, 
         "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
         &node
     );
-    fprintf(dot_file, "VARIABLE %s", node.name.c_str());
+    fprintf(dot_file, "VARIABLE %s", node.name.data());
     fprintf(dot_file, "}\"];\n");
+    return false;
 }
 
-void GraphDumper::visit(const ValueNode_t &node)
+bool GraphDumper::visit(const ValueNode_t &node, const size_t step)
 {
     fprintf(
         dot_file, 
@@ -41,239 +50,404 @@ void GraphDumper::visit(const ValueNode_t &node)
     );
     fprintf(dot_file, "VALUE %ld", node.value);
     fprintf(dot_file, "}\"];\n");
+    return false;
 }
 
-void GraphDumper::visit(const AndNode_t &node)
+bool GraphDumper::visit(const AndNode_t &node, const size_t step)
 {
     DEV_ASSERT(node.left == nullptr);
     DEV_ASSERT(node.right == nullptr);
 
-    fprintf(
-        dot_file, 
-        "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
-        &node
-    );
-    fprintf(dot_file, "AND");
-    fprintf(dot_file, "}\"];\n");
-
-    node.left->accept(*this);
-    node.right->accept(*this);
+    if (step == 0)
+    {
+        fprintf(
+            dot_file, 
+            "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
+            &node
+        );
+        fprintf(dot_file, "AND");
+        fprintf(dot_file, "}\"];\n");
+
+        walker.schedule(node.left);
+        walker.schedule(node.right);
+        return true;
+    }
 
     fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.left);
     fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.right);
+    return false;
 }
 
-void GraphDumper::visit(const OrNode_t &node)
+bool GraphDumper::visit(const OrNode_t &node, const size_t step)
 {
     DEV_ASSERT(node.left == nullptr);
     DEV_ASSERT(node.right == nullptr);
 
-    fprintf(
-        dot_file, 
-        "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
-        &node
-    );
-    fprintf(dot_file, "OR");
-    fprintf(dot_file, "}\"];\n");
-
-    node.left->accept(*this);
-    node.right->accept(*this);
+    if (step == 0)
+    {
+        fprintf(
+            dot_file, 
+            "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
+            &node
+        );
+        fprintf(dot_file, "OR");
+        fprintf(dot_file, "}\"];\n");
+
+        walker.schedule(node.left);
+        walker.schedule(node.right);
+        return true;
+    }
 
     fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.left);
     fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.right);
+    return false;
 }
 
-void GraphDumper::visit(const ComparatorNode_t &node)
+bool GraphDumper::visit(const ComparatorNode_t &node, const size_t step)
 {
     DEV_ASSERT(node.left == nullptr);
     DEV_ASSERT(node.right == nullptr);
 
-    fprintf(
-        dot_file, 
-        "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
-        &node
-    );
-    fprintf(dot_file, "COMPARE %d", (int)node.oper);
-    fprintf(dot_file, "}\"];\n");
-
-    node.left->accept(*this);
-    node.right->accept(*this);
+    if (step == 0)
+    {
+        fprintf(
+            dot_file, 
+            "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
+            &node
+        );
+        fprintf(dot_file, "COMPARE %d", (int)node.oper);
+        fprintf(dot_file, "}\"];\n");
+
+        walker.schedule(node.left);
+        walker.schedule(node.right);
+        return true;
+    }
 
     fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.left);
     fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.right);
+    return false;
 }
 
-void GraphDumper::visit(const ArithmeticNode_t &node)
+bool GraphDumper::visit(const ArithmeticNode_t &node, const size_t step)
 {
     DEV_ASSERT(node.left == nullptr);
     DEV_ASSERT(node.right == nullptr);
 
-    fprintf(
-        dot_file, 
-        "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
-        &node
-    );
-    fprintf(dot_file, "ARITHMETICS %d", (int)node.oper);
-    fprintf(dot_file, "}\"];\n");
-
-    node.left->accept(*this);
-    node.right->accept(*this);
+    if (step == 0)
+    {
+        fprintf(
+            dot_file, 
+            "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
+            &node
+        );
+        fprintf(dot_file, "ARITHMETICS %d", (int)node.oper);
+        fprintf(dot_file, "}\"];\n");
+
+        walker.schedule(node.left);
+        walker.schedule(node.right);
+        return true;
+    }
 
     fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.left);
     fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.right);
+    return false;
 }
 
-void GraphDumper::visit(const NotNode_t &node)
+bool GraphDumper::visit(const NotNode_t &node, const size_t step)
 {
     DEV_ASSERT(node.child == nullptr);
 
-    fprintf(
-        dot_file, 
-        "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
-        &node
-    );
-    fprintf(dot_file, "NOT");
-    fprintf(dot_file, "}\"];\n");
-
-    node.child->accept(*this);
+    if (step == 0)
+    {
+        fprintf(
+            dot_file, 
+            "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
+            &node
+        );
+        fprintf(dot_file, "NOT");
+        fprintf(dot_file, "}\"];\n");
+
+        walker.schedule(node.child);
+        return true;
+    }
 
     fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.child);
+    return false;
 }
 
-void GraphDumper::visit(const NopRuleNode_t &node)
+bool GraphDumper::visit(const NopRuleNode_t &node, const size_t step)
 {
-    fprintf(
-        dot_file, 
-        "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
-        &node
-    );
-    fprintf(dot_file, "NOP");
-    fprintf(dot_file, "}\"];\n");
-
-    for (const auto child : node.children_vec)
+    if (step == 0)
     {
-        child->accept(*this);
+        fprintf(
+            dot_file, 
+            "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
+            &node
+        );
+        fprintf(dot_file, "NOP");
+        fprintf(dot_file, "}\"];\n");
+
+        for (const auto child : node.children_vec)
+        {
+            walker.schedule(child);
+        }
+        return true;
     }
+
     for (const auto child : node.children_vec)
     {
         fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, child);
     }
+    return false;
 }
 
-void GraphDumper::visit(const AssignNode_t &node)
+bool GraphDumper::visit(const AssignNode_t &node, const size_t step)
 {
     DEV_ASSERT(node.value == nullptr);
 
-    fprintf(
-        dot_file, 
-        "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
-        &node
-    );
-    fprintf(dot_file, "ASSIGN %s", node.name.c_str());
-    fprintf(dot_file, "}\"];\n");
-
-    node.value->accept(*this);
+    if (step == 0)
+    {
+        fprintf(
+            dot_file, 
+            "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
+            &node
+        );
+        fprintf(dot_file, "ASSIGN %s", node.name.data());
+        fprintf(dot_file, "}\"];\n");
+
+        walker.schedule(node.value);
+        return true;
+    }
 
     fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.value);
+    return false;
 }
 
-void GraphDumper::visit(const DeclareNode_t &node)
+bool GraphDumper::visit(const DeclareNode_t &node, const size_t step)
 {
     fprintf(
         dot_file, 
         "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
         &node
     );
-    fprintf(dot_file, "DECLARE %s", node.name.c_str());
+    fprintf(dot_file, "DECLARE %s", node.name.data());
     fprintf(dot_file, "}\"];\n");
+    return false;
 }
 
-void GraphDumper::visit(const PrintNode_t &node)
+bool GraphDumper::visit(const PrintNode_t &node, const size_t step)
 {
     DEV_ASSERT(node.child == nullptr);
 
-    fprintf(
-        dot_file, 
-        "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
-        &node
-    );
-    fprintf(dot_file, "PRINT");
-    fprintf(dot_file, "}\"];\n");
-
-    node.child->accept(*this);
+    if (step == 0)
+    {
+        fprintf(
+            dot_file, 
+            "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
+            &node
+        );
+        fprintf(dot_file, "PRINT");
+        fprintf(dot_file, "}\"];\n");
+
+        walker.schedule(node.child);
+        return true;
+    }
 
     fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.child);
+    return false;
 }
 
-void GraphDumper::visit(const IfNode_t &node)
+bool GraphDumper::visit(const IfNode_t &node, const size_t step)
 {
     DEV_ASSERT(node.if_case == nullptr);
     DEV_ASSERT(node.expr == nullptr);
 
-    fprintf(
-        dot_file, 
-        "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
-        &node
-    );
-    fprintf(dot_file, "IF");
-    fprintf(dot_file, "}\"];\n");
-
-    node.if_case->accept(*this);
-    node.expr->accept(*this);
+    if (step == 0)
+    {
+        fprintf(
+            dot_file, 
+            "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
+            &node
+        );
+        fprintf(dot_file, "IF");
+        fprintf(dot_file, "}\"];\n");
+
+        walker.schedule(node.if_case);
+        walker.schedule(node.expr);
+        return true;
+    }
 
     fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.if_case);
     fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.expr);
+    return false;
 }
 
-void GraphDumper::visit(const IfElseNode_t &node)
+bool GraphDumper::visit(const IfElseNode_t &node, const size_t step)
 {
     DEV_ASSERT(node.if_case == nullptr);
     DEV_ASSERT(node.true_expr == nullptr);
     DEV_ASSERT(node.false_expr == nullptr);
 
+    if (step == 0)
+    {
+        fprintf(
+            dot_file, 
+            "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
+            &node
+        );
+        fprintf(dot_file, "IF + ELSE");
+        fprintf(dot_file, "}\"];\n");
+
+        walker.schedule(node.if_case);
+        walker.schedule(node.true_expr);
+        walker.schedule(node.false_expr);
+        return true;
+    }
+
+    fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.if_case);
+    fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.true_expr);
+    fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.false_expr);
+    return false;
+}
+
+bool GraphDumper::visit(const WhileNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.condition == nullptr);
+    DEV_ASSERT(node.body == nullptr);
+
+    if (step == 0)
+    {
+        fprintf(
+            dot_file, 
+            "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
+            &node
+        );
+        fprintf(dot_file, "WHILE");
+        fprintf(dot_file, "}\"];\n");
+
+        walker.schedule(node.condition);
+        walker.schedule(node.body);
+        return true;
+    }
+
+    fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.condition);
+    fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.body);
+    return false;
+}
+
+bool GraphDumper::visit(const ArrayDeclareNode_t &node, const size_t step)
+{
     fprintf(
         dot_file, 
         "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
         &node
     );
-    fprintf(dot_file, "IF + ELSE");
+    fprintf(dot_file, "DECLARE %s[%ld]", node.name.data(), node.size);
     fprintf(dot_file, "}\"];\n");
+    return false;
+}
+
+bool GraphDumper::visit(const ElementNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.index == nullptr);
 
-    node.if_case->accept(*this);
-    node.true_expr->accept(*this);
-    node.false_expr->accept(*this);
+    if (step == 0)
+    {
+        fprintf(
+            dot_file, 
+            "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
+            &node
+        );
+        fprintf(dot_file, "ELEMENT %s", node.name.data());
+        fprintf(dot_file, "}\"];\n");
+
+        walker.schedule(node.index);
+        return true;
+    }
 
-    fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.if_case);
-    fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.true_expr);
-    fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.false_expr);
+    fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.index);
+    return false;
 }
 
-void GraphDumper::createGraph(const char *image_name, const ProgramNode_t &root)
+bool GraphDumper::visit(const ElementAssignNode_t &node, const size_t step)
 {
-    dot_file = fopen("temp.dot", "w");
-    if (!dot_file) 
+    DEV_ASSERT(node.index == nullptr);
+    DEV_ASSERT(node.value == nullptr);
+
+    if (step == 0)
     {
-        DEV_DBG_ERR("failed to create .dot file!\n");
-        return;
+        fprintf(
+            dot_file, 
+            "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
+            &node
+        );
+        fprintf(dot_file, "ASSIGN ELEMENT %s", node.name.data());
+        fprintf(dot_file, "}\"];\n");
+
+        walker.schedule(node.index);
+        walker.schedule(node.value);
+        return true;
     }
 
+    fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.index);
+    fprintf(dot_file, "\tlabel%p->label%p [color=\"red\", style=\"dashed\",arrowhead=\"none\"]", &node, node.value);
+    return false;
+}
+
+bool GraphDumper::visit(const ArrayAssignNode_t &node, const size_t step)
+{
+    fprintf(
+        dot_file, 
+        "\tlabel%p[shape=record, style=\"rounded, filled\", fillcolor=red, label=\"{val: ",
+        &node
+    );
+    fprintf(
+        dot_file, "ASSIGN ARRAY %s = %s OPER %d %s",
+        node.name.data(), node.left_name.data(), (int)node.oper, node.right_name.data()
+    );
+    fprintf(dot_file, "}\"];\n");
+    return false;
+}
+
+void GraphDumper::writeDot(FILE *file, const ProgramNode_t &root)
+{
+    DEV_ASSERT(file == nullptr);
+
+    dot_file = file;
     fprintf(dot_file, "digraph tree {\n");
     fprintf(dot_file, "\trankdir=HR;\n");
 
-    root.accept(*this);
+    walker.walk(*this, root);
 
     fprintf(dot_file, "}");
-    fclose(dot_file);
+    dot_file = nullptr;
+}
+
+void GraphDumper::createGraph(const char *image_name, const ProgramNode_t &root)
+{
+    // Unique name, so that concurrent dumps do not overwrite each other.
+    char dot_name[] = "/tmp/ast_XXXXXX.dot";
+    const int dot_fd = mkstemps(dot_name, 4);
+    FILE *file = dot_fd < 0 ? nullptr : fdopen(dot_fd, "w");
+    if (!file) 
+    {
+        DEV_DBG_ERR("failed to create .dot file!\n");
+        return;
+    }
+
+    writeDot(file, root);
+    fclose(file);
 
     char command[1024] = {0};
     snprintf(
         command, 
         sizeof(command), 
-        "dot -Tsvg temp.dot > %s && xdg-open %s", 
+        "dot -Tsvg %s > %s && xdg-open %s", 
+        dot_name,
         image_name, 
         image_name
     );
 
     system(command);
-    system("rm temp.dot");
+    remove(dot_name);
 }
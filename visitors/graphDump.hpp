@@ -3,12 +3,14 @@
 #include <cstdio>
 
 #include "ast.hpp"
+#include "astWalker.hpp"
 #include "visitor.hpp"
 
 class GraphDumper : public Visitor
 {
 private:
     FILE *dot_file;
+    AstWalker_t walker;
 
 public:
     explicit GraphDumper()
@@ -16,20 +18,27 @@ public:
             dot_file(nullptr)
     {}
 
-    void visit(const ProgramNode_t &node) override;
-    void visit(const VariableNode_t &node) override;
-    void visit(const ValueNode_t &node) override;
-    void visit(const AndNode_t &node) override;
-    void visit(const OrNode_t &node) override;
-    void visit(const ComparatorNode_t &node) override;
-    void visit(const ArithmeticNode_t &node) override;
-    void visit(const NotNode_t &node) override;
-    void visit(const NopRuleNode_t &node) override;
-    void visit(const AssignNode_t &node) override;
-    void visit(const DeclareNode_t &node) override;
-    void visit(const PrintNode_t &node) override;
-    void visit(const IfNode_t &node) override;
-    void visit(const IfElseNode_t &node) override;
+    bool visit(const ProgramNode_t &node, size_t step);
+    bool visit(const VariableNode_t &node, size_t step);
+    bool visit(const ValueNode_t &node, size_t step);
+    bool visit(const AndNode_t &node, size_t step);
+    bool visit(const OrNode_t &node, size_t step);
+    bool visit(const ComparatorNode_t &node, size_t step);
+    bool visit(const ArithmeticNode_t &node, size_t step);
+    bool visit(const NotNode_t &node, size_t step);
+    bool visit(const NopRuleNode_t &node, size_t step);
+    bool visit(const AssignNode_t &node, size_t step);
+    bool visit(const DeclareNode_t &node, size_t step);
+    bool visit(const PrintNode_t &node, size_t step);
+    bool visit(const IfNode_t &node, size_t step);
+    bool visit(const IfElseNode_t &node, size_t step);
+    bool visit(const WhileNode_t &node, size_t step);
+    bool visit(const ArrayDeclareNode_t &node, size_t step);
+    bool visit(const ElementNode_t &node, size_t step);
+    bool visit(const ElementAssignNode_t &node, size_t step);
+    bool visit(const ArrayAssignNode_t &node, size_t step);
 
+    // Writes the AST in dot format, without rendering it.
+    void writeDot(FILE *file, const ProgramNode_t &root);
     void createGraph(const char *image_name, const ProgramNode_t &root);
 };
@@ -1,199 +1,384 @@
+#include <algorithm>
+
+#include "arrayKernels.hpp"
 #include "interpreter.hpp"
 #include "log.hpp"
 
-void Interpreter::visit(const ProgramNode_t &node)
+// The operator is a template argument, so every quickened form gets its own
+// code with no switch on the operator left in it.
+template<FlatTag_t Oper>
+static inline AstValue_t applyBinary(const AstValue_t left, const AstValue_t right)
 {
-    for (const auto child : node.children_vec)
+    if constexpr (Oper == FlatTag_t::ADD)
     {
-        child->accept(*this);
+        return left + right;
     }
-}
-
-void Interpreter::visit(const VariableNode_t &node)
-{
-    if (variables.count(node.name) != 0)
+    else if constexpr (Oper == FlatTag_t::SUB)
+    {
+        return left - right;
+    }
+    else if constexpr (Oper == FlatTag_t::MUL)
+    {
+        return left * right;
+    }
+    else if constexpr (Oper == FlatTag_t::DIV)
+    {
+        return left / right;
+    }
+    else if constexpr (Oper == FlatTag_t::LESS)
+    {
+        return left < right;
+    }
+    else if constexpr (Oper == FlatTag_t::LESS_OR_EQ)
     {
-        shared_value = variables[node.name];
+        return left <= right;
+    }
+    else if constexpr (Oper == FlatTag_t::MORE)
+    {
+        return left > right;
+    }
+    else if constexpr (Oper == FlatTag_t::MORE_OR_EQ)
+    {
+        return left >= right;
+    }
+    else if constexpr (Oper == FlatTag_t::EQ)
+    {
+        return left == right;
     }
     else
     {
-        USER_ABORT("Variable (%s) was not created!\n", node.name.c_str());
+        static_assert(Oper == FlatTag_t::ADD, "Not a binary operator");
     }
 }
 
-void Interpreter::visit(const ValueNode_t &node)
+// Rewrites an arithmetic or comparison operator whose first operand is a
+// variable and the second a literal or a variable into its quickened form.
+// Both operands are leaves, so they are the next two nodes.
+static bool quicken(FlatNode_t *const nodes, const uint32_t index)
 {
-    shared_value = node.value;
-}
-
-void Interpreter::visit(const AndNode_t &node)
-{
-    DEV_ASSERT(node.left == nullptr);
-    DEV_ASSERT(node.right == nullptr);
-
-    node.left->accept(*this);
-    const AstValue_t left_val = shared_value;
-
-    node.right->accept(*this);
-    const AstValue_t right_val = shared_value;
-
-    shared_value = left_val && right_val;
-}
-
-void Interpreter::visit(const OrNode_t &node)
-{
-    DEV_ASSERT(node.left == nullptr);
-    DEV_ASSERT(node.right == nullptr);
-
-    node.left->accept(*this);
-    const AstValue_t left_val = shared_value;
-
-    node.right->accept(*this);
-    const AstValue_t right_val = shared_value;
+    FlatNode_t &node = nodes[index];
+    if (node.tag < FlatTag_t::ADD || node.tag > FlatTag_t::EQ || nodes[index + 1].tag != FlatTag_t::VARIABLE)
+    {
+        return false;
+    }
 
-    shared_value = left_val || right_val;
+    const FlatNode_t &right = nodes[index + 2];
+    const int offset = static_cast<int>(node.tag) - static_cast<int>(FlatTag_t::ADD);
+    if (right.tag == FlatTag_t::VALUE)
+    {
+        node.tag = static_cast<FlatTag_t>(static_cast<int>(FlatTag_t::ADD_VAR_CONST) + offset);
+        return true;
+    }
+    if (right.tag == FlatTag_t::VARIABLE)
+    {
+        node.tag = static_cast<FlatTag_t>(static_cast<int>(FlatTag_t::ADD_VAR_VAR) + offset);
+        return true;
+    }
+    return false;
 }
 
-void Interpreter::visit(const ComparatorNode_t &node)
+VariableSlot_t Interpreter::elementSlot(const FlatAst_t &program, const uint32_t array, const AstValue_t index)
 {
-    DEV_ASSERT(node.left == nullptr);
-    DEV_ASSERT(node.right == nullptr);
-
-    node.left->accept(*this);
-    const AstValue_t value1 = shared_value;
-
-    node.right->accept(*this);
-    const AstValue_t value2 = shared_value;
+    DEV_ASSERT(array >= program.arrays.size());
 
-    switch (node.oper)
+    const AstArray_t &info = program.arrays[array];
+    if (index < 0 || static_cast<size_t>(index) >= info.size)
     {
-    case ComparatorOperators::LESS:
-        shared_value = value1 < value2;
-        break;
-    case ComparatorOperators::LESS_OR_EQ:
-        shared_value = value1 <= value2;
-        break;
-    case ComparatorOperators::MORE:
-        shared_value = value1 > value2;
-        break;
-    case ComparatorOperators::MORE_OR_EQ:
-        shared_value = value1 >= value2;
-        break;
-    case ComparatorOperators::EQ:
-        shared_value = value1 == value2;
-        break;
-    default:
-        DEV_ASSERT(true);
-        break;
+        // What the program printed before the bad access must not be lost.
+        output.flush();
+        USER_ABORT("Index %lld is out of bounds of an array of size %zu\n", static_cast<long long>(index), info.size);
     }
+    return info.slot + static_cast<size_t>(index);
 }
 
-void Interpreter::visit(const ArithmeticNode_t &node)
+void Interpreter::interpret(FlatAst_t &program)
 {
-    DEV_ASSERT(node.left == nullptr);
-    DEV_ASSERT(node.right == nullptr);
+    variables.assign(program.variables_count, 0);
 
-    node.left->accept(*this);
-    const AstValue_t value1 = shared_value;
-
-    node.right->accept(*this);
-    const AstValue_t value2 = shared_value;
-
-    switch (node.oper)
-    {
-    case ArithmeticOperators::ADD:
-        shared_value = value1 + value2;
-        break;
-    case ArithmeticOperators::SUB:
-        shared_value = value1 - value2;
-        break;
-    case ArithmeticOperators::MUL:
-        shared_value = value1 * value2;
-        break;
-    case ArithmeticOperators::DIV:
-        shared_value = value1 / value2;
-        break;
-    default:
-        DEV_ASSERT(true);
-        break;
-    }
+    execute(program);
+    output.flush();
 }
 
-void Interpreter::visit(const NotNode_t &node)
+void Interpreter::executeStatement(FlatAst_t &statement)
 {
-    DEV_ASSERT(node.child == nullptr);
+    // New declarations only ever append slots, existing values are kept.
+    variables.resize(statement.variables_count, 0);
 
-    node.child->accept(*this);
-    shared_value = !shared_value;
+    execute(statement);
 }
 
-void Interpreter::visit(const NopRuleNode_t &node)
+void Interpreter::flushOutput()
 {
-    for (const auto child : node.children_vec)
-    {
-        child->accept(*this);
-    }
+    output.flush();
 }
 
-void Interpreter::visit(const AssignNode_t &node)
+void Interpreter::execute(FlatAst_t &program)
 {
-    DEV_ASSERT(node.value == nullptr);
+    DEV_ASSERT(program.nodes.empty());
 
-    node.value->accept(*this);
-    const AstValue_t value = shared_value;
+    const FlatNode_t *const nodes = program.nodes.data();
+    const uint32_t end = nodes[0].next;
+    uint32_t index = 0;
 
-    if (variables.count(node.name) != 0)
-    {
-        variables[node.name] = value;
-    }
-    else
+    for (;;)
     {
-        USER_ABORT("Variable (%s) was not created!\n", node.name.c_str());
+        while (!jumps.empty() && jumps.back().at == index)
+        {
+            index = jumps.back().to;
+            jumps.pop_back();
+        }
+        if (index >= end)
+        {
+            break;
+        }
+
+        const FlatNode_t &node = nodes[index];
+        switch (node.tag)
+        {
+        case FlatTag_t::BLOCK:
+            ++index;
+            break;
+        case FlatTag_t::DECLARE:
+            DEV_ASSERT(node.operand >= variables.size());
+
+            variables[node.operand] = 0;
+            index = node.next;
+            break;
+        case FlatTag_t::ASSIGN:
+            DEV_ASSERT(node.operand >= variables.size());
+
+            variables[node.operand] = evaluate(program, index + 1);
+            index = node.next;
+            break;
+        case FlatTag_t::PRINT:
+            output.printInt(evaluate(program, index + 1));
+            index = node.next;
+            break;
+        case FlatTag_t::IF:
+            {
+                // The body ends where the if does, execution simply goes on after it.
+                const uint32_t body = nodes[index + 1].next;
+                index = evaluate(program, index + 1) ? body : node.next;
+                break;
+            }
+        case FlatTag_t::IF_ELSE:
+            {
+                const uint32_t true_body = nodes[index + 1].next;
+                const uint32_t false_body = nodes[true_body].next;
+                if (evaluate(program, index + 1))
+                {
+                    jumps.push_back({false_body, node.next});
+                    index = true_body;
+                }
+                else
+                {
+                    index = false_body;
+                }
+                break;
+            }
+        case FlatTag_t::WHILE:
+            {
+                const uint32_t body = nodes[index + 1].next;
+                if (evaluate(program, index + 1))
+                {
+                    jumps.push_back({node.next, index});
+                    index = body;
+                }
+                else
+                {
+                    index = node.next;
+                }
+                break;
+            }
+        case FlatTag_t::DECLARE_ARRAY:
+            {
+                DEV_ASSERT(node.operand >= program.arrays.size());
+
+                const AstArray_t &array = program.arrays[node.operand];
+                std::fill_n(variables.begin() + array.slot, array.size, 0);
+                index = node.next;
+                break;
+            }
+        case FlatTag_t::ASSIGN_ELEMENT:
+            {
+                const AstValue_t element = evaluate(program, index + 1);
+                const AstValue_t value = evaluate(program, nodes[index + 1].next);
+                variables[elementSlot(program, node.operand, element)] = value;
+                index = node.next;
+                break;
+            }
+        case FlatTag_t::ASSIGN_ARRAY:
+            {
+                // The operator and both its ARRAY leaves follow the node.
+                const FlatTag_t oper = nodes[index + 1].tag;
+                DEV_ASSERT(oper < FlatTag_t::ADD || oper > FlatTag_t::EQ);
+
+                AstValue_t *const elements = variables.data();
+                applyArrayOperator(
+                    static_cast<ArrayOperator_t>(static_cast<int>(oper) - static_cast<int>(FlatTag_t::ADD)),
+                    elements + program.arrays[node.operand].slot,
+                    elements + program.arrays[nodes[index + 2].operand].slot,
+                    elements + program.arrays[nodes[index + 3].operand].slot,
+                    program.arrays[node.operand].size
+                );
+                index = node.next;
+                break;
+            }
+        default:
+            DEV_ASSERT(true);
+            break;
+        }
     }
-}
 
-void Interpreter::visit(const DeclareNode_t &node)
-{
-    variables[node.name] = 0;
+    DEV_ASSERT(!jumps.empty());
 }
 
-void Interpreter::visit(const PrintNode_t &node)
-{
-    DEV_ASSERT(node.child == nullptr);
-
-    node.child->accept(*this);
-    printf("%ld\n", shared_value);
-}
+// A quickened operator reads its operands right from the variables and the
+// constants, skipping both leaves and the operand stacks.
+#define QUICKENED_CASES(OPER)                                                   \
+    case FlatTag_t::OPER##_VAR_CONST:                                           \
+        values.push_back(applyBinary<FlatTag_t::OPER>(                          \
+            variables[nodes[index + 1].operand], constants[nodes[index + 2].operand])); \
+        index += 2;                                                             \
+        break;                                                                  \
+    case FlatTag_t::OPER##_VAR_VAR:                                             \
+        values.push_back(applyBinary<FlatTag_t::OPER>(                          \
+            variables[nodes[index + 1].operand], variables[nodes[index + 2].operand])); \
+        index += 2;                                                             \
+        break;
 
-void Interpreter::visit(const IfNode_t &node)
+// Operators are remembered when reached and applied once the leaf closing
+// their subtree has been evaluated, every node is read at most once.
+AstValue_t Interpreter::evaluate(FlatAst_t &program, const uint32_t first)
 {
-    DEV_ASSERT(node.if_case == nullptr);
-    DEV_ASSERT(node.expr == nullptr);
+    FlatNode_t *const nodes = program.nodes.data();
+    const AstValue_t *const constants = program.constants.data();
+    const uint32_t end = nodes[first].next;
 
-    node.if_case->accept(*this);
-    const AstValue_t if_case = shared_value;
-
-    if (if_case)
+    for (uint32_t index = first; index < end; ++index)
     {
-        node.expr->accept(*this);
+        const FlatNode_t &node = nodes[index];
+        switch (node.tag)
+        {
+        case FlatTag_t::VALUE:
+            values.push_back(constants[node.operand]);
+            break;
+        case FlatTag_t::VARIABLE:
+            DEV_ASSERT(node.operand >= variables.size());
+
+            values.push_back(variables[node.operand]);
+            break;
+        QUICKENED_CASES(ADD)
+        QUICKENED_CASES(SUB)
+        QUICKENED_CASES(MUL)
+        QUICKENED_CASES(DIV)
+        QUICKENED_CASES(LESS)
+        QUICKENED_CASES(LESS_OR_EQ)
+        QUICKENED_CASES(MORE)
+        QUICKENED_CASES(MORE_OR_EQ)
+        QUICKENED_CASES(EQ)
+        default:
+            if (quicken(nodes, index))
+            {
+                // Run the node again, now in its quickened form.
+                --index;
+                continue;
+            }
+            operators.push_back(index);
+            continue;
+        }
+
+        for (;;)
+        {
+            while (!operators.empty() && nodes[operators.back()].next == index + 1)
+            {
+                applyOperator(program, nodes[operators.back()]);
+                operators.pop_back();
+            }
+            if (operators.empty())
+            {
+                break;
+            }
+
+            // The left operand of && or || has just been evaluated. When it
+            // decides the result, the right one is skipped as a whole.
+            const uint32_t logical = operators.back();
+            const FlatTag_t tag = nodes[logical].tag;
+            if ((tag != FlatTag_t::AND && tag != FlatTag_t::OR) || nodes[logical + 1].next != index + 1)
+            {
+                break;
+            }
+
+            const bool left = values.back() != 0;
+            if (left != (tag == FlatTag_t::OR))
+            {
+                break;
+            }
+
+            values.back() = left;
+            operators.pop_back();
+            index = nodes[logical].next - 1;
+        }
     }
+
+    DEV_ASSERT(!operators.empty());
+    return popValue();
 }
 
-void Interpreter::visit(const IfElseNode_t &node)
+void Interpreter::applyOperator(const FlatAst_t &program, const FlatNode_t &node)
 {
-    DEV_ASSERT(node.if_case == nullptr);
-    DEV_ASSERT(node.true_expr == nullptr);
-    DEV_ASSERT(node.false_expr == nullptr);
+    const FlatTag_t tag = node.tag;
+    if (tag == FlatTag_t::NOT)
+    {
+        values.push_back(!popValue());
+        return;
+    }
+    if (tag == FlatTag_t::ELEMENT)
+    {
+        values.push_back(variables[elementSlot(program, node.operand, popValue())]);
+        return;
+    }
 
-    node.if_case->accept(*this);
-    const AstValue_t if_case = shared_value;
+    const AstValue_t right = popValue();
+    const AstValue_t left = popValue();
 
-    if (if_case)
+    switch (tag)
     {
-        node.true_expr->accept(*this);
+    case FlatTag_t::AND:
+        values.push_back(left && right);
+        break;
+    case FlatTag_t::OR:
+        values.push_back(left || right);
+        break;
+    case FlatTag_t::ADD:
+        values.push_back(applyBinary<FlatTag_t::ADD>(left, right));
+        break;
+    case FlatTag_t::SUB:
+        values.push_back(applyBinary<FlatTag_t::SUB>(left, right));
+        break;
+    case FlatTag_t::MUL:
+        values.push_back(applyBinary<FlatTag_t::MUL>(left, right));
+        break;
+    case FlatTag_t::DIV:
+        values.push_back(applyBinary<FlatTag_t::DIV>(left, right));
+        break;
+    case FlatTag_t::LESS:
+        values.push_back(applyBinary<FlatTag_t::LESS>(left, right));
+        break;
+    case FlatTag_t::LESS_OR_EQ:
+        values.push_back(applyBinary<FlatTag_t::LESS_OR_EQ>(left, right));
+        break;
+    case FlatTag_t::MORE:
+        values.push_back(applyBinary<FlatTag_t::MORE>(left, right));
+        break;
+    case FlatTag_t::MORE_OR_EQ:
+        values.push_back(applyBinary<FlatTag_t::MORE_OR_EQ>(left, right));
+        break;
+    case FlatTag_t::EQ:
+        values.push_back(applyBinary<FlatTag_t::EQ>(left, right));
+        break;
+    default:
+        DEV_ASSERT(true);
+        break;
     }
-    else
-    {
-        node.false_expr->accept(*this);
-    } 
 }
@@ -1,29 +1,63 @@
-#include <map>
+#include <cstdint>
+#include <vector>
 
 #include "ast.hpp"
-#include "visitor.hpp"
+#include "flatAst.hpp"
+#include "log.hpp"
+#include "output.hpp"
 
-class Interpreter : public Visitor
+// Runs a FlatAst_t. Both statements and expressions are walked forward
+// through the node array, with explicit stacks instead of recursion.
+class Interpreter
 {
 private:
-    std::map<std::string, AstValue_t> variables;
-    AstValue_t shared_value;
+    // When execution reaches at, it continues from to: the end of a taken
+    // true branch jumps over the false one, the end of a loop body goes back
+    // to the loop.
+    struct Jump_t
+    {
+        uint32_t at;
+        uint32_t to;
+    };
+
+    std::vector<AstValue_t> variables;
+    // Values of the evaluated subexpressions, operands are popped by their parent.
+    std::vector<AstValue_t> values;
+    // Operators whose operands are being evaluated.
+    std::vector<uint32_t> operators;
+    std::vector<Jump_t> jumps;
+    OutputBuffer_t output;
 
 public:
     explicit Interpreter() = default;
 
-    void visit(const ProgramNode_t &node) override;
-    void visit(const VariableNode_t &node) override;
-    void visit(const ValueNode_t &node) override;
-    void visit(const AndNode_t &node) override;
-    void visit(const OrNode_t &node) override;
-    void visit(const ComparatorNode_t &node) override;
-    void visit(const ArithmeticNode_t &node) override;
-    void visit(const NotNode_t &node) override;
-    void visit(const NopRuleNode_t &node) override;
-    void visit(const AssignNode_t &node) override;
-    void visit(const DeclareNode_t &node) override;
-    void visit(const PrintNode_t &node) override;
-    void visit(const IfNode_t &node) override;
-    void visit(const IfElseNode_t &node) override;
+    // Runs one top-level statement as soon as it is parsed, variables keep
+    // their values between calls. flushOutput() pushes out what they printed.
+    void executeStatement(FlatAst_t &statement);
+    void flushOutput();
+
+    void setOutputFd(const int fd)
+    {
+        output.setFd(fd);
+    }
+
+    // Operators of program are quickened in place as they are first run,
+    // see quicken() in interpreter.cpp.
+    void interpret(FlatAst_t &program);
+
+private:
+    void execute(FlatAst_t &program);
+    AstValue_t evaluate(FlatAst_t &program, uint32_t first);
+    void applyOperator(const FlatAst_t &program, const FlatNode_t &node);
+    // Slot of arrays[array][index], aborts when index is out of bounds.
+    VariableSlot_t elementSlot(const FlatAst_t &program, uint32_t array, AstValue_t index);
+
+    AstValue_t popValue()
+    {
+        DEV_ASSERT(values.empty());
+
+        const AstValue_t value = values.back();
+        values.pop_back();
+        return value;
+    }
 };
@@ -1,271 +1,1290 @@
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/ExecutionEngine/Orc/Core.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/Mangling.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Metadata.h>
+#include <llvm/IR/PassInstrumentation.h>
+#include <llvm/IR/PassTimingInfo.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Object/ArchiveWriter.h>
+#include <llvm/Passes/OptimizationLevel.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Passes/StandardInstrumentations.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/TargetParser/Host.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
 #include "llvmIR.hpp"
 #include "log.hpp"
+#include "output.hpp"
+#include "threadPool.hpp"
+
+// Runtime functions from runtime/output.cpp, see mipt_print_i64().
+static constexpr const char *PRINT_FUNC_NAME = "mipt_print_i64";
+static constexpr const char *FLUSH_FUNC_NAME = "mipt_flush_output";
+
+// Lanes of the vectors whole-array operations are done on, one AVX2 register.
+static constexpr uint64_t ARRAY_VECTOR_WIDTH = 4;
 
 LLVMBuilder::LLVMBuilder() :
-    lmodule("MIPT language", context),
-    builder(context)
+    context(std::make_unique<llvm::LLVMContext>()),
+    lmodule(std::make_unique<llvm::Module>("MIPT language", *context)),
+    builder(*context),
+    is_module_built(false),
+    output_fd(STDOUT_FILENO),
+    time_report(nullptr),
+    trap_bb(nullptr),
+    arm(0),
+    arms_count(0),
+    are_chunks_objects(false)
 {}
 
-void LLVMBuilder::visit(const ProgramNode_t &node)
+// Target registration touches global LLVM registries, it must happen once
+// even when several builders work on different threads.
+static void initializeNativeTarget()
+{
+    static std::once_flag init_flag;
+    std::call_once(init_flag, []()
+    {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+    });
+}
+
+// Every expression value is an i64, just like AstValue_t in the interpreter,
+// conditions are turned into i1 only where they are consumed.
+llvm::Value *LLVMBuilder::toBool(llvm::Value *value)
+{
+    return builder.CreateICmpNE(value, llvm::ConstantInt::get(value->getType(), 0));
+}
+
+llvm::Value *LLVMBuilder::toValue(llvm::Value *condition)
 {
+    return builder.CreateZExt(condition, builder.getInt64Ty());
+}
+
+llvm::Value *LLVMBuilder::popOperand()
+{
+    DEV_ASSERT(operands.empty());
+
+    llvm::Value *value = operands.back();
+    operands.pop_back();
+    return value;
+}
+
+void LLVMBuilder::generateProgram(const FlatAst_t &program)
+{
+    DEV_ASSERT(program.nodes.empty());
+
     llvm::FunctionType *void_type = llvm::FunctionType::get(builder.getVoidTy(), false);
-    llvm::Function *main_func = llvm::Function::Create(void_type, llvm::Function::ExternalLinkage, "main", lmodule);
-    llvm::BasicBlock *program_entry = llvm::BasicBlock::Create(context, "", main_func);
-    builder.SetInsertPoint(program_entry);
+    llvm::Function *main_func = llvm::Function::Create(void_type, llvm::Function::ExternalLinkage, "main", *lmodule);
+    startFunction(program, main_func);
 
-    for (const auto child : node.children_vec)
+    // Variables start as 0, like in the interpreter.
+    values.assign(program.variables_count, builder.getInt64(0));
+
+    for (const auto &array : program.arrays)
     {
-        child->accept(*this);
+        std::fill_n(values.begin() + array.slot, array.size, nullptr);
+
+        llvm::ArrayType *array_type = llvm::ArrayType::get(builder.getInt64Ty(), array.size);
+        llvm::GlobalVariable *elements = new llvm::GlobalVariable(
+            *lmodule, array_type, false, llvm::GlobalValue::InternalLinkage,
+            llvm::ConstantAggregateZero::get(array_type)
+        );
+        const llvm::Align align(ARRAY_VECTOR_WIDTH * sizeof(AstValue_t));
+        elements->setAlignment(align);
+        arrays.push_back({elements, array_type, align});
     }
 
+    generateStatements(program, 0, program.nodes[0].next);
+
+    llvm::Function *flush_func = lmodule->getFunction(FLUSH_FUNC_NAME);
+    DEV_ASSERT(flush_func == nullptr);
+
+    builder.CreateCall(flush_func);
     builder.CreateRetVoid();
 }
 
-void LLVMBuilder::visit(const VariableNode_t &node)
+// Every function starts in an entry block of its own with no arms, the
+// caller sets up values and arrays.
+void LLVMBuilder::startFunction(const FlatAst_t &program, llvm::Function *func)
+{
+    builder.SetInsertPoint(llvm::BasicBlock::Create(*context, "", func));
+
+    assigned_in.assign(program.variables_count, 0);
+    shadowed.clear();
+    arm = 0;
+    arms_count = 0;
+    arrays.clear();
+    trap_bb = nullptr;
+}
+
+// Generates the whole statements in [first, end) into the current block.
+void LLVMBuilder::generateStatements(const FlatAst_t &program, const uint32_t first, const uint32_t end)
 {
-    if (values.count(node.name) != 0)
+    const FlatNode_t *const nodes = program.nodes.data();
+    uint32_t index = first;
+
+    for (;;)
     {
-        shared_llvm_value = builder.CreateLoad(values[node.name]->getAllocatedType(), values[node.name]);
+        while (!branches.empty() && branches.back().at == index)
+        {
+            endBranch();
+        }
+        if (index >= end)
+        {
+            break;
+        }
+
+        const FlatNode_t &node = nodes[index];
+        switch (node.tag)
+        {
+        case FlatTag_t::BLOCK:
+            ++index;
+            break;
+        case FlatTag_t::DECLARE:
+            assignVariable(node.operand, builder.getInt64(0));
+            index = node.next;
+            break;
+        case FlatTag_t::ASSIGN:
+            assignVariable(node.operand, generateExpression(program, index + 1));
+            index = node.next;
+            break;
+        case FlatTag_t::PRINT:
+            {
+                llvm::Function *print_func = lmodule->getFunction(PRINT_FUNC_NAME);
+                DEV_ASSERT(print_func == nullptr);
+
+                builder.CreateCall(print_func, {generateExpression(program, index + 1)});
+                index = node.next;
+                break;
+            }
+        case FlatTag_t::IF:
+        case FlatTag_t::IF_ELSE:
+            {
+                // The condition may add blocks of its own, the body goes after them.
+                llvm::Value *if_cond = toBool(generateExpression(program, index + 1));
+
+                llvm::Function *curr_bb = builder.GetInsertBlock()->getParent();
+                llvm::BasicBlock *true_bb = llvm::BasicBlock::Create(*context, "", curr_bb);
+                llvm::BasicBlock *false_bb = nullptr;
+                llvm::BasicBlock *continue_bb = llvm::BasicBlock::Create(*context);
+
+                const uint32_t true_body = nodes[index + 1].next;
+
+                if (node.tag == FlatTag_t::IF)
+                {
+                    builder.CreateCondBr(if_cond, true_bb, continue_bb);
+                    branches.push_back({node.next, node.next, nullptr, continue_bb, nullptr, builder.GetInsertBlock(), {}, 0, 0});
+                }
+                else
+                {
+                    false_bb = llvm::BasicBlock::Create(*context);
+                    builder.CreateCondBr(if_cond, true_bb, false_bb);
+                    branches.push_back({nodes[true_body].next, node.next, false_bb, continue_bb, nullptr, nullptr, {}, 0, 0});
+                }
+
+                startArm(branches.back());
+                builder.SetInsertPoint(true_bb);
+                index = true_body;
+                break;
+            }
+        case FlatTag_t::WHILE:
+            {
+                // The current block only branches to the header and so is the
+                // loop preheader; the condition gets its own header block.
+                llvm::Function *curr_bb = builder.GetInsertBlock()->getParent();
+                llvm::BasicBlock *preheader_bb = builder.GetInsertBlock();
+                llvm::BasicBlock *header_bb = llvm::BasicBlock::Create(*context, "", curr_bb);
+                llvm::BasicBlock *exit_bb = llvm::BasicBlock::Create(*context);
+                builder.CreateBr(header_bb);
+                builder.SetInsertPoint(header_bb);
+
+                branches.push_back({node.next, node.next, nullptr, exit_bb, header_bb, nullptr, {}, 0, 0});
+                startArm(branches.back());
+                createLoopPhis(program, index, preheader_bb);
+
+                llvm::Value *loop_cond = toBool(generateExpression(program, index + 1));
+
+                llvm::BasicBlock *body_bb = llvm::BasicBlock::Create(*context, "", curr_bb);
+                builder.CreateCondBr(loop_cond, body_bb, exit_bb);
+
+                builder.SetInsertPoint(body_bb);
+                index = nodes[index + 1].next;
+                break;
+            }
+        case FlatTag_t::DECLARE_ARRAY:
+            {
+                DEV_ASSERT(node.operand >= arrays.size());
+
+                const ArrayStorage_t &storage = arrays[node.operand];
+                builder.CreateMemSet(
+                    storage.elements, builder.getInt8(0),
+                    program.arrays[node.operand].size * sizeof(AstValue_t), storage.align
+                );
+                index = node.next;
+                break;
+            }
+        case FlatTag_t::ASSIGN_ELEMENT:
+            {
+                llvm::Value *element = generateExpression(program, index + 1);
+                llvm::Value *value = generateExpression(program, nodes[index + 1].next);
+                builder.CreateStore(value, generateElementPointer(node.operand, element));
+                index = node.next;
+                break;
+            }
+        case FlatTag_t::ASSIGN_ARRAY:
+            // The operator and both its ARRAY leaves follow the node.
+            generateArrayOperation(nodes[index + 1].tag, node.operand, nodes[index + 2].operand, nodes[index + 3].operand);
+            index = node.next;
+            break;
+        default:
+            DEV_ASSERT(true);
+            break;
+        }
     }
-    else
+
+    DEV_ASSERT(!branches.empty());
+}
+
+void LLVMBuilder::endBranch()
+{
+    DEV_ASSERT(branches.empty());
+
+    PendingBranch_t &branch = branches.back();
+    llvm::Function *curr_bb = builder.GetInsertBlock()->getParent();
+
+    if (branch.header_bb != nullptr)
     {
-        USER_ABORT("Variable (%s) was not created!\n", node.name.c_str());
+        // A single latch holds the only back edge, which carries the loop
+        // metadata. No llvm.loop.mustprogress: an endless loop is a valid program.
+        llvm::BasicBlock *latch_bb = llvm::BasicBlock::Create(*context, "", curr_bb);
+        builder.CreateBr(latch_bb);
+        builder.SetInsertPoint(latch_bb);
+
+        setLoopMetadata(builder.CreateBr(branch.header_bb));
+
+        curr_bb->insert(curr_bb->end(), branch.continue_bb);
+        builder.SetInsertPoint(branch.continue_bb);
+        finishLoop(branch, latch_bb);
+        branches.pop_back();
+        return;
     }
+
+    builder.CreateBr(branch.continue_bb);
+    llvm::BasicBlock *arm_end_bb = builder.GetInsertBlock();
+
+    if (branch.false_bb != nullptr)
+    {
+        // The true arm is over: its definitions go to the join from
+        // arm_end_bb, the false arm starts from the ones before the if.
+        for (size_t i = branch.shadowed_start; i < shadowed.size(); ++i)
+        {
+            const ShadowedValue_t &old = shadowed[i];
+            branch.definitions.push_back({old.slot, values[old.slot]});
+            values[old.slot] = old.value;
+            assigned_in[old.slot] = old.assigned_in;
+        }
+        shadowed.resize(branch.shadowed_start);
+        arm = branch.outer_arm;
+        branch.incoming_bb = arm_end_bb;
+
+        // The false arm logs the slots of the true one first, in the same
+        // order, so that joinArms() finds them all.
+        startArm(branch);
+        for (const Definition_t &definition : branch.definitions)
+        {
+            assignVariable(definition.slot, values[definition.slot]);
+        }
+
+        curr_bb->insert(curr_bb->end(), branch.false_bb);
+        builder.SetInsertPoint(branch.false_bb);
+
+        // The false body ends where the whole if/else does.
+        branch.at = branch.end;
+        branch.false_bb = nullptr;
+        return;
+    }
+
+    curr_bb->insert(curr_bb->end(), branch.continue_bb);
+    builder.SetInsertPoint(branch.continue_bb);
+    joinArms(branch, arm_end_bb);
+    branches.pop_back();
 }
 
-void LLVMBuilder::visit(const ValueNode_t &node)
+void LLVMBuilder::assignVariable(const uint32_t slot, llvm::Value *value)
 {
-    shared_llvm_value = llvm::ConstantInt::get(context, llvm::APInt(64, node.value, true));
+    DEV_ASSERT(slot >= values.size());
+    DEV_ASSERT(values[slot] == nullptr);
+
+    if (assigned_in[slot] != arm)
+    {
+        shadowed.push_back({slot, assigned_in[slot], values[slot]});
+        assigned_in[slot] = arm;
+    }
+    values[slot] = value;
 }
 
-void LLVMBuilder::visit(const AndNode_t &node)
+void LLVMBuilder::startArm(PendingBranch_t &branch)
 {
-    DEV_ASSERT(node.left == nullptr);
-    DEV_ASSERT(node.right == nullptr);
+    branch.shadowed_start = shadowed.size();
+    branch.outer_arm = arm;
+    arm = ++arms_count;
+}
 
-    node.left->accept(*this);
-    llvm::Value *value1 = shared_llvm_value;
+// The header gets a phi for every variable assigned in the loop, the value
+// from the latch is added by finishLoop().
+void LLVMBuilder::createLoopPhis(const FlatAst_t &program, const uint32_t loop, llvm::BasicBlock *preheader_bb)
+{
+    const FlatNode_t *const nodes = program.nodes.data();
+    PendingBranch_t &branch = branches.back();
 
-    node.right->accept(*this);
-    llvm::Value *value2 = shared_llvm_value;
+    for (uint32_t index = loop + 1; index < nodes[loop].next; ++index)
+    {
+        const FlatNode_t &node = nodes[index];
+        if ((node.tag != FlatTag_t::ASSIGN && node.tag != FlatTag_t::DECLARE) || assigned_in[node.operand] == arm)
+        {
+            continue;
+        }
 
-    shared_llvm_value = builder.CreateLogicalOp(llvm::Instruction::BinaryOps::And, value1, value2);
+        llvm::PHINode *phi = builder.CreatePHI(builder.getInt64Ty(), 2);
+        phi->addIncoming(values[node.operand], preheader_bb);
+        assignVariable(node.operand, phi);
+        branch.definitions.push_back({node.operand, phi});
+    }
 }
 
-void LLVMBuilder::visit(const OrNode_t &node)
+// The loop is left from its header, so after it the variables are the
+// header phis. A phi getting the same value on both edges, or itself from
+// the latch, is replaced by that value.
+void LLVMBuilder::finishLoop(PendingBranch_t &branch, llvm::BasicBlock *latch_bb)
 {
-    DEV_ASSERT(node.left == nullptr);
-    DEV_ASSERT(node.right == nullptr);
+    // Every slot logged in the loop got its phi in createLoopPhis(), in order.
+    DEV_ASSERT(shadowed.size() - branch.shadowed_start != branch.definitions.size());
 
-    node.left->accept(*this);
-    llvm::Value *value1 = shared_llvm_value;
+    for (size_t i = branch.shadowed_start; i < shadowed.size(); ++i)
+    {
+        const ShadowedValue_t &old = shadowed[i];
+        llvm::PHINode *phi = llvm::cast<llvm::PHINode>(branch.definitions[i - branch.shadowed_start].value);
+        phi->addIncoming(values[old.slot], latch_bb);
+        values[old.slot] = old.value;
+        assigned_in[old.slot] = old.assigned_in;
+    }
+    shadowed.resize(branch.shadowed_start);
+    arm = branch.outer_arm;
 
-    node.right->accept(*this);
-    llvm::Value *value2 = shared_llvm_value;
+    for (const Definition_t &definition : branch.definitions)
+    {
+        llvm::PHINode *phi = llvm::cast<llvm::PHINode>(definition.value);
+        llvm::Value *entry_value = phi->getIncomingValue(0);
+        llvm::Value *latch_value = phi->getIncomingValue(1);
 
-    shared_llvm_value = builder.CreateLogicalOp(llvm::Instruction::BinaryOps::Or, value1, value2);
+        if (latch_value == phi || latch_value == entry_value)
+        {
+            phi->replaceAllUsesWith(entry_value);
+            phi->eraseFromParent();
+            continue;
+        }
+        assignVariable(definition.slot, phi);
+    }
 }
 
-void LLVMBuilder::visit(const ComparatorNode_t &node)
+// Puts a phi into the join block for every variable whose definition from
+// arm_end_bb differs from the one from incoming_bb: the start of the arm
+// for an if, the end of the true arm for an if/else.
+void LLVMBuilder::joinArms(PendingBranch_t &branch, llvm::BasicBlock *arm_end_bb)
 {
-    DEV_ASSERT(node.left == nullptr);
-    DEV_ASSERT(node.right == nullptr);
+    std::vector<Definition_t> joined;
 
-    node.left->accept(*this);
-    llvm::Value *value1 = shared_llvm_value;
+    for (size_t i = branch.shadowed_start; i < shadowed.size(); ++i)
+    {
+        const ShadowedValue_t &old = shadowed[i];
+        const size_t logged = i - branch.shadowed_start;
+        llvm::Value *arm_value = values[old.slot];
+        llvm::Value *incoming_value = logged < branch.definitions.size() ? branch.definitions[logged].value : old.value;
 
-    node.right->accept(*this);
-    llvm::Value *value2 = shared_llvm_value;
+        values[old.slot] = old.value;
+        assigned_in[old.slot] = old.assigned_in;
 
-    switch (node.oper)
+        if (arm_value != incoming_value)
+        {
+            llvm::PHINode *phi = builder.CreatePHI(builder.getInt64Ty(), 2);
+            phi->addIncoming(incoming_value, branch.incoming_bb);
+            phi->addIncoming(arm_value, arm_end_bb);
+            joined.push_back({old.slot, phi});
+        }
+        else if (arm_value != old.value)
+        {
+            // Both arms of an if/else have ended up with the same new value.
+            joined.push_back({old.slot, arm_value});
+        }
+    }
+    shadowed.resize(branch.shadowed_start);
+    arm = branch.outer_arm;
+
+    for (const Definition_t &definition : joined)
     {
-    case ComparatorOperators::LESS:
-        shared_llvm_value = builder.CreateICmpULT(value1, value2);
-        break;
-    case ComparatorOperators::LESS_OR_EQ:
-        shared_llvm_value = builder.CreateICmpULE(value1, value2);
-        break;
-    case ComparatorOperators::MORE:
-        shared_llvm_value = builder.CreateICmpUGT(value1, value2);
-        break;
-    case ComparatorOperators::MORE_OR_EQ:
-        shared_llvm_value = builder.CreateICmpUGE(value1, value2);
-        break;
-    case ComparatorOperators::EQ:
-        shared_llvm_value = builder.CreateICmpEQ(value1, value2);
-        break;
-    default:
-        DEV_ASSERT(true);
-        break;
+        assignVariable(definition.slot, definition.value);
+    }
+}
+
+// Gives the loop its own distinct llvm.loop node, for the loop passes to
+// attach their hints to.
+void LLVMBuilder::setLoopMetadata(llvm::BranchInst *back_edge)
+{
+    llvm::MDNode *loop_id = llvm::MDNode::getDistinct(*context, {nullptr});
+    loop_id->replaceOperandWith(0, loop_id);
+    back_edge->setMetadata(llvm::LLVMContext::MD_loop, loop_id);
+}
+
+// Same forward walk as Interpreter::evaluate(): an operator is emitted once
+// the leaf closing its subtree has been generated.
+llvm::Value *LLVMBuilder::generateExpression(const FlatAst_t &program, const uint32_t first)
+{
+    const FlatNode_t *const nodes = program.nodes.data();
+    const uint32_t end = nodes[first].next;
+
+    for (uint32_t index = first; index < end; ++index)
+    {
+        const FlatNode_t &node = nodes[index];
+        switch (node.tag)
+        {
+        case FlatTag_t::VALUE:
+            operands.push_back(llvm::ConstantInt::get(*context, llvm::APInt(64, program.constants[node.operand], true)));
+            break;
+        case FlatTag_t::VARIABLE:
+            DEV_ASSERT(node.operand >= values.size());
+            DEV_ASSERT(values[node.operand] == nullptr);
+
+            operands.push_back(values[node.operand]);
+            break;
+        default:
+            operators.push_back(index);
+            continue;
+        }
+
+        while (!operators.empty() && nodes[operators.back()].next == index + 1)
+        {
+            // The interpreter may have quickened the node, the operands are
+            // generated the same way anyway.
+            generateOperator(nodes[operators.back()]);
+            operators.pop_back();
+        }
+
+        // The right operand of && or || is generated in a block of its own,
+        // entered only when the left one does not decide the result.
+        if (!operators.empty())
+        {
+            const uint32_t logical = operators.back();
+            const FlatTag_t tag = nodes[logical].tag;
+            if ((tag == FlatTag_t::AND || tag == FlatTag_t::OR) && nodes[logical + 1].next == index + 1)
+            {
+                startShortCircuit(tag);
+            }
+        }
     }
+
+    DEV_ASSERT(!operators.empty());
+    return popOperand();
 }
 
-void LLVMBuilder::visit(const ArithmeticNode_t &node)
+void LLVMBuilder::startShortCircuit(const FlatTag_t tag)
 {
-    DEV_ASSERT(node.left == nullptr);
-    DEV_ASSERT(node.right == nullptr);
+    llvm::Value *left = toBool(popOperand());
 
-    node.left->accept(*this);
-    llvm::Value *value1 = shared_llvm_value;
+    llvm::Function *curr_bb = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *right_bb = llvm::BasicBlock::Create(*context, "", curr_bb);
+    llvm::BasicBlock *merge_bb = llvm::BasicBlock::Create(*context);
+
+    if (tag == FlatTag_t::AND)
+    {
+        builder.CreateCondBr(left, right_bb, merge_bb);
+    }
+    else
+    {
+        builder.CreateCondBr(left, merge_bb, right_bb);
+    }
+    short_circuits.push_back({builder.GetInsertBlock(), merge_bb});
+
+    builder.SetInsertPoint(right_bb);
+}
+
+// Joins the two ways out of a && or ||: the value the left operand decided
+// on, or the right operand.
+llvm::Value *LLVMBuilder::finishShortCircuit(const FlatTag_t tag)
+{
+    DEV_ASSERT(short_circuits.empty());
 
-    node.right->accept(*this);
-    llvm::Value *value2 = shared_llvm_value;
+    const ShortCircuit_t short_circuit = short_circuits.back();
+    short_circuits.pop_back();
 
-    switch (node.oper)
+    llvm::Value *right = toBool(popOperand());
+    llvm::BasicBlock *right_end_bb = builder.GetInsertBlock();
+    builder.CreateBr(short_circuit.merge_bb);
+
+    llvm::Function *curr_bb = right_end_bb->getParent();
+    curr_bb->insert(curr_bb->end(), short_circuit.merge_bb);
+    builder.SetInsertPoint(short_circuit.merge_bb);
+
+    llvm::PHINode *result = builder.CreatePHI(builder.getInt1Ty(), 2);
+    result->addIncoming(builder.getInt1(tag == FlatTag_t::OR), short_circuit.left_end_bb);
+    result->addIncoming(right, right_end_bb);
+    return toValue(result);
+}
+
+void LLVMBuilder::generateOperator(const FlatNode_t &node)
+{
+    const FlatTag_t tag = baseOperator(node.tag);
+    switch (tag)
     {
-    case ArithmeticOperators::ADD:
-        shared_llvm_value = builder.CreateAdd(value1, value2);
-        break;
-    case ArithmeticOperators::SUB:
-        shared_llvm_value = builder.CreateSub(value1, value2);
-        break;
-    case ArithmeticOperators::MUL:
-        shared_llvm_value = builder.CreateMul(value1, value2);
-        break;
-    case ArithmeticOperators::DIV:
-        shared_llvm_value = builder.CreateSDiv(value1, value2);
+    case FlatTag_t::NOT:
+        operands.push_back(toValue(builder.CreateNot(toBool(popOperand()))));
+        return;
+    case FlatTag_t::AND:
+    case FlatTag_t::OR:
+        operands.push_back(finishShortCircuit(tag));
+        return;
+    case FlatTag_t::ELEMENT:
+        operands.push_back(builder.CreateLoad(builder.getInt64Ty(), generateElementPointer(node.operand, popOperand())));
+        return;
+    default:
         break;
+    }
+
+    llvm::Value *value2 = popOperand();
+    llvm::Value *value1 = popOperand();
+    operands.push_back(generateBinary(tag, value1, value2));
+}
+
+// Works on i64 and on vectors of i64 alike, comparisons give 0 or 1 per lane.
+llvm::Value *LLVMBuilder::generateBinary(const FlatTag_t tag, llvm::Value *left, llvm::Value *right)
+{
+    switch (tag)
+    {
+    case FlatTag_t::ADD:
+        return builder.CreateAdd(left, right);
+    case FlatTag_t::SUB:
+        return builder.CreateSub(left, right);
+    case FlatTag_t::MUL:
+        return builder.CreateMul(left, right);
+    case FlatTag_t::DIV:
+        return builder.CreateSDiv(left, right);
+    case FlatTag_t::LESS:
+        return builder.CreateZExt(builder.CreateICmpSLT(left, right), left->getType());
+    case FlatTag_t::LESS_OR_EQ:
+        return builder.CreateZExt(builder.CreateICmpSLE(left, right), left->getType());
+    case FlatTag_t::MORE:
+        return builder.CreateZExt(builder.CreateICmpSGT(left, right), left->getType());
+    case FlatTag_t::MORE_OR_EQ:
+        return builder.CreateZExt(builder.CreateICmpSGE(left, right), left->getType());
+    case FlatTag_t::EQ:
+        return builder.CreateZExt(builder.CreateICmpEQ(left, right), left->getType());
     default:
         DEV_ASSERT(true);
-        break;
+        return nullptr;
     }
 }
 
-void LLVMBuilder::visit(const NotNode_t &node)
+// Checks index against the array size first, a failed check flushes the
+// program output and traps.
+llvm::Value *LLVMBuilder::generateElementPointer(const uint32_t array, llvm::Value *index)
 {
-    DEV_ASSERT(node.child == nullptr);
+    DEV_ASSERT(array >= arrays.size());
+
+    const ArrayStorage_t &storage = arrays[array];
+    llvm::Function *curr_bb = builder.GetInsertBlock()->getParent();
+
+    if (trap_bb == nullptr)
+    {
+        llvm::IRBuilderBase::InsertPointGuard guard(builder);
 
-    node.child->accept(*this);
-    llvm::Value *value1 = shared_llvm_value;
+        trap_bb = llvm::BasicBlock::Create(*context, "", curr_bb);
+        builder.SetInsertPoint(trap_bb);
+        builder.CreateCall(lmodule->getFunction(FLUSH_FUNC_NAME));
+        builder.CreateCall(llvm::Intrinsic::getDeclaration(lmodule.get(), llvm::Intrinsic::trap));
+        builder.CreateUnreachable();
+    }
+
+    // Negative indices are huge unsigned ones.
+    const uint64_t size = storage.type->getNumElements();
+    llvm::Value *in_bounds = builder.CreateICmpULT(index, builder.getInt64(size));
+    llvm::BasicBlock *element_bb = llvm::BasicBlock::Create(*context, "", curr_bb);
+    builder.CreateCondBr(in_bounds, element_bb, trap_bb);
+    builder.SetInsertPoint(element_bb);
 
-    shared_llvm_value = builder.CreateNot(value1);
+    return builder.CreateInBoundsGEP(storage.type, storage.elements, {builder.getInt64(0), index});
 }
 
-void LLVMBuilder::visit(const NopRuleNode_t &node)
+// dst = left oper right on <ARRAY_VECTOR_WIDTH x i64> vectors in a loop,
+// the elements left over are done as one shorter vector. The backend splits
+// the vectors into whatever registers the target has.
+void LLVMBuilder::generateArrayOperation(const FlatTag_t tag, const uint32_t dst, const uint32_t left, const uint32_t right)
 {
-    for (const auto child : node.children_vec)
+    DEV_ASSERT(dst >= arrays.size());
+    DEV_ASSERT(left >= arrays.size());
+    DEV_ASSERT(right >= arrays.size());
+
+    llvm::Type *element_type = builder.getInt64Ty();
+    const uint64_t size = arrays[dst].type->getNumElements();
+    const uint64_t vectors_size = size - size % ARRAY_VECTOR_WIDTH;
+
+    const auto apply = [&](llvm::Value *offset, const uint64_t width)
     {
-        child->accept(*this);
+        llvm::Type *vector_type = llvm::FixedVectorType::get(element_type, static_cast<unsigned>(width));
+        const llvm::Align align(sizeof(AstValue_t));
+
+        llvm::Value *left_lanes = builder.CreateAlignedLoad(
+            vector_type, builder.CreateInBoundsGEP(element_type, arrays[left].elements, offset), align);
+        llvm::Value *right_lanes = builder.CreateAlignedLoad(
+            vector_type, builder.CreateInBoundsGEP(element_type, arrays[right].elements, offset), align);
+        builder.CreateAlignedStore(
+            generateBinary(tag, left_lanes, right_lanes),
+            builder.CreateInBoundsGEP(element_type, arrays[dst].elements, offset), align);
+    };
+
+    if (vectors_size > 0)
+    {
+        // A single block loop: it is its own header and latch, the block
+        // before it is the preheader.
+        llvm::Function *curr_bb = builder.GetInsertBlock()->getParent();
+        llvm::BasicBlock *preheader_bb = builder.GetInsertBlock();
+        llvm::BasicBlock *loop_bb = llvm::BasicBlock::Create(*context, "", curr_bb);
+        llvm::BasicBlock *exit_bb = llvm::BasicBlock::Create(*context, "", curr_bb);
+        builder.CreateBr(loop_bb);
+        builder.SetInsertPoint(loop_bb);
+
+        llvm::PHINode *offset = builder.CreatePHI(element_type, 2);
+        offset->addIncoming(builder.getInt64(0), preheader_bb);
+        apply(offset, ARRAY_VECTOR_WIDTH);
+
+        llvm::Value *next_offset = builder.CreateAdd(offset, builder.getInt64(ARRAY_VECTOR_WIDTH), "", true, true);
+        offset->addIncoming(next_offset, loop_bb);
+
+        setLoopMetadata(builder.CreateCondBr(
+            builder.CreateICmpULT(next_offset, builder.getInt64(vectors_size)), loop_bb, exit_bb));
+
+        builder.SetInsertPoint(exit_bb);
+    }
+    if (vectors_size < size)
+    {
+        apply(builder.getInt64(vectors_size), size - vectors_size);
     }
 }
 
-void LLVMBuilder::visit(const AssignNode_t &node)
+// Cuts the top-level statements into at most codegen_chunks ranges of
+// about the same number of nodes, a statement is never cut.
+void LLVMBuilder::splitProgram(const FlatAst_t &program)
 {
-    DEV_ASSERT(node.value == nullptr);
+    const FlatNode_t *const nodes = program.nodes.data();
+    const uint64_t end = nodes[0].next;
+    const uint64_t chunks_count = options.codegen_chunks;
 
-    node.value->accept(*this);
-    llvm::Value *value = shared_llvm_value;
-
-    if (values.count(node.name) != 0)
+    chunks.clear();
+    uint32_t first = 1;
+    for (uint32_t index = 1; index < end; index = nodes[index].next)
     {
-        shared_llvm_value = builder.CreateStore(value, values[node.name]);
+        const uint32_t next = nodes[index].next;
+        if (next >= 1 + (end - 1) * (chunks.size() + 1) / chunks_count)
+        {
+            chunks.push_back({first, next, "mipt_chunk_" + std::to_string(chunks.size()), {}, false});
+            first = next;
+        }
     }
-    else
+}
+
+// void chunk(ptr state): only main calls it, from the same output.
+static llvm::Function *createChunkFunction(llvm::Module &lmodule, const std::string &name)
+{
+    llvm::LLVMContext &context = lmodule.getContext();
+    llvm::FunctionType *chunk_type = llvm::FunctionType::get(
+        llvm::Type::getVoidTy(context), {llvm::PointerType::getUnqual(context)}, false
+    );
+
+    llvm::Function *chunk_func = llvm::Function::Create(chunk_type, llvm::Function::ExternalLinkage, name, lmodule);
+    chunk_func->setVisibility(llvm::GlobalValue::HiddenVisibility);
+    chunk_func->addParamAttr(0, llvm::Attribute::NoAlias);
+    return chunk_func;
+}
+
+// main of a split program owns the state and calls the chunks in order.
+void LLVMBuilder::generateChunkCalls(const FlatAst_t &program)
+{
+    llvm::FunctionType *void_type = llvm::FunctionType::get(builder.getVoidTy(), false);
+    llvm::Function *main_func = llvm::Function::Create(void_type, llvm::Function::ExternalLinkage, "main", *lmodule);
+    startFunction(program, main_func);
+
+    // Variables start as 0, like in the interpreter.
+    llvm::ArrayType *state_type = llvm::ArrayType::get(builder.getInt64Ty(), program.variables_count);
+    llvm::GlobalVariable *state = new llvm::GlobalVariable(
+        *lmodule, state_type, false, llvm::GlobalValue::InternalLinkage,
+        llvm::ConstantAggregateZero::get(state_type), "mipt_state"
+    );
+
+    for (const Chunk_t &chunk : chunks)
     {
-        USER_ABORT("Variable (%s) was not created!\n", node.name.c_str());
+        builder.CreateCall(createChunkFunction(*lmodule, chunk.name), {state});
     }
+
+    llvm::Function *flush_func = lmodule->getFunction(FLUSH_FUNC_NAME);
+    DEV_ASSERT(flush_func == nullptr);
+
+    builder.CreateCall(flush_func);
+    builder.CreateRetVoid();
 }
 
-void LLVMBuilder::visit(const DeclareNode_t &node)
+// A chunk loads the variables it uses from the state when it starts and
+// stores the ones it has assigned when it returns, SSA is built in between
+// just like in main. Array elements are used in place.
+void LLVMBuilder::generateChunk(const FlatAst_t &program, const Chunk_t &chunk)
 {
-    values[node.name] = builder.CreateAlloca(llvm::Type::getInt64Ty(context));
+    llvm::Function *chunk_func = createChunkFunction(*lmodule, chunk.name);
+    startFunction(program, chunk_func);
+
+    llvm::Value *state = chunk_func->getArg(0);
+    llvm::ArrayType *state_type = llvm::ArrayType::get(builder.getInt64Ty(), program.variables_count);
+    const auto slotPointer = [&](const uint32_t slot)
+    {
+        return builder.CreateConstInBoundsGEP2_64(state_type, state, 0, slot);
+    };
+
+    for (const auto &array : program.arrays)
+    {
+        llvm::ArrayType *array_type = llvm::ArrayType::get(builder.getInt64Ty(), array.size);
+        arrays.push_back({slotPointer(array.slot), array_type, llvm::Align(sizeof(AstValue_t))});
+    }
+
+    const FlatNode_t *const nodes = program.nodes.data();
+    values.assign(program.variables_count, nullptr);
+    for (uint32_t index = chunk.first; index < chunk.end; ++index)
+    {
+        const FlatNode_t &node = nodes[index];
+        const bool is_variable =
+            node.tag == FlatTag_t::VARIABLE || node.tag == FlatTag_t::ASSIGN || node.tag == FlatTag_t::DECLARE;
+
+        if (is_variable && values[node.operand] == nullptr)
+        {
+            values[node.operand] = builder.CreateLoad(builder.getInt64Ty(), slotPointer(node.operand));
+        }
+    }
+    const std::vector<llvm::Value*> entry_values = values;
+
+    generateStatements(program, chunk.first, chunk.end);
+
+    for (uint32_t slot = 0; slot < values.size(); ++slot)
+    {
+        if (values[slot] != entry_values[slot])
+        {
+            builder.CreateStore(values[slot], slotPointer(slot));
+        }
+    }
+    builder.CreateRetVoid();
 }
 
-void LLVMBuilder::visit(const PrintNode_t &node)
+// Runs on a worker thread in a builder of its own, the chunks share
+// nothing but program. options.emit_kind tells bitcode from object code.
+bool LLVMBuilder::buildChunk(const FlatAst_t &program, Chunk_t &chunk)
 {
-    llvm::Function *print_func = lmodule.getFunction("printf");
-    DEV_ASSERT(print_func == nullptr);
+    if (!createTargetMachine())
+    {
+        return false;
+    }
 
-    node.child->accept(*this);
-    llvm::Value *print_value = shared_llvm_value;
+    createStdFunctions();
+    generateChunk(program, chunk);
+    if (!checkModule("Generated LLVM IR is broken!\n") || !optimizeModule())
+    {
+        return false;
+    }
 
-    static const auto int_fmt_str = builder.CreateGlobalString("%ld\n");
-    std::vector<llvm::Value*> argv = {
-        int_fmt_str,
-        print_value
+    chunk.code.clear();
+    llvm::raw_svector_ostream code_stream(chunk.code);
+    if (options.emit_kind == EmitKind::OBJ)
+    {
+        return emitObjectCode(code_stream);
+    }
+
+    llvm::WriteBitcodeToFile(*lmodule, code_stream);
+    return true;
+}
+
+// Builds, optimizes and, for is_object, compiles every chunk on a thread
+// pool. Chunks already built the same way are kept.
+bool LLVMBuilder::buildChunks(const FlatAst_t &program, const bool is_object)
+{
+    const auto isBuilt = [](const Chunk_t &chunk)
+    {
+        return chunk.is_built;
     };
-    shared_llvm_value = builder.CreateCall(print_func, argv);
+    if (chunks.empty() || (are_chunks_objects == is_object && std::all_of(chunks.begin(), chunks.end(), isBuilt)))
+    {
+        return true;
+    }
+
+    TimeReport_t::Scope_t chunks_scope(time_report, "llvm_chunks");
+
+    CodegenOptions_t chunk_options = options;
+    chunk_options.emit_kind = is_object ? EmitKind::OBJ : EmitKind::BC;
+    are_chunks_objects = is_object;
+
+    ThreadPool_t pool(std::min<size_t>(chunks.size(), std::max(1u, std::thread::hardware_concurrency())));
+    for (Chunk_t &chunk : chunks)
+    {
+        pool.submit([&program, &chunk, &chunk_options]()
+        {
+            LLVMBuilder chunk_builder;
+            chunk_builder.setOptions(chunk_options);
+            chunk.is_built = chunk_builder.buildChunk(program, chunk);
+        });
+    }
+    pool.wait();
+
+    return std::all_of(chunks.begin(), chunks.end(), isBuilt);
 }
 
-void LLVMBuilder::visit(const IfNode_t &node)
+// IR, bitcode and assembly are written from a single module: the optimized
+// chunks are read back into this context and linked into the module with main.
+bool LLVMBuilder::linkChunks()
 {
-    DEV_ASSERT(node.if_case == nullptr);
-    DEV_ASSERT(node.expr == nullptr);
+    TimeReport_t::Scope_t link_scope(time_report, "llvm_link");
 
-    llvm::Function *curr_bb = builder.GetInsertBlock()->getParent();
-    llvm::BasicBlock *true_bb = llvm::BasicBlock::Create(context, "", curr_bb);
-    llvm::BasicBlock *continue_bb = llvm::BasicBlock::Create(context);
+    for (Chunk_t &chunk : chunks)
+    {
+        const llvm::StringRef code(chunk.code.data(), chunk.code.size());
+        auto chunk_module = llvm::parseBitcodeFile(llvm::MemoryBufferRef(code, chunk.name), *context);
+        if (!chunk_module)
+        {
+            USER_ERR("Failed to read %s: %s\n", chunk.name.c_str(), llvm::toString(chunk_module.takeError()).c_str());
+            return false;
+        }
+        if (llvm::Linker::linkModules(*lmodule, std::move(*chunk_module)))
+        {
+            USER_ERR("Failed to link %s\n", chunk.name.c_str());
+            return false;
+        }
+    }
 
-    node.if_case->accept(*this);
-    llvm::Value *if_cond = builder.CreateICmpNE(
-        shared_llvm_value,
-        llvm::ConstantInt::get(context, llvm::APInt(1, 0, true))
-    );
-    builder.CreateCondBr(if_cond, true_bb, continue_bb);
+    // The module has the whole program now.
+    chunks.clear();
+    return checkModule("Linked LLVM IR is broken!\n");
+}
+
+// Relocatable objects can not be merged in-process, main and the chunks
+// compiled on the thread pool go to output_file as members of one archive,
+// which linkers take in place of an object.
+bool LLVMBuilder::writeChunkArchive(const char *output_file)
+{
+    TimeReport_t::Scope_t link_scope(time_report, "llvm_link");
+
+    llvm::SmallVector<char, 0> main_code;
+    llvm::raw_svector_ostream main_stream(main_code);
+    if (!emitObjectCode(main_stream))
+    {
+        return false;
+    }
+
+    // Members refer to their names, which have to outlive them.
+    std::vector<std::string> member_names = {"main.o"};
+    for (const Chunk_t &chunk : chunks)
+    {
+        member_names.push_back(chunk.name + ".o");
+    }
+
+    std::vector<llvm::NewArchiveMember> members;
+    members.emplace_back(llvm::MemoryBufferRef(llvm::StringRef(main_code.data(), main_code.size()), member_names[0]));
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        const llvm::StringRef code(chunks[i].code.data(), chunks[i].code.size());
+        members.emplace_back(llvm::MemoryBufferRef(code, member_names[i + 1]));
+    }
 
-    builder.SetInsertPoint(true_bb);
-    node.expr->accept(*this);
-    builder.CreateBr(continue_bb);
+    // With a symbol table linkers find main and the chunks it calls.
+    if (auto err = llvm::writeArchive(output_file, members, llvm::SymtabWritingMode::NormalSymtab,
+                                      llvm::object::Archive::K_GNU, true, false))
+    {
+        USER_ERR("Failed to write %s: %s\n", output_file, llvm::toString(std::move(err)).c_str());
+        return false;
+    }
+    return true;
+}
 
-    curr_bb->insert(curr_bb->end(), continue_bb);
-    builder.SetInsertPoint(continue_bb);
+bool LLVMBuilder::buildModule(const FlatAst_t &program)
+{
+    DEV_ASSERT(lmodule == nullptr);
+
+    if (is_module_built)
+    {
+        return true;
+    }
+    // Pass timers are process wide, chunks are optimized on several threads.
+    if (options.codegen_chunks > 1 && options.time_passes)
+    {
+        USER_ERR("Chunks can not be built with pass timing\n");
+        return false;
+    }
+
+    {
+        TimeReport_t::Scope_t build_scope(time_report, "llvm_ir_build");
+        if (!createTargetMachine())
+        {
+            return false;
+        }
+
+        createStdFunctions();
+        if (options.codegen_chunks > 1)
+        {
+            splitProgram(program);
+            generateChunkCalls(program);
+        }
+        else
+        {
+            generateProgram(program);
+        }
+        is_module_built = true;
+
+        if (!checkModule("Generated LLVM IR is broken!\n"))
+        {
+            return false;
+        }
+    }
+
+    return optimizeModule();
 }
 
-void LLVMBuilder::visit(const IfElseNode_t &node)
+bool LLVMBuilder::checkModule(const char *error_message)
 {
-    DEV_ASSERT(node.if_case == nullptr);
-    DEV_ASSERT(node.true_expr == nullptr);
-    DEV_ASSERT(node.false_expr == nullptr);
+    // Verifier output goes through the log, like every other diagnostic.
+    std::string errors;
+    llvm::raw_string_ostream error_stream(errors);
+    if (!llvm::verifyModule(*lmodule, &error_stream))
+    {
+        return true;
+    }
 
-    llvm::Function *curr_bb = builder.GetInsertBlock()->getParent();
-    llvm::BasicBlock *true_bb = llvm::BasicBlock::Create(context, "", curr_bb);
-    llvm::BasicBlock *false_bb = llvm::BasicBlock::Create(context);
-    llvm::BasicBlock *continue_bb = llvm::BasicBlock::Create(context);
-
-    node.if_case->accept(*this);
-    llvm::Value *if_cond = builder.CreateICmpNE(
-        shared_llvm_value,
-        llvm::ConstantInt::get(context, llvm::APInt(1, 0, true))
-    );
-    builder.CreateCondBr(if_cond, true_bb, false_bb);
+    error_stream.flush();
+    USER_ERR("%s%s", error_message, errors.c_str());
+    return false;
+}
 
-    builder.SetInsertPoint(true_bb);
-    node.true_expr->accept(*this);
-    builder.CreateBr(continue_bb);
+bool LLVMBuilder::optimizeModule()
+{
+    if (options.opt_level == 0)
+    {
+        return true;
+    }
+
+    static const llvm::OptimizationLevel opt_levels[] = {
+        llvm::OptimizationLevel::O0,
+        llvm::OptimizationLevel::O1,
+        llvm::OptimizationLevel::O2,
+        llvm::OptimizationLevel::O3
+    };
+    DEV_ASSERT(options.opt_level >= sizeof(opt_levels) / sizeof(opt_levels[0]));
+
+    TimeReport_t::Scope_t optimize_scope(time_report, "llvm_optimize");
+
+    // Has to be set before StandardInstrumentations creates its timers. It is
+    // process wide and modules are optimized on several threads in --batch,
+    // --serve and chunk builds, which all reject pass timing, so it is only
+    // ever written by a single-threaded compile.
+    if (options.time_passes)
+    {
+        llvm::TimePassesIsEnabled = true;
+    }
+
+    llvm::LoopAnalysisManager loop_manager;
+    llvm::FunctionAnalysisManager function_manager;
+    llvm::CGSCCAnalysisManager cgscc_manager;
+    llvm::ModuleAnalysisManager module_manager;
+
+    llvm::PassInstrumentationCallbacks instrumentation;
+    llvm::StandardInstrumentations standard_instrumentation(*context, false);
+    standard_instrumentation.registerCallbacks(instrumentation, &module_manager);
 
-    curr_bb->insert(curr_bb->end(), false_bb);
-    builder.SetInsertPoint(false_bb);
-    node.false_expr->accept(*this);
-    builder.CreateBr(continue_bb);
+    llvm::PassBuilder pass_builder(target_machine.get(), llvm::PipelineTuningOptions(), std::nullopt, &instrumentation);
+    pass_builder.registerModuleAnalyses(module_manager);
+    pass_builder.registerCGSCCAnalyses(cgscc_manager);
+    pass_builder.registerFunctionAnalyses(function_manager);
+    pass_builder.registerLoopAnalyses(loop_manager);
+    pass_builder.crossRegisterProxies(loop_manager, function_manager, cgscc_manager, module_manager);
 
-    curr_bb->insert(curr_bb->end(), continue_bb);
-    builder.SetInsertPoint(continue_bb);
+    llvm::ModulePassManager pipeline = pass_builder.buildPerModuleDefaultPipeline(opt_levels[options.opt_level]);
+    pipeline.run(*lmodule, module_manager);
+
+    if (options.time_passes)
+    {
+        llvm::reportAndResetTimings(&llvm::errs());
+    }
+
+    return checkModule("LLVM IR is broken after optimization!\n");
 }
 
-void LLVMBuilder::generateLLVMIR(const char *output_file, const ProgramNode_t &root)
+bool LLVMBuilder::createTargetMachine()
 {
-    createStdFunctions();
-    root.accept(*this);
-    
+    initializeNativeTarget();
+
+    const std::string triple = llvm::sys::getDefaultTargetTriple();
+
+    std::string error;
+    const llvm::Target *target = llvm::TargetRegistry::lookupTarget(triple, error);
+    if (target == nullptr)
+    {
+        USER_ERR("Unsupported target %s: %s\n", triple.c_str(), error.c_str());
+        return false;
+    }
+
+    static const llvm::CodeGenOptLevel codegen_levels[] = {
+        llvm::CodeGenOptLevel::None,
+        llvm::CodeGenOptLevel::Less,
+        llvm::CodeGenOptLevel::Default,
+        llvm::CodeGenOptLevel::Aggressive
+    };
+    DEV_ASSERT(options.opt_level >= sizeof(codegen_levels) / sizeof(codegen_levels[0]));
+
+    target_machine.reset(target->createTargetMachine(
+        triple,
+        llvm::sys::getHostCPUName(),
+        "",
+        llvm::TargetOptions(),
+        llvm::Reloc::PIC_,
+        std::nullopt,
+        codegen_levels[options.opt_level]
+    ));
+    if (target_machine == nullptr)
+    {
+        USER_ERR("Failed to create target machine for %s\n", triple.c_str());
+        return false;
+    }
+
+    lmodule->setTargetTriple(triple);
+    lmodule->setDataLayout(target_machine->createDataLayout());
+    return true;
+}
+
+bool LLVMBuilder::emitObjectCode(llvm::raw_pwrite_stream &output_stream)
+{
+    const llvm::CodeGenFileType file_type = options.emit_kind == EmitKind::ASM ?
+        llvm::CodeGenFileType::AssemblyFile :
+        llvm::CodeGenFileType::ObjectFile;
+
+    llvm::legacy::PassManager codegen_passes;
+    if (target_machine->addPassesToEmitFile(codegen_passes, output_stream, nullptr, file_type))
+    {
+        USER_ERR("Target %s cannot emit this file type\n", lmodule->getTargetTriple().c_str());
+        return false;
+    }
+
+    codegen_passes.run(*lmodule);
+    return true;
+}
+
+bool LLVMBuilder::generateLLVMIR(const char *output_file, const FlatAst_t &program)
+{
+    if (!buildModule(program))
+    {
+        return false;
+    }
+
+    if (!chunks.empty())
+    {
+        // Assembly of the chunks can not be joined as text, their local
+        // labels clash, so it is generated from the linked module.
+        if (options.emit_kind == EmitKind::OBJ)
+        {
+            return buildChunks(program, true) && writeChunkArchive(output_file);
+        }
+        if (!buildChunks(program, false) || !linkChunks())
+        {
+            return false;
+        }
+    }
+
+    const bool is_text = options.emit_kind == EmitKind::LL || options.emit_kind == EmitKind::ASM;
+
     std::error_code err_code;
-    llvm::raw_fd_ostream llvm_out_stream(output_file, err_code);
-    lmodule.print(llvm_out_stream, nullptr);
+    llvm::raw_fd_ostream llvm_out_stream(output_file, err_code, is_text ? llvm::sys::fs::OF_Text : llvm::sys::fs::OF_None);
+    if (err_code)
+    {
+        USER_ERR("Cannot open file %s: %s\n", output_file, err_code.message().c_str());
+        return false;
+    }
+
+    TimeReport_t::Scope_t emit_scope(time_report, "llvm_emit");
+    bool is_success = true;
+    switch (options.emit_kind)
+    {
+    case EmitKind::LL:
+        lmodule->print(llvm_out_stream, nullptr);
+        break;
+    case EmitKind::BC:
+        llvm::WriteBitcodeToFile(*lmodule, llvm_out_stream);
+        break;
+    case EmitKind::ASM:
+    case EmitKind::OBJ:
+        is_success = emitObjectCode(llvm_out_stream);
+        break;
+    default:
+        DEV_ASSERT(true);
+        break;
+    }
+    llvm_out_stream.flush();
+
+    if (llvm_out_stream.has_error())
+    {
+        USER_ERR("Failed to write %s: %s\n", output_file, llvm_out_stream.error().message().c_str());
+        llvm_out_stream.clear_error();
+        return false;
+    }
+    return is_success;
+}
 
-    printf("Generator error code = %s\n", err_code.message().c_str());
+std::string LLVMBuilder::describeOutput() const
+{
+    // The host CPU decides instruction selection for asm and obj.
+    std::string description = std::string("llvm ") + LLVM_VERSION_STRING +
+           " triple " + llvm::sys::getDefaultTargetTriple() +
+           " cpu " + llvm::sys::getHostCPUName().str() +
+           " O" + std::to_string(options.opt_level) +
+           " emit " + std::to_string(static_cast<int>(options.emit_kind));
+    if (options.codegen_chunks > 1)
+    {
+        description += " chunks " + std::to_string(options.codegen_chunks);
+    }
+    return description;
+}
+
+bool LLVMBuilder::runJIT(const FlatAst_t &program)
+{
+    using Clock_t = std::chrono::steady_clock;
+
+    if (!buildModule(program) || !buildChunks(program, true))
+    {
+        return false;
+    }
+
+    initializeNativeTarget();
+
+    auto jit = llvm::orc::LLJITBuilder().create();
+    if (!jit)
+    {
+        USER_ERR("Failed to create JIT: %s\n", llvm::toString(jit.takeError()).c_str());
+        return false;
+    }
+
+    // The output runtime is linked into the compiler itself, hand its
+    // functions to the JIT directly instead of searching the process.
+    llvm::orc::MangleAndInterner mangle((*jit)->getExecutionSession(), (*jit)->getDataLayout());
+    const llvm::JITSymbolFlags runtime_flags = llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable;
+    llvm::orc::SymbolMap runtime_symbols;
+    runtime_symbols[mangle(PRINT_FUNC_NAME)] = llvm::orc::ExecutorSymbolDef(
+        llvm::orc::ExecutorAddr::fromPtr(&mipt_print_i64), runtime_flags
+    );
+    runtime_symbols[mangle(FLUSH_FUNC_NAME)] = llvm::orc::ExecutorSymbolDef(
+        llvm::orc::ExecutorAddr::fromPtr(&mipt_flush_output), runtime_flags
+    );
+    // The backend lowers big memsets, zeroing of arrays, to libc calls.
+    runtime_symbols[mangle("memset")] = llvm::orc::ExecutorSymbolDef(
+        llvm::orc::ExecutorAddr::fromPtr(&memset), runtime_flags
+    );
+    if (auto err = (*jit)->getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(runtime_symbols))))
+    {
+        USER_ERR("Failed to expose runtime to JIT: %s\n", llvm::toString(std::move(err)).c_str());
+        return false;
+    }
+
+    lmodule->setDataLayout((*jit)->getDataLayout());
+
+    // The module and its context now belong to the JIT.
+    llvm::orc::ThreadSafeModule jit_module(std::move(lmodule), std::move(context));
+
+    const auto compile_start = Clock_t::now();
+    if (auto err = (*jit)->addIRModule(std::move(jit_module)))
+    {
+        USER_ERR("Failed to add module to JIT: %s\n", llvm::toString(std::move(err)).c_str());
+        return false;
+    }
+
+    // Chunks have been compiled on the thread pool, the JIT only links them.
+    for (const Chunk_t &chunk : chunks)
+    {
+        const llvm::StringRef code(chunk.code.data(), chunk.code.size());
+        if (auto err = (*jit)->addObjectFile(llvm::MemoryBuffer::getMemBufferCopy(code, chunk.name)))
+        {
+            USER_ERR("Failed to add %s to JIT: %s\n", chunk.name.c_str(), llvm::toString(std::move(err)).c_str());
+            return false;
+        }
+    }
+
+    auto main_symbol = (*jit)->lookup("main");
+    if (!main_symbol)
+    {
+        USER_ERR("Failed to compile main: %s\n", llvm::toString(main_symbol.takeError()).c_str());
+        return false;
+    }
+    const auto compile_end = Clock_t::now();
+
+    // Anything the compiler has printed so far has to reach stdout
+    // before the program output, which bypasses stdio.
+    fflush(stdout);
+    OutputBuffer_t &output = runtimeOutput();
+    const int previous_fd = output.getFd();
+    output.setFd(output_fd);
+
+    auto *main_func = main_symbol->toPtr<void()>();
+    main_func();
+    output.setFd(previous_fd);
+    const auto run_end = Clock_t::now();
+
+    using Ms_t = std::chrono::duration<double, std::milli>;
+    if (time_report != nullptr)
+    {
+        time_report->addPhase("jit_compile", Ms_t(compile_end - compile_start).count());
+        time_report->addPhase("jit_run", Ms_t(run_end - compile_end).count());
+    }
+    else
+    {
+        logPrint("JIT compile time: %.3f ms\n", Ms_t(compile_end - compile_start).count());
+        logPrint("JIT run time: %.3f ms\n", Ms_t(run_end - compile_end).count());
+    }
+
+    return true;
 }
 
 void LLVMBuilder::createPrintFunction()
 {
     std::vector<llvm::Type*> argv_types = {
-        llvm::Type::getInt8Ty(context)->getPointerTo()
+        llvm::Type::getInt64Ty(*context)
     };
-    llvm::FunctionType *func_type = llvm::FunctionType::get(llvm::FunctionType::getInt32Ty(context), argv_types, true);
+    llvm::FunctionType *func_type = llvm::FunctionType::get(llvm::Type::getVoidTy(*context), argv_types, false);
+
+    auto func_ptr = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, PRINT_FUNC_NAME, *lmodule);
+    func_ptr->setCallingConv(llvm::CallingConv::C);
+}
+
+void LLVMBuilder::createFlushFunction()
+{
+    llvm::FunctionType *func_type = llvm::FunctionType::get(llvm::Type::getVoidTy(*context), false);
 
-    auto func_ptr = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, "printf", lmodule);
+    auto func_ptr = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, FLUSH_FUNC_NAME, *lmodule);
     func_ptr->setCallingConv(llvm::CallingConv::C);
 }
 
 void LLVMBuilder::createStdFunctions()
 {
     createPrintFunction();
+    createFlushFunction();
 }
@@ -1,46 +1,207 @@
 #pragma once
 
 #include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Target/TargetMachine.h>
 
-#include <map>
+#include <memory>
+#include <string>
+#include <vector>
 
-#include "ast.hpp"
-#include "visitor.hpp"
+#include "flatAst.hpp"
+#include "timeReport.hpp"
 
-class LLVMBuilder : public Visitor
+enum class EmitKind
+{
+    LL,
+    BC,
+    ASM,
+    OBJ
+};
+
+struct CodegenOptions_t
+{
+    unsigned opt_level = 0;
+    bool time_passes = false;
+    EmitKind emit_kind = EmitKind::LL;
+    // Splits the top-level statements into this many functions, each one
+    // built, optimized and compiled in a module of its own on its own thread.
+    // 0 and 1 keep the whole program in main. Can not be combined with
+    // time_passes, pass timers are process wide.
+    size_t codegen_chunks = 0;
+};
+
+// Generates LLVM IR from a FlatAst_t, walking the node array forward just
+// like Interpreter does.
+class LLVMBuilder
 {
 private:
-    llvm::LLVMContext context;
-    llvm::Module lmodule;
+    std::unique_ptr<llvm::LLVMContext> context;
+    std::unique_ptr<llvm::Module> lmodule;
     llvm::IRBuilder<> builder;
-    std::map<std::string, llvm::AllocaInst*> values;
+    std::unique_ptr<llvm::TargetMachine> target_machine;
+    bool is_module_built;
+    CodegenOptions_t options;
+    int output_fd;
+    TimeReport_t *time_report;
+    // SSA is built while generating: the current definition of every
+    // variable slot, nullptr for array elements.
+    std::vector<llvm::Value*> values;
+    // Where the elements of an array are: an internal global of its own,
+    // or its slots of the state when the program is split into chunks.
+    struct ArrayStorage_t
+    {
+        llvm::Value *elements;
+        llvm::ArrayType *type;
+        llvm::Align align;
+    };
+
+    // By ArrayId_t.
+    std::vector<ArrayStorage_t> arrays;
+    // Shared by every failed index check, created on first use.
+    llvm::BasicBlock *trap_bb;
+
+    struct Definition_t
+    {
+        uint32_t slot;
+        llvm::Value *value;
+    };
+
+    // A definition replaced inside the arm being generated, the arm it was
+    // logged in is restored along with it.
+    struct ShadowedValue_t
+    {
+        uint32_t slot;
+        uint32_t assigned_in;
+        llvm::Value *value;
+    };
 
-    llvm::Value *shared_llvm_value = nullptr;
+    // Every arm (a branch of an if, a loop body) logs a slot the first time
+    // it assigns it, so the definitions at the arm start can be restored and
+    // joined with the ones at its end. 0 is the top level, which logs nothing.
+    std::vector<uint32_t> assigned_in;
+    std::vector<ShadowedValue_t> shadowed;
+    uint32_t arm;
+    uint32_t arms_count;
+
+    // When generation reaches at, the branch being generated ends: an if
+    // continues in continue_bb, an if/else first goes on to its false_bb,
+    // a loop body goes through its latch back to header_bb.
+    // The join block also has an edge from incoming_bb, with definitions
+    // that differ from those at the arm start: the end of the true arm of
+    // an if/else. A loop keeps its header phis there instead.
+    struct PendingBranch_t
+    {
+        uint32_t at;
+        uint32_t end;
+        llvm::BasicBlock *false_bb;
+        llvm::BasicBlock *continue_bb;
+        llvm::BasicBlock *header_bb;
+        llvm::BasicBlock *incoming_bb;
+        std::vector<Definition_t> definitions;
+        size_t shadowed_start;
+        uint32_t outer_arm;
+    };
+
+    // Values of the generated subexpressions, operands are popped by their parent.
+    std::vector<llvm::Value*> operands;
+    // Operators whose operands are being generated.
+    std::vector<uint32_t> operators;
+    std::vector<PendingBranch_t> branches;
+
+    // A && or || whose right operand is being generated: left_end_bb is
+    // where the left one branched off to merge_bb.
+    struct ShortCircuit_t
+    {
+        llvm::BasicBlock *left_end_bb;
+        llvm::BasicBlock *merge_bb;
+    };
+
+    std::vector<ShortCircuit_t> short_circuits;
+
+    // Top-level statements [first, end) of a split program, generated as
+    // function name in a module of its own. Variables are passed to it in
+    // the state, an array of all variable slots. code is its optimized
+    // module as bitcode or as object code.
+    struct Chunk_t
+    {
+        uint32_t first;
+        uint32_t end;
+        std::string name;
+        llvm::SmallVector<char, 0> code;
+        bool is_built;
+    };
+
+    // Empty unless the program is split, and once the chunks are linked
+    // back into the module.
+    std::vector<Chunk_t> chunks;
+    bool are_chunks_objects;
 
 public:
     explicit LLVMBuilder();
 
-    void visit(const ProgramNode_t &node) override;
-    void visit(const VariableNode_t &node) override;
-    void visit(const ValueNode_t &node) override;
-    void visit(const AndNode_t &node) override;
-    void visit(const OrNode_t &node) override;
-    void visit(const ComparatorNode_t &node) override;
-    void visit(const ArithmeticNode_t &node) override;
-    void visit(const NotNode_t &node) override;
-    void visit(const NopRuleNode_t &node) override;
-    void visit(const AssignNode_t &node) override;
-    void visit(const DeclareNode_t &node) override;
-    void visit(const PrintNode_t &node) override;
-    void visit(const IfNode_t &node) override;
-    void visit(const IfElseNode_t &node) override;
-
-    void generateLLVMIR(const char *output_file, const ProgramNode_t &root);
+    void setOptions(const CodegenOptions_t &options_)
+    {
+        options = options_;
+    }
+
+    void setTimeReport(TimeReport_t *report)
+    {
+        time_report = report;
+    }
+
+    // Where the program run by runJIT() prints to.
+    void setOutputFd(const int fd)
+    {
+        output_fd = fd;
+    }
+
+    bool generateLLVMIR(const char *output_file, const FlatAst_t &program);
+    // Everything besides the program that the file written by generateLLVMIR()
+    // depends on, for keying cached outputs.
+    std::string describeOutput() const;
+    // Compiles the program in-process with ORC LLJIT and runs its main.
+    // The module is handed over to the JIT, so this has to be the last use.
+    bool runJIT(const FlatAst_t &program);
 
 private:
+    bool createTargetMachine();
+    bool buildModule(const FlatAst_t &program);
+    void generateProgram(const FlatAst_t &program);
+    void startFunction(const FlatAst_t &program, llvm::Function *func);
+    void generateStatements(const FlatAst_t &program, uint32_t first, uint32_t end);
+    void splitProgram(const FlatAst_t &program);
+    void generateChunkCalls(const FlatAst_t &program);
+    void generateChunk(const FlatAst_t &program, const Chunk_t &chunk);
+    bool buildChunk(const FlatAst_t &program, Chunk_t &chunk);
+    bool buildChunks(const FlatAst_t &program, bool is_object);
+    bool linkChunks();
+    bool writeChunkArchive(const char *output_file);
+    llvm::Value *generateExpression(const FlatAst_t &program, uint32_t first);
+    void generateOperator(const FlatNode_t &node);
+    llvm::Value *generateBinary(FlatTag_t tag, llvm::Value *left, llvm::Value *right);
+    llvm::Value *generateElementPointer(uint32_t array, llvm::Value *index);
+    void generateArrayOperation(FlatTag_t tag, uint32_t dst, uint32_t left, uint32_t right);
+    void startShortCircuit(FlatTag_t tag);
+    llvm::Value *finishShortCircuit(FlatTag_t tag);
+    void endBranch();
+    void assignVariable(uint32_t slot, llvm::Value *value);
+    void startArm(PendingBranch_t &branch);
+    void createLoopPhis(const FlatAst_t &program, uint32_t loop, llvm::BasicBlock *preheader_bb);
+    void finishLoop(PendingBranch_t &branch, llvm::BasicBlock *latch_bb);
+    void joinArms(PendingBranch_t &branch, llvm::BasicBlock *arm_end_bb);
+    void setLoopMetadata(llvm::BranchInst *back_edge);
+    bool optimizeModule();
+    bool checkModule(const char *error_message);
+    bool emitObjectCode(llvm::raw_pwrite_stream &output_stream);
+    llvm::Value *toBool(llvm::Value *value);
+    llvm::Value *toValue(llvm::Value *condition);
+    llvm::Value *popOperand();
     void createPrintFunction();
+    void createFlushFunction();
     void createStdFunctions();
 };
@@ -0,0 +1,283 @@
+#include "nameResolver.hpp"
+#include "log.hpp"
+
+VariableSlot_t NameResolver::lookup(const std::string_view name)
+{
+    const auto symbol = symbols.find(std::string(name));
+    if (symbol == symbols.end())
+    {
+        USER_ERR("Variable (%s) was not created!\n", name.data());
+        is_resolved = false;
+        return UNRESOLVED_SLOT;
+    }
+    if (symbol->second.array != UNRESOLVED_ARRAY)
+    {
+        USER_ERR("Array (%s) is used without an index!\n", name.data());
+        is_resolved = false;
+        return UNRESOLVED_SLOT;
+    }
+
+    return symbol->second.slot;
+}
+
+ArrayId_t NameResolver::lookupArray(const std::string_view name)
+{
+    const auto symbol = symbols.find(std::string(name));
+    if (symbol == symbols.end())
+    {
+        USER_ERR("Array (%s) was not created!\n", name.data());
+        is_resolved = false;
+        return UNRESOLVED_ARRAY;
+    }
+    if (symbol->second.array == UNRESOLVED_ARRAY)
+    {
+        USER_ERR("Variable (%s) is not an array!\n", name.data());
+        is_resolved = false;
+        return UNRESOLVED_ARRAY;
+    }
+
+    return symbol->second.array;
+}
+
+bool NameResolver::visit(const ProgramNode_t &node, const size_t step)
+{
+    for (const auto child : node.children_vec)
+    {
+        walker.schedule(child);
+    }
+    return false;
+}
+
+bool NameResolver::visit(const VariableNode_t &node, const size_t step)
+{
+    node.slot = lookup(node.name);
+    return false;
+}
+
+bool NameResolver::visit(const ValueNode_t &node, const size_t step)
+{
+    return false;
+}
+
+bool NameResolver::visit(const AndNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.left == nullptr);
+    DEV_ASSERT(node.right == nullptr);
+
+    walker.schedule(node.left);
+    walker.schedule(node.right);
+    return false;
+}
+
+bool NameResolver::visit(const OrNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.left == nullptr);
+    DEV_ASSERT(node.right == nullptr);
+
+    walker.schedule(node.left);
+    walker.schedule(node.right);
+    return false;
+}
+
+bool NameResolver::visit(const ComparatorNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.left == nullptr);
+    DEV_ASSERT(node.right == nullptr);
+
+    walker.schedule(node.left);
+    walker.schedule(node.right);
+    return false;
+}
+
+bool NameResolver::visit(const ArithmeticNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.left == nullptr);
+    DEV_ASSERT(node.right == nullptr);
+
+    walker.schedule(node.left);
+    walker.schedule(node.right);
+    return false;
+}
+
+bool NameResolver::visit(const NotNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.child == nullptr);
+
+    walker.schedule(node.child);
+    return false;
+}
+
+bool NameResolver::visit(const NopRuleNode_t &node, const size_t step)
+{
+    for (const auto child : node.children_vec)
+    {
+        walker.schedule(child);
+    }
+    return false;
+}
+
+bool NameResolver::visit(const AssignNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.value == nullptr);
+
+    if (step == 0)
+    {
+        walker.schedule(node.value);
+        return true;
+    }
+
+    node.slot = lookup(node.name);
+    return false;
+}
+
+bool NameResolver::visit(const DeclareNode_t &node, const size_t step)
+{
+    // Redeclaration reuses the slot, just like the old name-keyed map did.
+    const auto [symbol, is_new] = symbols.try_emplace(std::string(node.name), Symbol_t{variables_count, UNRESOLVED_ARRAY});
+    if (is_new)
+    {
+        ++variables_count;
+    }
+    else if (symbol->second.array != UNRESOLVED_ARRAY)
+    {
+        USER_ERR("Array (%s) is redeclared as a variable!\n", node.name.data());
+        is_resolved = false;
+    }
+
+    node.slot = symbol->second.slot;
+    return false;
+}
+
+bool NameResolver::visit(const PrintNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.child == nullptr);
+
+    walker.schedule(node.child);
+    return false;
+}
+
+bool NameResolver::visit(const IfNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.if_case == nullptr);
+    DEV_ASSERT(node.expr == nullptr);
+
+    walker.schedule(node.if_case);
+    walker.schedule(node.expr);
+    return false;
+}
+
+bool NameResolver::visit(const IfElseNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.if_case == nullptr);
+    DEV_ASSERT(node.true_expr == nullptr);
+    DEV_ASSERT(node.false_expr == nullptr);
+
+    walker.schedule(node.if_case);
+    walker.schedule(node.true_expr);
+    walker.schedule(node.false_expr);
+    return false;
+}
+
+bool NameResolver::visit(const WhileNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.condition == nullptr);
+    DEV_ASSERT(node.body == nullptr);
+
+    walker.schedule(node.condition);
+    walker.schedule(node.body);
+    return false;
+}
+
+bool NameResolver::visit(const ArrayDeclareNode_t &node, const size_t step)
+{
+    if (node.size <= 0 || node.size > MAX_ARRAY_SIZE)
+    {
+        USER_ERR("Array (%s) size %lld is not in [1, %lld]!\n",
+            node.name.data(), static_cast<long long>(node.size), static_cast<long long>(MAX_ARRAY_SIZE));
+        is_resolved = false;
+        return false;
+    }
+
+    const size_t size = static_cast<size_t>(node.size);
+    const auto [symbol, is_new] = symbols.try_emplace(std::string(node.name), Symbol_t{variables_count, program->arrays.size()});
+    if (is_new)
+    {
+        program->arrays.push_back({variables_count, size});
+        variables_count += size;
+    }
+    else if (symbol->second.array == UNRESOLVED_ARRAY || program->arrays[symbol->second.array].size != size)
+    {
+        // The elements were laid out for the first declaration.
+        USER_ERR("Variable (%s) is redeclared as an array of another size!\n", node.name.data());
+        is_resolved = false;
+        return false;
+    }
+
+    node.array = symbol->second.array;
+    return false;
+}
+
+bool NameResolver::visit(const ElementNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.index == nullptr);
+
+    walker.schedule(node.index);
+    node.array = lookupArray(node.name);
+    return false;
+}
+
+bool NameResolver::visit(const ElementAssignNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.index == nullptr);
+    DEV_ASSERT(node.value == nullptr);
+
+    if (step == 0)
+    {
+        walker.schedule(node.index);
+        walker.schedule(node.value);
+        return true;
+    }
+
+    node.array = lookupArray(node.name);
+    return false;
+}
+
+bool NameResolver::visit(const ArrayAssignNode_t &node, const size_t step)
+{
+    node.array = lookupArray(node.name);
+    node.left = lookupArray(node.left_name);
+    node.right = lookupArray(node.right_name);
+    if (node.array == UNRESOLVED_ARRAY || node.left == UNRESOLVED_ARRAY || node.right == UNRESOLVED_ARRAY)
+    {
+        return false;
+    }
+
+    const size_t size = program->arrays[node.array].size;
+    if (program->arrays[node.left].size != size || program->arrays[node.right].size != size)
+    {
+        USER_ERR("Arrays (%s), (%s) and (%s) differ in size!\n",
+            node.name.data(), node.left_name.data(), node.right_name.data());
+        is_resolved = false;
+    }
+    return false;
+}
+
+bool NameResolver::resolve(ProgramNode_t &root)
+{
+    program = &root;
+    walker.walk(*this, root);
+    root.variables_count = variables_count;
+    program = nullptr;
+
+    return is_resolved;
+}
+
+bool NameResolver::resolveStatement(const RuleNode_t &statement, ProgramNode_t &root)
+{
+    program = &root;
+    walker.walk(*this, statement);
+    root.variables_count = variables_count;
+    program = nullptr;
+
+    return is_resolved;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "ast.hpp"
+#include "astWalker.hpp"
+#include "visitor.hpp"
+
+// Interns variable names into dense slot indices and stores them in the
+// nodes, so backends never look variables up by name. Arrays get a run of
+// slots for their elements and an entry in ProgramNode_t::arrays.
+class NameResolver : public Visitor
+{
+private:
+    struct Symbol_t
+    {
+        VariableSlot_t slot;
+        // UNRESOLVED_ARRAY for scalars.
+        ArrayId_t array;
+    };
+
+    std::unordered_map<std::string, Symbol_t> symbols;
+    size_t variables_count;
+    ProgramNode_t *program;
+    bool is_resolved;
+    AstWalker_t walker;
+
+public:
+    explicit NameResolver()
+        :
+            variables_count(0),
+            program(nullptr),
+            is_resolved(true)
+    {}
+
+    bool visit(const ProgramNode_t &node, size_t step);
+    bool visit(const VariableNode_t &node, size_t step);
+    bool visit(const ValueNode_t &node, size_t step);
+    bool visit(const AndNode_t &node, size_t step);
+    bool visit(const OrNode_t &node, size_t step);
+    bool visit(const ComparatorNode_t &node, size_t step);
+    bool visit(const ArithmeticNode_t &node, size_t step);
+    bool visit(const NotNode_t &node, size_t step);
+    bool visit(const NopRuleNode_t &node, size_t step);
+    bool visit(const AssignNode_t &node, size_t step);
+    bool visit(const DeclareNode_t &node, size_t step);
+    bool visit(const PrintNode_t &node, size_t step);
+    bool visit(const IfNode_t &node, size_t step);
+    bool visit(const IfElseNode_t &node, size_t step);
+    bool visit(const WhileNode_t &node, size_t step);
+    bool visit(const ArrayDeclareNode_t &node, size_t step);
+    bool visit(const ElementNode_t &node, size_t step);
+    bool visit(const ElementAssignNode_t &node, size_t step);
+    bool visit(const ArrayAssignNode_t &node, size_t step);
+
+    bool resolve(ProgramNode_t &root);
+    // Resolves one statement of a program that is still being parsed,
+    // names declared by earlier statements stay visible.
+    bool resolveStatement(const RuleNode_t &statement, ProgramNode_t &root);
+
+private:
+    VariableSlot_t lookup(const std::string_view name);
+    ArrayId_t lookupArray(const std::string_view name);
+};
@@ -0,0 +1,208 @@
+#include "log.hpp"
+#include "nodeCounter.hpp"
+
+bool NodeCounter::visit(const ProgramNode_t &node, const size_t step)
+{
+    ++counts[PROGRAM];
+    for (const auto child : node.children_vec)
+    {
+        walker.schedule(child);
+    }
+    return false;
+}
+
+bool NodeCounter::visit(const VariableNode_t &node, const size_t step)
+{
+    ++counts[VARIABLE];
+    return false;
+}
+
+bool NodeCounter::visit(const ValueNode_t &node, const size_t step)
+{
+    ++counts[VALUE];
+    return false;
+}
+
+bool NodeCounter::visit(const AndNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.left == nullptr);
+    DEV_ASSERT(node.right == nullptr);
+
+    ++counts[AND];
+    walker.schedule(node.left);
+    walker.schedule(node.right);
+    return false;
+}
+
+bool NodeCounter::visit(const OrNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.left == nullptr);
+    DEV_ASSERT(node.right == nullptr);
+
+    ++counts[OR];
+    walker.schedule(node.left);
+    walker.schedule(node.right);
+    return false;
+}
+
+bool NodeCounter::visit(const ComparatorNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.left == nullptr);
+    DEV_ASSERT(node.right == nullptr);
+
+    ++counts[COMPARATOR];
+    walker.schedule(node.left);
+    walker.schedule(node.right);
+    return false;
+}
+
+bool NodeCounter::visit(const ArithmeticNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.left == nullptr);
+    DEV_ASSERT(node.right == nullptr);
+
+    ++counts[ARITHMETIC];
+    walker.schedule(node.left);
+    walker.schedule(node.right);
+    return false;
+}
+
+bool NodeCounter::visit(const NotNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.child == nullptr);
+
+    ++counts[NOT];
+    walker.schedule(node.child);
+    return false;
+}
+
+bool NodeCounter::visit(const NopRuleNode_t &node, const size_t step)
+{
+    ++counts[NOP_RULE];
+    for (const auto child : node.children_vec)
+    {
+        walker.schedule(child);
+    }
+    return false;
+}
+
+bool NodeCounter::visit(const AssignNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.value == nullptr);
+
+    ++counts[ASSIGN];
+    walker.schedule(node.value);
+    return false;
+}
+
+bool NodeCounter::visit(const DeclareNode_t &node, const size_t step)
+{
+    ++counts[DECLARE];
+    return false;
+}
+
+bool NodeCounter::visit(const PrintNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.child == nullptr);
+
+    ++counts[PRINT];
+    walker.schedule(node.child);
+    return false;
+}
+
+bool NodeCounter::visit(const IfNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.if_case == nullptr);
+    DEV_ASSERT(node.expr == nullptr);
+
+    ++counts[IF];
+    walker.schedule(node.if_case);
+    walker.schedule(node.expr);
+    return false;
+}
+
+bool NodeCounter::visit(const IfElseNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.if_case == nullptr);
+    DEV_ASSERT(node.true_expr == nullptr);
+    DEV_ASSERT(node.false_expr == nullptr);
+
+    ++counts[IF_ELSE];
+    walker.schedule(node.if_case);
+    walker.schedule(node.true_expr);
+    walker.schedule(node.false_expr);
+    return false;
+}
+
+bool NodeCounter::visit(const WhileNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.condition == nullptr);
+    DEV_ASSERT(node.body == nullptr);
+
+    ++counts[WHILE];
+    walker.schedule(node.condition);
+    walker.schedule(node.body);
+    return false;
+}
+
+bool NodeCounter::visit(const ArrayDeclareNode_t &node, const size_t step)
+{
+    ++counts[ARRAY_DECLARE];
+    return false;
+}
+
+bool NodeCounter::visit(const ElementNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.index == nullptr);
+
+    ++counts[ELEMENT];
+    walker.schedule(node.index);
+    return false;
+}
+
+bool NodeCounter::visit(const ElementAssignNode_t &node, const size_t step)
+{
+    DEV_ASSERT(node.index == nullptr);
+    DEV_ASSERT(node.value == nullptr);
+
+    ++counts[ELEMENT_ASSIGN];
+    walker.schedule(node.index);
+    walker.schedule(node.value);
+    return false;
+}
+
+bool NodeCounter::visit(const ArrayAssignNode_t &node, const size_t step)
+{
+    ++counts[ARRAY_ASSIGN];
+    return false;
+}
+
+void NodeCounter::count(const ProgramNode_t &root)
+{
+    for (size_t &type_count : counts)
+    {
+        type_count = 0;
+    }
+    walker.walk(*this, root);
+}
+
+void NodeCounter::countRecursive(const ProgramNode_t &root)
+{
+    for (size_t &type_count : counts)
+    {
+        type_count = 0;
+    }
+    walker.walkRecursive(*this, root);
+}
+
+const char *NodeCounter::getName(const NodeType_t type)
+{
+    static const char *const names[NODE_TYPES_COUNT] = {
+        "Program", "Variable", "Value", "And", "Or", "Comparator", "Arithmetic",
+        "Not", "NopRule", "Assign", "Declare", "Print", "If", "IfElse", "While",
+        "ArrayDeclare", "Element", "ElementAssign", "ArrayAssign"
+    };
+    DEV_ASSERT(type >= NODE_TYPES_COUNT);
+
+    return names[type];
+}
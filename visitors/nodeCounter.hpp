@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+
+#include "ast.hpp"
+#include "astWalker.hpp"
+#include "visitor.hpp"
+
+// Counts AST nodes of every type, for --time-report.
+class NodeCounter : public Visitor
+{
+public:
+    enum NodeType_t
+    {
+        PROGRAM,
+        VARIABLE,
+        VALUE,
+        AND,
+        OR,
+        COMPARATOR,
+        ARITHMETIC,
+        NOT,
+        NOP_RULE,
+        ASSIGN,
+        DECLARE,
+        PRINT,
+        IF,
+        IF_ELSE,
+        WHILE,
+        ARRAY_DECLARE,
+        ELEMENT,
+        ELEMENT_ASSIGN,
+        ARRAY_ASSIGN,
+        NODE_TYPES_COUNT
+    };
+
+private:
+    size_t counts[NODE_TYPES_COUNT];
+    AstWalker_t walker;
+
+public:
+    explicit NodeCounter()
+        :
+            counts{}
+    {}
+
+    bool visit(const ProgramNode_t &node, size_t step);
+    bool visit(const VariableNode_t &node, size_t step);
+    bool visit(const ValueNode_t &node, size_t step);
+    bool visit(const AndNode_t &node, size_t step);
+    bool visit(const OrNode_t &node, size_t step);
+    bool visit(const ComparatorNode_t &node, size_t step);
+    bool visit(const ArithmeticNode_t &node, size_t step);
+    bool visit(const NotNode_t &node, size_t step);
+    bool visit(const NopRuleNode_t &node, size_t step);
+    bool visit(const AssignNode_t &node, size_t step);
+    bool visit(const DeclareNode_t &node, size_t step);
+    bool visit(const PrintNode_t &node, size_t step);
+    bool visit(const IfNode_t &node, size_t step);
+    bool visit(const IfElseNode_t &node, size_t step);
+    bool visit(const WhileNode_t &node, size_t step);
+    bool visit(const ArrayDeclareNode_t &node, size_t step);
+    bool visit(const ElementNode_t &node, size_t step);
+    bool visit(const ElementAssignNode_t &node, size_t step);
+    bool visit(const ArrayAssignNode_t &node, size_t step);
+
+    void count(const ProgramNode_t &root);
+    // Counts by recursion instead, a baseline for the walker in compiler_bench.
+    void countRecursive(const ProgramNode_t &root);
+
+    size_t getCount(const NodeType_t type) const
+    {
+        return counts[type];
+    }
+    static const char *getName(NodeType_t type);
+};
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
 class ProgramNode_t;
 class VariableNode_t;
 class ValueNode_t;
@@ -14,7 +17,44 @@ class DeclareNode_t;
 class PrintNode_t;
 class IfNode_t;
 class IfElseNode_t;
+class WhileNode_t;
+class ArrayDeclareNode_t;
+class ElementNode_t;
+class ElementAssignNode_t;
+class ArrayAssignNode_t;
 
+enum class AstKind_t : uint8_t
+{
+    PROGRAM,
+    VARIABLE,
+    VALUE,
+    AND,
+    OR,
+    COMPARATOR,
+    ARITHMETIC,
+    NOT,
+    NOP_RULE,
+    ASSIGN,
+    DECLARE,
+    PRINT,
+    IF,
+    IF_ELSE,
+    WHILE,
+    ARRAY_DECLARE,
+    ELEMENT,
+    ELEMENT_ASSIGN,
+    ARRAY_ASSIGN
+};
+
+// Nodes are visited in steps, so that AstWalker_t can walk trees of any
+// depth without recursion. visit() is called with step 0 when a node is
+// reached; it schedules the children to visit next and returns true to be
+// called again with the next step once they are all done, or false when it
+// has finished with the node.
+//
+// Every visitor has a visit(const XNode_t &node, size_t step) overload for
+// each node type. They are not virtual: visitNode() resolves them statically
+// for the visitor type the walker is instantiated with.
 class Visitor 
 {
 public:
@@ -25,20 +65,6 @@ public:
     Visitor(Visitor&&) = delete;
     Visitor &operator=(Visitor&&) = delete;
 
-    virtual ~Visitor() = default;
-
-    virtual void visit(const ProgramNode_t &node) = 0;
-    virtual void visit(const VariableNode_t &node) = 0;
-    virtual void visit(const ValueNode_t &node) = 0;
-    virtual void visit(const AndNode_t &node) = 0;
-    virtual void visit(const OrNode_t &node) = 0;
-    virtual void visit(const ComparatorNode_t &node) = 0;
-    virtual void visit(const ArithmeticNode_t &node) = 0;
-    virtual void visit(const NotNode_t &node) = 0;
-    virtual void visit(const NopRuleNode_t &node) = 0;
-    virtual void visit(const AssignNode_t &node) = 0;
-    virtual void visit(const DeclareNode_t &node) = 0;
-    virtual void visit(const PrintNode_t &node) = 0;
-    virtual void visit(const IfNode_t &node) = 0;
-    virtual void visit(const IfElseNode_t &node) = 0;
+protected:
+    ~Visitor() = default;
 };
@@ -0,0 +1,268 @@
+#include <cstdio>
+#include <fstream>
+
+#include "bytecode.hpp"
+#include "log.hpp"
+
+// .mbc layout, all fields are little-endian uint32:
+//   magic, version, variables_count, registers_count, arrays_count,
+//   constants_count, instructions_count, then (first, size) for every array,
+//   (low, high) halves of every constant and (opcode, dst, left, right) for
+//   every instruction.
+static constexpr uint32_t MBC_MAGIC = 0x4342'4d2e; // ".MBC"
+static constexpr uint32_t MBC_VERSION = 4;
+
+static void writeWord(std::ofstream &out, const uint32_t word)
+{
+    const unsigned char bytes[4] = {
+        static_cast<unsigned char>(word),
+        static_cast<unsigned char>(word >> 8),
+        static_cast<unsigned char>(word >> 16),
+        static_cast<unsigned char>(word >> 24)
+    };
+    out.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+}
+
+static bool readWord(std::ifstream &in, uint32_t &word)
+{
+    unsigned char bytes[4] = {0};
+    if (!in.read(reinterpret_cast<char*>(bytes), sizeof(bytes)))
+    {
+        return false;
+    }
+
+    word = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    return true;
+}
+
+bool saveBytecode(const Bytecode_t &bytecode, const char *file_name)
+{
+    DEV_ASSERT(file_name == nullptr);
+
+    std::ofstream out(file_name, std::ios::binary);
+    if (!out)
+    {
+        USER_ERR("Cannot open file: %s\n", file_name);
+        return false;
+    }
+
+    writeWord(out, MBC_MAGIC);
+    writeWord(out, MBC_VERSION);
+    writeWord(out, bytecode.variables_count);
+    writeWord(out, bytecode.registers_count);
+    writeWord(out, static_cast<uint32_t>(bytecode.arrays.size()));
+    writeWord(out, static_cast<uint32_t>(bytecode.constants.size()));
+    writeWord(out, static_cast<uint32_t>(bytecode.code.size()));
+
+    for (const auto &array : bytecode.arrays)
+    {
+        writeWord(out, array.first);
+        writeWord(out, array.size);
+    }
+
+    for (const AstValue_t constant : bytecode.constants)
+    {
+        const uint64_t bits = static_cast<uint64_t>(constant);
+        writeWord(out, static_cast<uint32_t>(bits));
+        writeWord(out, static_cast<uint32_t>(bits >> 32));
+    }
+
+    for (const auto &instruction : bytecode.code)
+    {
+        writeWord(out, static_cast<uint32_t>(instruction.opcode));
+        writeWord(out, instruction.dst);
+        writeWord(out, instruction.left);
+        writeWord(out, instruction.right);
+    }
+
+    return static_cast<bool>(out);
+}
+
+bool loadBytecode(Bytecode_t &bytecode, const char *file_name)
+{
+    DEV_ASSERT(file_name == nullptr);
+
+    std::ifstream in(file_name, std::ios::binary);
+    if (!in)
+    {
+        USER_ERR("Cannot open file: %s\n", file_name);
+        return false;
+    }
+
+    uint32_t magic = 0, version = 0, arrays_count = 0, constants_count = 0, instructions_count = 0;
+    if (!readWord(in, magic) || magic != MBC_MAGIC || !readWord(in, version) || version != MBC_VERSION)
+    {
+        USER_ERR("%s is not a bytecode file of this compiler version\n", file_name);
+        return false;
+    }
+
+    if (!readWord(in, bytecode.variables_count) ||
+        !readWord(in, bytecode.registers_count) ||
+        !readWord(in, arrays_count) ||
+        !readWord(in, constants_count) ||
+        !readWord(in, instructions_count))
+    {
+        USER_ERR("Truncated bytecode file: %s\n", file_name);
+        return false;
+    }
+
+    bytecode.arrays.resize(arrays_count);
+    for (auto &array : bytecode.arrays)
+    {
+        if (!readWord(in, array.first) || !readWord(in, array.size))
+        {
+            USER_ERR("Truncated bytecode file: %s\n", file_name);
+            return false;
+        }
+    }
+
+    bytecode.constants.resize(constants_count);
+    for (auto &constant : bytecode.constants)
+    {
+        uint32_t low = 0, high = 0;
+        if (!readWord(in, low) || !readWord(in, high))
+        {
+            USER_ERR("Truncated bytecode file: %s\n", file_name);
+            return false;
+        }
+        constant = static_cast<AstValue_t>((static_cast<uint64_t>(high) << 32) | low);
+    }
+
+    bytecode.code.resize(instructions_count);
+    for (auto &instruction : bytecode.code)
+    {
+        uint32_t opcode = 0;
+        if (!readWord(in, opcode) ||
+            !readWord(in, instruction.dst) ||
+            !readWord(in, instruction.left) ||
+            !readWord(in, instruction.right))
+        {
+            USER_ERR("Truncated bytecode file: %s\n", file_name);
+            return false;
+        }
+        instruction.opcode = static_cast<Opcode>(opcode);
+    }
+
+    if (!verifyBytecode(bytecode))
+    {
+        USER_ERR("Corrupted bytecode file: %s\n", file_name);
+        return false;
+    }
+    return true;
+}
+
+// The VM only checks array indices while running, everything else it relies
+// on (register numbers, array ids and sizes, jump targets, final HALT) is
+// validated here once.
+bool verifyBytecode(const Bytecode_t &bytecode)
+{
+    const auto &code = bytecode.code;
+    if (code.empty() || code.back().opcode != Opcode::HALT)
+    {
+        return false;
+    }
+    if (bytecode.variables_count > bytecode.registers_count ||
+        bytecode.constants.size() > bytecode.registers_count - bytecode.variables_count)
+    {
+        return false;
+    }
+
+    // Elements have to be variable registers.
+    for (const auto &array : bytecode.arrays)
+    {
+        if (array.size == 0 || array.first > bytecode.variables_count || array.size > bytecode.variables_count - array.first)
+        {
+            return false;
+        }
+    }
+
+    const auto is_register = [&bytecode](const uint32_t reg) { return reg < bytecode.registers_count; };
+    const auto is_target = [&code](const uint32_t target) { return target < code.size(); };
+    const auto is_array = [&bytecode](const uint32_t array) { return array < bytecode.arrays.size(); };
+
+    for (const auto &instruction : code)
+    {
+        bool is_valid = false;
+        switch (instruction.opcode)
+        {
+        case Opcode::HALT:
+            is_valid = true;
+            break;
+        case Opcode::LOAD_CONST:
+            is_valid = is_register(instruction.dst);
+            break;
+        case Opcode::MOVE:
+        case Opcode::NOT:
+            is_valid = is_register(instruction.dst) && is_register(instruction.left);
+            break;
+        case Opcode::ADD:
+        case Opcode::SUB:
+        case Opcode::MUL:
+        case Opcode::DIV:
+        case Opcode::LESS:
+        case Opcode::LESS_OR_EQ:
+        case Opcode::MORE:
+        case Opcode::MORE_OR_EQ:
+        case Opcode::EQ:
+            is_valid = is_register(instruction.dst) &&
+                       is_register(instruction.left) &&
+                       is_register(instruction.right);
+            break;
+        case Opcode::PRINT:
+            is_valid = is_register(instruction.left);
+            break;
+        case Opcode::JUMP:
+            is_valid = is_target(instruction.dst);
+            break;
+        case Opcode::JUMP_IF_FALSE:
+            is_valid = is_target(instruction.dst) && is_register(instruction.left);
+            break;
+        case Opcode::JUMP_IF_NOT_LESS:
+        case Opcode::JUMP_IF_NOT_LESS_OR_EQ:
+        case Opcode::JUMP_IF_NOT_MORE:
+        case Opcode::JUMP_IF_NOT_MORE_OR_EQ:
+        case Opcode::JUMP_IF_NOT_EQ:
+            is_valid = is_target(instruction.dst) &&
+                       is_register(instruction.left) &&
+                       is_register(instruction.right);
+            break;
+        case Opcode::CLEAR_ARRAY:
+            is_valid = is_array(instruction.dst);
+            break;
+        case Opcode::LOAD_ELEMENT:
+            is_valid = is_register(instruction.dst) &&
+                       is_array(instruction.left) &&
+                       is_register(instruction.right);
+            break;
+        case Opcode::STORE_ELEMENT:
+            is_valid = is_array(instruction.dst) &&
+                       is_register(instruction.left) &&
+                       is_register(instruction.right);
+            break;
+        case Opcode::ARRAY_ADD:
+        case Opcode::ARRAY_SUB:
+        case Opcode::ARRAY_MUL:
+        case Opcode::ARRAY_DIV:
+        case Opcode::ARRAY_LESS:
+        case Opcode::ARRAY_LESS_OR_EQ:
+        case Opcode::ARRAY_MORE:
+        case Opcode::ARRAY_MORE_OR_EQ:
+        case Opcode::ARRAY_EQ:
+            is_valid = is_array(instruction.dst) &&
+                       is_array(instruction.left) &&
+                       is_array(instruction.right) &&
+                       bytecode.arrays[instruction.left].size == bytecode.arrays[instruction.dst].size &&
+                       bytecode.arrays[instruction.right].size == bytecode.arrays[instruction.dst].size;
+            break;
+        default:
+            break;
+        }
+
+        if (!is_valid)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ast.hpp"
+
+// Register bytecode executed by VirtualMachine. Registers [0, variables_count)
+// hold the program variables (indexed by slot), the last constants.size()
+// registers hold the constants, the rest are temporaries. Array operands
+// are indices in Bytecode_t::arrays.
+enum class Opcode : uint32_t
+{
+    HALT,
+    LOAD_CONST,     // dst = (right << 32) | left
+    MOVE,           // dst = left
+    ADD,            // dst = left + right
+    SUB,
+    MUL,
+    DIV,
+    LESS,
+    LESS_OR_EQ,
+    MORE,
+    MORE_OR_EQ,
+    EQ,
+    NOT,            // dst = !left
+    PRINT,          // print left
+    JUMP,           // pc = dst
+    JUMP_IF_FALSE,  // if (!left) pc = dst
+    JUMP_IF_NOT_LESS,       // if (!(left < right)) pc = dst
+    JUMP_IF_NOT_LESS_OR_EQ,
+    JUMP_IF_NOT_MORE,
+    JUMP_IF_NOT_MORE_OR_EQ,
+    JUMP_IF_NOT_EQ,
+    CLEAR_ARRAY,    // arrays[dst] = 0
+    LOAD_ELEMENT,   // dst = arrays[left][right]
+    STORE_ELEMENT,  // arrays[dst][right] = left
+    ARRAY_ADD,      // arrays[dst] = arrays[left] + arrays[right] element-wise
+    ARRAY_SUB,
+    ARRAY_MUL,
+    ARRAY_DIV,
+    ARRAY_LESS,
+    ARRAY_LESS_OR_EQ,
+    ARRAY_MORE,
+    ARRAY_MORE_OR_EQ,
+    ARRAY_EQ,
+
+    OPCODES_COUNT
+};
+
+struct Instruction_t
+{
+    Opcode opcode;
+    uint32_t dst;
+    uint32_t left;
+    uint32_t right;
+};
+
+// Elements of an array are the registers [first, first + size).
+struct BytecodeArray_t
+{
+    uint32_t first;
+    uint32_t size;
+};
+
+struct Bytecode_t
+{
+    std::vector<Instruction_t> code;
+    std::vector<BytecodeArray_t> arrays;
+    // Loaded into their registers once before the code runs.
+    std::vector<AstValue_t> constants;
+    uint32_t variables_count = 0;
+    uint32_t registers_count = 0;
+};
+
+bool saveBytecode(const Bytecode_t &bytecode, const char *file_name);
+bool loadBytecode(Bytecode_t &bytecode, const char *file_name);
+bool verifyBytecode(const Bytecode_t &bytecode);
@@ -0,0 +1,193 @@
+#include <algorithm>
+
+#include "arrayKernels.hpp"
+#include "log.hpp"
+#include "vm.hpp"
+
+#if defined(__GNUC__)
+#define VM_COMPUTED_GOTO
+#endif
+
+#if defined(VM_COMPUTED_GOTO)
+
+#define VM_DISPATCH()  goto *dispatch_table[static_cast<uint32_t>(pc->opcode)]
+#define VM_CASE(name)  op_##name:
+#define VM_NEXT()      ++pc; VM_DISPATCH()
+#define VM_JUMP()      VM_DISPATCH()
+
+#else
+
+#define VM_DISPATCH()  switch (pc->opcode)
+#define VM_CASE(name)  case Opcode::name:
+#define VM_NEXT()      ++pc; continue
+#define VM_JUMP()      continue
+
+#endif
+
+#define VM_ARRAY_CASE(OPER)                                                     \
+    VM_CASE(ARRAY_##OPER)                                                       \
+        applyArrayOperator(                                                     \
+            ArrayOperator_t::OPER, reg + arrays[pc->dst].first,                 \
+            reg + arrays[pc->left].first, reg + arrays[pc->right].first,        \
+            arrays[pc->dst].size                                                \
+        );                                                                      \
+        VM_NEXT();
+
+// Register of array[index]. Indices are the only thing checked while running,
+// output printed before a bad access is flushed before aborting.
+static inline uint32_t elementRegister(const BytecodeArray_t &array, const AstValue_t index, OutputBuffer_t &output)
+{
+    if (index < 0 || static_cast<uint64_t>(index) >= array.size)
+    {
+        output.flush();
+        USER_ABORT("Index %lld is out of bounds of an array of size %u\n", static_cast<long long>(index), array.size);
+    }
+    return array.first + static_cast<uint32_t>(index);
+}
+
+void VirtualMachine::run(const Bytecode_t &bytecode)
+{
+    DEV_ASSERT(bytecode.code.empty());
+
+    registers.assign(bytecode.registers_count, 0);
+    std::copy(bytecode.constants.begin(), bytecode.constants.end(), registers.end() - bytecode.constants.size());
+
+    AstValue_t *const reg = registers.data();
+    const Instruction_t *const code = bytecode.code.data();
+    const BytecodeArray_t *const arrays = bytecode.arrays.data();
+    const Instruction_t *pc = code;
+
+#if defined(VM_COMPUTED_GOTO)
+    static const void *const dispatch_table[] = {
+        &&op_HALT,
+        &&op_LOAD_CONST,
+        &&op_MOVE,
+        &&op_ADD,
+        &&op_SUB,
+        &&op_MUL,
+        &&op_DIV,
+        &&op_LESS,
+        &&op_LESS_OR_EQ,
+        &&op_MORE,
+        &&op_MORE_OR_EQ,
+        &&op_EQ,
+        &&op_NOT,
+        &&op_PRINT,
+        &&op_JUMP,
+        &&op_JUMP_IF_FALSE,
+        &&op_JUMP_IF_NOT_LESS,
+        &&op_JUMP_IF_NOT_LESS_OR_EQ,
+        &&op_JUMP_IF_NOT_MORE,
+        &&op_JUMP_IF_NOT_MORE_OR_EQ,
+        &&op_JUMP_IF_NOT_EQ,
+        &&op_CLEAR_ARRAY,
+        &&op_LOAD_ELEMENT,
+        &&op_STORE_ELEMENT,
+        &&op_ARRAY_ADD,
+        &&op_ARRAY_SUB,
+        &&op_ARRAY_MUL,
+        &&op_ARRAY_DIV,
+        &&op_ARRAY_LESS,
+        &&op_ARRAY_LESS_OR_EQ,
+        &&op_ARRAY_MORE,
+        &&op_ARRAY_MORE_OR_EQ,
+        &&op_ARRAY_EQ,
+    };
+    static_assert(
+        sizeof(dispatch_table) / sizeof(dispatch_table[0]) == static_cast<size_t>(Opcode::OPCODES_COUNT),
+        "dispatch table is out of sync with Opcode"
+    );
+
+    VM_DISPATCH();
+#else
+    for (;;) VM_DISPATCH()
+#endif
+    {
+    VM_CASE(LOAD_CONST)
+        reg[pc->dst] = static_cast<AstValue_t>((static_cast<uint64_t>(pc->right) << 32) | pc->left);
+        VM_NEXT();
+    VM_CASE(MOVE)
+        reg[pc->dst] = reg[pc->left];
+        VM_NEXT();
+    VM_CASE(ADD)
+        reg[pc->dst] = reg[pc->left] + reg[pc->right];
+        VM_NEXT();
+    VM_CASE(SUB)
+        reg[pc->dst] = reg[pc->left] - reg[pc->right];
+        VM_NEXT();
+    VM_CASE(MUL)
+        reg[pc->dst] = reg[pc->left] * reg[pc->right];
+        VM_NEXT();
+    VM_CASE(DIV)
+        reg[pc->dst] = reg[pc->left] / reg[pc->right];
+        VM_NEXT();
+    VM_CASE(LESS)
+        reg[pc->dst] = reg[pc->left] < reg[pc->right];
+        VM_NEXT();
+    VM_CASE(LESS_OR_EQ)
+        reg[pc->dst] = reg[pc->left] <= reg[pc->right];
+        VM_NEXT();
+    VM_CASE(MORE)
+        reg[pc->dst] = reg[pc->left] > reg[pc->right];
+        VM_NEXT();
+    VM_CASE(MORE_OR_EQ)
+        reg[pc->dst] = reg[pc->left] >= reg[pc->right];
+        VM_NEXT();
+    VM_CASE(EQ)
+        reg[pc->dst] = reg[pc->left] == reg[pc->right];
+        VM_NEXT();
+    VM_CASE(NOT)
+        reg[pc->dst] = !reg[pc->left];
+        VM_NEXT();
+    VM_CASE(PRINT)
+        output.printInt(reg[pc->left]);
+        VM_NEXT();
+    VM_CASE(JUMP)
+        pc = code + pc->dst;
+        VM_JUMP();
+    VM_CASE(JUMP_IF_FALSE)
+        pc = reg[pc->left] ? pc + 1 : code + pc->dst;
+        VM_JUMP();
+    VM_CASE(JUMP_IF_NOT_LESS)
+        pc = reg[pc->left] < reg[pc->right] ? pc + 1 : code + pc->dst;
+        VM_JUMP();
+    VM_CASE(JUMP_IF_NOT_LESS_OR_EQ)
+        pc = reg[pc->left] <= reg[pc->right] ? pc + 1 : code + pc->dst;
+        VM_JUMP();
+    VM_CASE(JUMP_IF_NOT_MORE)
+        pc = reg[pc->left] > reg[pc->right] ? pc + 1 : code + pc->dst;
+        VM_JUMP();
+    VM_CASE(JUMP_IF_NOT_MORE_OR_EQ)
+        pc = reg[pc->left] >= reg[pc->right] ? pc + 1 : code + pc->dst;
+        VM_JUMP();
+    VM_CASE(JUMP_IF_NOT_EQ)
+        pc = reg[pc->left] == reg[pc->right] ? pc + 1 : code + pc->dst;
+        VM_JUMP();
+    VM_CASE(CLEAR_ARRAY)
+        std::fill_n(reg + arrays[pc->dst].first, arrays[pc->dst].size, 0);
+        VM_NEXT();
+    VM_CASE(LOAD_ELEMENT)
+        reg[pc->dst] = reg[elementRegister(arrays[pc->left], reg[pc->right], output)];
+        VM_NEXT();
+    VM_CASE(STORE_ELEMENT)
+        reg[elementRegister(arrays[pc->dst], reg[pc->right], output)] = reg[pc->left];
+        VM_NEXT();
+    VM_ARRAY_CASE(ADD)
+    VM_ARRAY_CASE(SUB)
+    VM_ARRAY_CASE(MUL)
+    VM_ARRAY_CASE(DIV)
+    VM_ARRAY_CASE(LESS)
+    VM_ARRAY_CASE(LESS_OR_EQ)
+    VM_ARRAY_CASE(MORE)
+    VM_ARRAY_CASE(MORE_OR_EQ)
+    VM_ARRAY_CASE(EQ)
+    VM_CASE(HALT)
+        output.flush();
+        return;
+#if !defined(VM_COMPUTED_GOTO)
+    default:
+        DEV_ASSERT(true);
+        return;
+#endif
+    }
+}
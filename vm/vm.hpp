@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+#include "ast.hpp"
+#include "bytecode.hpp"
+#include "output.hpp"
+
+class VirtualMachine
+{
+private:
+    std::vector<AstValue_t> registers;
+    OutputBuffer_t output;
+
+public:
+    explicit VirtualMachine() = default;
+
+    VirtualMachine(const VirtualMachine&) = delete;
+    VirtualMachine &operator=(const VirtualMachine&) = delete;
+    VirtualMachine(VirtualMachine&&) = delete;
+    VirtualMachine &operator=(VirtualMachine&&) = delete;
+
+    void setOutputFd(const int fd)
+    {
+        output.setFd(fd);
+    }
+
+    // Bytecode must have passed verifyBytecode().
+    void run(const Bytecode_t &bytecode);
+};